@@ -0,0 +1,357 @@
+// coordinator.cpp
+
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <signal.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <time.h>
+#include <set>
+
+#include "fminer.h"
+#include "coordinator.h"
+
+extern Fminer* fminer;
+
+struct Unit {
+    unsigned int root, leg;
+    unsigned long size; // occurrences
+};
+
+static bool larger (const Unit& a, const Unit& b) { return a.size > b.size; }
+
+// Tag of the trailer line of a unit's output: the number of graph ids it used, see copy ()
+static const char* GRAPHS = "#graphs ";
+
+
+// helper routines
+static void fail (const char* what, const string& file) {
+    cerr << "Error " << what << " '" << file << "': " << strerror(errno) << "." << endl;
+    exit(1);
+}
+
+static bool exists (const string& file) {
+    struct stat st;
+    return !stat(file.c_str(), &st);
+}
+
+static string unit_name (unsigned int root, unsigned int leg) {
+    ostringstream os;
+    os << root << "." << leg;
+    return os.str();
+}
+
+static string hostname () {
+    char host[256] = "";
+    gethostname(host, sizeof(host)-1);
+    return host;
+}
+
+static string get (const string& file) {
+    ifstream input(file.c_str());
+    if (!input) fail("opening file", file);
+    ostringstream os;
+    os << input.rdbuf();
+    return os.str();
+}
+
+// atomically, readers see the whole file or none
+static void put (const string& file, const string& content) {
+    string tmp = file + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "w");
+    if (!f || fputs(content.c_str(), f) == EOF || fclose(f) || rename(tmp.c_str(), file.c_str())) fail("writing file", file);
+}
+
+static void make_dir (const string& dir) {
+    if (mkdir(dir.c_str(), 0777) && errno != EEXIST) fail("creating directory", dir);
+}
+
+static void remove_dir (const string& dir) {
+    DIR* d = opendir(dir.c_str());
+    if (!d) return;
+    struct dirent* e;
+    while ((e = readdir(d))) {
+        if (e->d_name[0] != '.') unlink((dir + "/" + e->d_name).c_str());
+    }
+    closedir(d);
+    rmdir(dir.c_str());
+}
+
+static bool entries (const string& dir) {
+    DIR* d = opendir(dir.c_str());
+    if (!d) fail("opening directory", dir);
+    struct dirent* e;
+    bool found = false;
+    while (!found && (e = readdir(d))) found = e->d_name[0] != '.';
+    closedir(d);
+    return found;
+}
+
+// Seconds a claim is valid without a heartbeat of its worker (FMINER_LEASE)
+static unsigned int lease () {
+    const char* s = getenv("FMINER_LEASE");
+    return (s && atoi(s) > 0) ? atoi(s) : 300;
+}
+
+static string join (const vector<string>& args) {
+    string s;
+    each(args) s += args[i] + "\n";
+    return s;
+}
+
+
+vector<string> job_args (const vector<string>& args) {
+    vector<string> job;
+    for (unsigned int i = 1; i < args.size(); i++) {
+        const string& a = args[i];
+        if (a == "-W" || a == "-S" || a == "-w" || a == "--workers" || a == "--spool" || a == "--worker") i++; // and its value
+        else if (a.size() > 2 && a[0] == '-' && (a[1] == 'W' || a[1] == 'S' || a[1] == 'w')) continue;
+        else if (!a.compare(0, 10, "--workers=") || !a.compare(0, 8, "--spool=") || !a.compare(0, 9, "--worker=")) continue;
+        else job.push_back(a);
+    }
+    return job;
+}
+
+
+// Starts a worker on this machine, forked after the database is built, which it shares copy-on-write.
+// Its output is in the spool directory only.
+static pid_t spawn (const vector<string>& args, const string& dir) {
+    cout.flush();
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) fail("starting worker", args[0]);
+    if (!pid) {
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0) dup2(null, fileno(stdout));
+        work(args, dir.c_str());
+        exit(0);
+    }
+    return pid;
+}
+
+// Queues the units claimed by processes of this host that are gone, and those of other hosts whose
+// lease expired. Units with output are done.
+static void requeue (const string& dir, const string& host) {
+    DIR* d = opendir((dir + "/run").c_str());
+    if (!d) fail("opening directory", dir + "/run");
+    struct dirent* e;
+    while ((e = readdir(d))) {
+        string claim = e->d_name;
+        string::size_type p = claim.find('.');
+        if (e->d_name[0] == '.' || p == string::npos || (p = claim.find('.', p+1)) == string::npos) continue;
+        string unit = claim.substr(0, p);
+        string owner = claim.substr(p+1);
+        string::size_type q = owner.find_last_of('.');
+        if (q == string::npos) continue;
+        string from = dir + "/run/" + claim;
+        if (owner.substr(0, q) == host) {
+            pid_t pid = atoi(owner.c_str()+q+1);
+            if (!kill(pid, 0) || errno != ESRCH) continue; // still mining
+        }
+        else {
+            struct stat st;
+            if (stat(from.c_str(), &st) || time(NULL) - st.st_mtime <= (time_t) lease()) continue; // heartbeat in time
+        }
+        if (exists(dir + "/out/" + unit)) unlink(from.c_str());
+        else {
+            cerr << "Worker " << owner << " failed, root and top-level leg " << unit << " are queued again." << endl;
+            rename(from.c_str(), (dir + "/todo/" + unit).c_str());
+        }
+    }
+    closedir(d);
+}
+
+// Copies the output of a unit to stdout, false if it is not there yet. Graphs in gSpan format are
+// numbered from 1 in each unit, so they are offset by the ids the units before used (graphs), as in
+// a single process.
+static bool copy (const string& file, unsigned long& graphs) {
+    FILE* f = fopen(file.c_str(), "r");
+    if (!f) {
+        if (errno != ENOENT) fail("opening file", file);
+        return false;
+    }
+    cout.flush();
+    char line[65536];
+    unsigned long used = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == 't' && line[1] == ' ' && strspn(line+2, "0123456789") == strlen(line+2) - 1) printf("t %lu\n", graphs + strtoul(line+2, NULL, 10));
+        else if (!strncmp(line, GRAPHS, strlen(GRAPHS))) used = strtoul(line + strlen(GRAPHS), NULL, 10);
+        else fputs(line, stdout);
+    }
+    if (ferror(f)) fail("reading file", file);
+    graphs += used;
+    fclose(f);
+    unlink(file.c_str());
+    return true;
+}
+
+
+void coordinate (const vector<string>& args, const char* spool, int workers) {
+    string dir;
+    if (spool) {
+        dir = spool;
+        make_dir(dir);
+        if (exists(dir + "/job")) {
+            cerr << "Error! Spool directory '" << dir << "' holds a job already." << endl;
+            exit(1);
+        }
+    }
+    else {
+        const char* tmpdir = getenv("TMPDIR");
+        string tmpl = string(tmpdir ? tmpdir : "/tmp") + "/fminer.XXXXXX";
+        vector<char> name(tmpl.begin(), tmpl.end());
+        name.push_back('\0');
+        if (!mkdtemp(&name[0])) fail("creating directory", tmpl);
+        dir = &name[0];
+    }
+    make_dir(dir + "/todo");
+    make_dir(dir + "/run");
+    make_dir(dir + "/out");
+
+    // units in the order of the output, queued largest first
+    vector<Unit> units;
+    for (unsigned int j = 0; j < (unsigned int) fminer->GetNoRootNodes(); j++) {
+        vector<unsigned long>* sizes = fminer->GetUnits(j);
+        each(*sizes) {
+            if (!(*sizes)[i]) continue; // nothing to mine
+            Unit unit = { j, (unsigned int) i, (*sizes)[i] };
+            units.push_back(unit);
+        }
+    }
+    vector<Unit> queue(units);
+    stable_sort(queue.begin(), queue.end(), larger);
+    ostringstream list;
+    each(queue) {
+        string todo = dir + "/todo/" + unit_name(queue[i].root, queue[i].leg);
+        FILE* f = fopen(todo.c_str(), "w");
+        if (!f || fclose(f)) fail("writing file", todo);
+        list << queue[i].root << " " << queue[i].leg << " " << queue[i].size << endl;
+    }
+    put(dir + "/units", list.str());
+    put(dir + "/job", join(job_args(args))); // workers start on it
+    cerr << units.size() << " units in '" << dir << "'" << endl;
+    if (!workers) cerr << "Waiting for workers: " << args[0] << " " << args[1] << " -w " << dir << " ..." << endl;
+
+    string host = hostname();
+    set<pid_t> running;
+    int failures = 0;
+    for (int w = 0; w < workers && w < (int) units.size(); w++) running.insert(spawn(args, dir));
+
+    unsigned long graphs = 0;
+    for (unsigned int k = 0; k < units.size(); ) {
+        if (copy(dir + "/out/" + unit_name(units[k].root, units[k].leg), graphs)) { k++; continue; }
+        int status;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            running.erase(pid);
+            if (WIFEXITED(status) && !WEXITSTATUS(status)) continue;
+            if (++failures > 3 * workers) {
+                cerr << "Error! Workers failed " << failures << " times, giving up." << endl;
+                exit(1);
+            }
+        }
+        requeue(dir, host);
+        if ((int) running.size() < workers && entries(dir + "/todo")) running.insert(spawn(args, dir));
+        usleep(100000);
+    }
+
+    while (running.size()) { // each finds nothing left
+        pid_t pid = waitpid(-1, NULL, 0);
+        if (pid < 0) break;
+        running.erase(pid);
+    }
+    unlink((dir + "/job").c_str());
+    unlink((dir + "/units").c_str());
+    remove_dir(dir + "/todo");
+    remove_dir(dir + "/run");
+    remove_dir(dir + "/out");
+    if (!spool) rmdir(dir.c_str());
+}
+
+
+// Refreshes the claim of the unit mined (modification time) until cancelled, 4 times a lease.
+static void* heartbeat (void* claim) {
+    unsigned int beat = lease() / 4 ? lease() / 4 : 1;
+    for (;;) {
+        sleep(beat);
+        utimes(((string*) claim)->c_str(), NULL);
+    }
+    return NULL;
+}
+
+// Mines the units queued that no other worker has claimed, until all are done.
+void work (const vector<string>& args, const char* spool) {
+    string dir = spool;
+    string job = dir + "/job";
+    if (!exists(job)) {
+        cerr << "Waiting for a job in '" << dir << "'..." << endl;
+        while (!exists(job)) sleep(1);
+    }
+    if (get(job) != join(job_args(args))) {
+        cerr << "Error! The job in '" << dir << "' has other arguments." << endl;
+        exit(1);
+    }
+
+    ostringstream claimer; // host and process
+    claimer << hostname() << "." << getpid();
+    int out = dup(fileno(stdout));
+    for (;;) {
+        ifstream list((dir + "/units").c_str());
+        if (!list) break; // job done
+        unsigned int root, leg;
+        unsigned long size;
+        while (list >> root >> leg >> size) {
+            string name = unit_name(root, leg);
+            string claim = dir + "/run/" + name + "." + claimer.str();
+            if (rename((dir + "/todo/" + name).c_str(), claim.c_str())) continue; // claimed by another worker
+            utimes(claim.c_str(), NULL); // lease starts
+            pthread_t beat;
+            if (pthread_create(&beat, NULL, heartbeat, &claim)) fail("starting heartbeat of", claim);
+
+            string tmp = dir + "/out/" + name + ".tmp." + claimer.str();
+            cout.flush();
+            fflush(stdout);
+            int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+            if (fd < 0 || dup2(fd, fileno(stdout)) < 0) fail("writing file", tmp);
+            close(fd);
+            vector<string>* result = fminer->MineUnit(root, leg);
+            if (!fminer->GetConsoleOut()) {
+                each (*result) {
+                    cout << (*result)[i] << endl;
+                }
+            }
+            cout << GRAPHS << fminer->GetUnitGraphs() << endl;
+            if (fflush(stdout) || ferror(stdout) || fsync(fileno(stdout)) || dup2(out, fileno(stdout)) < 0) fail("writing file", tmp);
+            pthread_cancel(beat);
+            pthread_join(beat, NULL);
+            if (rename(tmp.c_str(), (dir + "/out/" + name).c_str())) fail("writing file", dir + "/out/" + name);
+            unlink(claim.c_str());
+        }
+        // claims of other workers are queued again if they fail
+        if (!exists(job) || (!entries(dir + "/todo") && !entries(dir + "/run"))) break;
+        sleep(1);
+    }
+    close(out);
+}
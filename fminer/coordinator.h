@@ -0,0 +1,46 @@
+// coordinator.h
+
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Mining with worker processes. The coordinator splits the search into units (a root and one of
+// its top-level legs, see Fminer::GetUnits) and queues them in a spool directory:
+//
+//   job           arguments of the run, without those of the coordinator and workers
+//   units         "root leg size" of each unit, largest first
+//   todo/r.l      unit queued
+//   run/r.l.h.p   unit claimed by worker process p on host h (renamed from todo/r.l), its
+//                 modification time refreshed by the worker while mining (lease)
+//   out/r.l       output of the unit, and the number of graph ids it used
+//
+// Workers claim units by renaming them and mine them with Fminer::MineUnit. The coordinator
+// builds the database and forks workers on the local machine, which share it copy-on-write, and
+// copies the output of the units to stdout in the order of a single process. Workers on other
+// machines are fminer processes with the same arguments and '-w <dir>', which read the compounds
+// themselves and share the directory on a network file system.
+
+#ifndef COORDINATOR_H
+#define COORDINATOR_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+vector<string> job_args (const vector<string>& args); // args without those of the coordinator and workers
+void coordinate (const vector<string>& args, const char* spool, int workers); // spool: NULL for a temporary directory
+void work (const vector<string>& args, const char* spool);
+
+#endif
@@ -0,0 +1,629 @@
+// daemon.cpp
+
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <deque>
+#include <fstream>
+#include <map>
+
+#include "daemon.h"
+
+extern Fminer* fminer;
+
+// main.cpp
+void read_smi (char* graph_file);
+void read_gsp (char* graph_file);
+void read_lat (char* graph_file);
+void read_act (istream& input, const char* act_file, bool regr, unsigned int endpoint);
+
+static const char* socket_path = NULL; // removed on exit
+static const unsigned int prepared_max = 8; // settings each database keeps built
+
+// A job as requested, with the activity files read by the process of its database
+struct Request {
+    bool regression, refine_singles, aromatic, do_pruning, do_backbone, adjust_ub, with_activities;
+    int type, minfreq, max_hops;
+    float chisq_sig;
+    unsigned long memory_budget;
+    vector<int> roots;
+    vector<string> act_files; // names in the directory of the database
+    vector<string> act_texts; // their contents
+    vector<pair<Tid, float> > acts;
+    Request () : regression(false), refine_singles(false), aromatic(true), do_pruning(true), do_backbone(true), adjust_ub(true), with_activities(false), type(-1), minfreq(-1), max_hops(-1), chisq_sig(-1.0), memory_budget(0) {}
+};
+
+// A connection to the daemon, with the request read so far
+struct Client {
+    int fd;
+    string request;
+    string::size_type scanned; // lines before are not "mine"
+    int database;
+};
+
+// The process that keeps the database built for one settings, see prepare()
+struct Prepared {
+    int sock;
+    bool ready; // built
+    vector<pair<int, string> > waiting; // clients with their roots, until ready
+    int running; // jobs passed and not finished
+    unsigned long used; // request that used it last
+};
+
+
+// helper routines
+static void fail (const char* what, const string& file) {
+    cerr << "Error " << what << " '" << file << "': " << strerror(errno) << "." << endl;
+    exit(1);
+}
+
+static void quit (int sig) {
+    if (socket_path) unlink(socket_path);
+    _exit(0);
+}
+
+// name of a database in the requests: its file without directory and suffix
+static string db_name (const char* file) {
+    string name = file;
+    name = name.substr(name.find_last_of('/') + 1);
+    return name.substr(0, name.find_last_of('.'));
+}
+
+// Passes an open file descriptor to the process at the other end of sock.
+static bool send_fd (int sock, int fd) {
+    char byte = 0;
+    struct iovec iov = { &byte, 1 };
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    return sendmsg(sock, &msg, 0) == 1;
+}
+
+// -1 if the other end is closed
+static int receive_fd (int sock) {
+    char byte;
+    struct iovec iov = { &byte, 1 };
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(sock, &msg, 0) != 1) return -1;
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS) return -1;
+    int fd;
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    return fd;
+}
+
+// Writes all of data, false if the other end is closed.
+static bool write_all (int fd, const char* data, size_t size) {
+    while (size) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool read_all (int fd, char* data, size_t size) {
+    while (size) {
+        ssize_t n = read(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Passes a client to the process at the other end of sock, with the text of its job.
+static bool send_job (int sock, int client, const string& text) {
+    unsigned int size = text.size();
+    return send_fd(sock, client) && write_all(sock, (const char*) &size, sizeof(size)) && write_all(sock, text.data(), size);
+}
+
+// -1 if the other end is closed
+static int receive_job (int sock, string& text) {
+    int client = receive_fd(sock);
+    if (client < 0) return -1;
+    unsigned int size;
+    if (!read_all(sock, (char*) &size, sizeof(size))) { close(client); return -1; }
+    text.assign(size, '\0');
+    if (size && !read_all(sock, &text[0], size)) { close(client); return -1; }
+    return client;
+}
+
+// Reports a finished job to the daemon.
+static void done (int sock) {
+    if (write(sock, "d", 1) != 1) exit(0); // the daemon has ended
+}
+
+// Sends an error to a client that is not mined.
+static void refuse (int client, const string& message) {
+    string reply = "Error! " + message + "\n";
+    send(client, reply.c_str(), reply.size(), MSG_NOSIGNAL);
+    close(client);
+}
+
+static void reply_error (const string& message) {
+    cout << "Error! " << message << endl;
+    exit(1);
+}
+
+
+// Reads the lines of a request, "" if it is valid, else the error.
+static string parse (const string& text, Request& request) {
+    istringstream lines(text);
+    string line;
+    bool mine = false;
+    while (!mine && getline(lines, line)) {
+        string::size_type end = line.find_last_not_of("\r\n");
+        line = end == string::npos ? "" : line.substr(0, end+1);
+        istringstream iss(line);
+        string key;
+        iss >> key;
+        if (key.empty() || key == "database") continue;
+        else if (key == "mine") mine = true;
+        else if (key == "minfreq") iss >> request.minfreq;
+        else if (key == "level") iss >> request.type;
+        else if (key == "p-value") iss >> request.chisq_sig;
+        else if (key == "refine-singles") request.refine_singles = true;
+        else if (key == "no-aromaticity") request.aromatic = false;
+        else if (key == "no-upper-bound-pruning") request.do_pruning = false;
+        else if (key == "no-bbr-classes") request.do_backbone = false;
+        else if (key == "no-dynamic-ub") request.adjust_ub = false;
+        else if (key == "regression") request.regression = true;
+        else if (key == "max-hops") iss >> request.max_hops;
+        else if (key == "memory-budget") iss >> request.memory_budget;
+        else if (key == "roots") {
+            int j;
+            while (iss >> j) request.roots.push_back(j);
+            if (!iss.eof()) return "Invalid request '" + line + "'.";
+            continue;
+        }
+        else if (key == "activities") {
+            string file;
+            iss >> file;
+            if (file.find('/') != string::npos || file == "." || file == "..") return "Activities are a file in the directory of the database, given by its name.";
+            request.act_files.push_back(file);
+            request.with_activities = true;
+        }
+        else if (key == "activity") {
+            pair<Tid, float> act;
+            iss >> act.first >> act.second;
+            request.acts.push_back(act);
+            request.with_activities = true;
+        }
+        else return "Unknown request '" + line + "'.";
+        if (iss.fail()) return "Invalid request '" + line + "'.";
+    }
+    if (!mine) return "The request ends without 'mine'.";
+
+    if (request.with_activities) {
+        if ((request.adjust_ub && !request.do_pruning) || (request.adjust_ub && !request.do_backbone)) return "Switch off the dynamic upper bound (no-dynamic-ub) to switch off pruning or BBRC mining.";
+        if (request.regression && (!request.adjust_ub || !request.do_backbone || !request.do_pruning)) return "Regression needs the dynamic upper bound, pruning and BBRC mining.";
+    }
+    else if (request.regression || request.chisq_sig >= 0.0 || !request.do_pruning || !request.do_backbone || !request.adjust_ub) return "Options of BBRC mining need activities.";
+    return "";
+}
+
+// What the database of a request depends on: all but its roots.
+static string settings (const Request& request) {
+    ostringstream os;
+    os << request.regression << request.refine_singles << request.aromatic << request.do_pruning << request.do_backbone << request.adjust_ub << request.with_activities
+       << " " << request.type << " " << request.minfreq << " " << request.max_hops << " " << request.chisq_sig << " " << request.memory_budget << endl;
+    each(request.act_texts) os << request.act_texts[i].size() << endl << request.act_texts[i];
+    each(request.acts) os << request.acts[i].first << " " << request.acts[i].second << endl;
+    return os.str();
+}
+
+
+// Mines a job (in a process of its own) and sends the fragments to the client.
+static void job (int client, const string& roots_text, int nr_roots) {
+    signal(SIGPIPE, SIG_DFL); // the client has gone
+    dup2(client, fileno(stdout));
+
+    vector<int> roots;
+    istringstream iss(roots_text);
+    int j;
+    while (iss >> j) roots.push_back(j);
+    if (roots.empty()) {
+        for (j = 0; j < nr_roots; j++) roots.push_back(j);
+    }
+    for (unsigned int i = 0; i < roots.size(); i++) {
+        if (roots[i] < 0 || roots[i] >= nr_roots) {
+            ostringstream os;
+            os << "Root node " << roots[i] << " does not exist.";
+            reply_error(os.str());
+        }
+    }
+
+    for (unsigned int r = 0; r < roots.size(); r++) {
+        vector<string>* result = fminer->MineRoot(roots[r]);
+        if (!fminer->GetConsoleOut()) {
+            each (*result) {
+                cout << (*result)[i] << endl;
+            }
+        }
+    }
+    cout << "." << endl;
+    fflush(stdout);
+    exit(0);
+}
+
+
+// Builds the database of a request with its activities and settings, reports "r" to the
+// process of the database on sock, then forks a process for each job passed to sock and reports
+// each finished job as "d". Settings that are refused end the process before "r".
+static void prepare (const Request& request, int sock) {
+    bool all_args_good = 1;
+    if (request.with_activities) {
+        if (request.regression) all_args_good &= fminer->SetRegression(request.regression);
+        if (request.type >= 0) all_args_good &= fminer->SetType(request.type);
+        if (request.minfreq >= 0) fminer->SetMinfreq(request.minfreq);
+        if (request.chisq_sig >= 0.0) all_args_good &= fminer->SetChisqSig(request.chisq_sig);
+        if (request.refine_singles) all_args_good &= fminer->SetRefineSingles(request.refine_singles);
+        if (!request.aromatic) fminer->SetAromatic(request.aromatic);
+        if (!request.adjust_ub) all_args_good &= fminer->SetDynamicUpperBound(request.adjust_ub);
+        if (!request.do_pruning) all_args_good &= fminer->SetPruning(request.do_pruning);
+        if (!request.do_backbone) all_args_good &= fminer->SetBackbone(request.do_backbone);
+        if (request.max_hops >= 0) all_args_good &= fminer->SetMaxHops(request.max_hops);
+        if (request.memory_budget) all_args_good &= fminer->SetMemoryBudget(request.memory_budget << 20);
+    }
+    else {
+        if (request.type >= 0) all_args_good &= fminer->SetType(request.type);
+        if (request.minfreq >= 0) fminer->SetMinfreq(request.minfreq);
+        if (request.refine_singles) all_args_good &= fminer->SetRefineSingles(request.refine_singles);
+        if (!request.aromatic) fminer->SetAromatic(request.aromatic);
+        if (request.memory_budget) all_args_good &= fminer->SetMemoryBudget(request.memory_budget << 20);
+        fminer->SetChisqActive(false);
+    }
+    if (!all_args_good) exit(1);
+    fminer->SetConsoleOut(true);
+
+    for (unsigned int i = 0; i < request.act_texts.size(); i++) {
+        istringstream input(request.act_texts[i]);
+        read_act(input, request.act_files[i].c_str(), fminer->GetRegression(), 0);
+    }
+    for (unsigned int i = 0; i < request.acts.size(); i++) fminer->AddActivity(request.acts[i].second, request.acts[i].first);
+    fminer->PrepareMining();
+    int nr_roots = fminer->GetNoRootNodes();
+    if (write(sock, "r", 1) != 1) exit(0);
+
+    for (;;) {
+        struct pollfd p = { sock, POLLIN, 0 };
+        poll(&p, 1, 100);
+        while (waitpid(-1, NULL, WNOHANG) > 0) done(sock);
+        if (!p.revents) continue;
+        string roots;
+        int client = receive_job(sock, roots);
+        if (client < 0) exit(0); // not used any more, or the daemon has ended
+        cout.flush();
+        fflush(stdout);
+        fflush(stderr);
+        pid_t pid = fork();
+        if (pid < 0) {
+            cerr << "Error starting a job: " << strerror(errno) << "." << endl;
+            done(sock);
+        }
+        if (!pid) {
+            close(sock);
+            job(client, roots, nr_roots);
+        }
+        close(client);
+    }
+}
+
+
+// Reads a database, then passes each job the daemon passes to sock to the process that keeps the
+// database built for its settings, and reports each finished job to the daemon. Such processes
+// are started for new settings, those of the prepared_max settings used last are kept.
+static void database (char* file, int sock, create0_t* create_lib) {
+    fminer = create_lib();
+    string file_str = file;
+    string suffix = file_str.substr(file_str.find_last_of("."));
+    bool prepared_compounds = false;
+    if (suffix == ".smi") {
+        read_smi(file);
+        prepared_compounds = fminer->PrepareCompounds();
+    }
+    else if (suffix == ".gsp") read_gsp(file);
+    else read_lat(file);
+    string dir = file_str.find('/') == string::npos ? "." : file_str.substr(0, file_str.find_last_of('/'));
+    cerr << "Database '" << db_name(file) << "' is read from '" << file << "'" << (prepared_compounds ? ", structures prepared." : ".") << endl; // selected and labelled for each settings
+
+    map<string, Prepared> prepared;
+    unsigned long requests = 0;
+    for (;;) {
+        while (waitpid(-1, NULL, WNOHANG) > 0);
+        vector<struct pollfd> fds;
+        vector<map<string, Prepared>::iterator> its;
+        struct pollfd p = { sock, POLLIN, 0 };
+        fds.push_back(p);
+        for (map<string, Prepared>::iterator it = prepared.begin(); it != prepared.end(); it++) {
+            p.fd = it->second.sock;
+            fds.push_back(p);
+            its.push_back(it);
+        }
+        if (poll(&fds[0], fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            exit(1);
+        }
+
+        each(its) {
+            if (!fds[1+i].revents) continue;
+            Prepared& prep = its[i]->second;
+            char reports[64];
+            int n = read(prep.sock, reports, sizeof(reports));
+            for (int k = 0; k < n; k++) {
+                if (reports[k] == 'r') prep.ready = true;
+                else { prep.running--; done(sock); }
+            }
+            if (n > 0) continue;
+            // ended: its settings were refused, or building the database failed
+            for (unsigned int k = 0; k < prep.waiting.size(); k++) {
+                refuse(prep.waiting[k].first, prep.ready ? "The job has failed, see the log of the daemon." : "Invalid settings or activities, see the log of the daemon.");
+                done(sock);
+            }
+            for (; prep.running > 0; prep.running--) done(sock);
+            close(prep.sock);
+            prepared.erase(its[i]);
+        }
+
+        if (fds[0].revents) {
+            string text;
+            int client = receive_job(sock, text);
+            if (client < 0) exit(0); // the daemon has ended
+            Request request;
+            string error = parse(text, request);
+            for (unsigned int i = 0; error.empty() && i < request.act_files.size(); i++) {
+                ifstream input((dir + "/" + request.act_files[i]).c_str());
+                ostringstream act_text;
+                if (!input || !(act_text << input.rdbuf())) error = "Cannot read activities '" + request.act_files[i] + "'.";
+                request.act_texts.push_back(act_text.str());
+            }
+            if (!error.empty()) {
+                refuse(client, error);
+                done(sock);
+                continue;
+            }
+
+            string key = settings(request);
+            map<string, Prepared>::iterator it = prepared.find(key);
+            if (it == prepared.end()) {
+                int ends[2];
+                if (socketpair(AF_UNIX, SOCK_STREAM, 0, ends)) {
+                    refuse(client, string("Cannot start the job: ") + strerror(errno) + ".");
+                    done(sock);
+                    continue;
+                }
+                cout.flush();
+                fflush(stdout);
+                fflush(stderr);
+                pid_t pid = fork();
+                if (!pid) { // without the connections of others
+                    close(sock);
+                    close(ends[0]);
+                    close(client);
+                    for (it = prepared.begin(); it != prepared.end(); it++) {
+                        close(it->second.sock);
+                        for (unsigned int k = 0; k < it->second.waiting.size(); k++) close(it->second.waiting[k].first);
+                    }
+                    prepare(request, ends[1]);
+                }
+                close(ends[1]);
+                if (pid < 0) {
+                    close(ends[0]);
+                    refuse(client, string("Cannot start the job: ") + strerror(errno) + ".");
+                    done(sock);
+                    continue;
+                }
+                Prepared prep = { ends[0], false, vector<pair<int, string> >(), 0, 0 };
+                it = prepared.insert(make_pair(key, prep)).first;
+            }
+            ostringstream roots;
+            each(request.roots) roots << request.roots[i] << " ";
+            it->second.waiting.push_back(make_pair(client, roots.str()));
+            it->second.used = ++requests;
+
+            // the settings used least recently give way, once their jobs are done
+            while (prepared.size() > prepared_max) {
+                map<string, Prepared>::iterator idle = prepared.end();
+                for (it = prepared.begin(); it != prepared.end(); it++) {
+                    if (it->second.ready && it->second.waiting.empty() && !it->second.running && (idle == prepared.end() || it->second.used < idle->second.used)) idle = it;
+                }
+                if (idle == prepared.end()) break;
+                close(idle->second.sock);
+                prepared.erase(idle);
+            }
+        }
+
+        // jobs of built databases to their processes
+        for (map<string, Prepared>::iterator it = prepared.begin(); it != prepared.end(); it++) {
+            Prepared& prep = it->second;
+            if (!prep.ready) continue;
+            for (unsigned int k = 0; k < prep.waiting.size(); k++) {
+                if (send_job(prep.sock, prep.waiting[k].first, prep.waiting[k].second)) {
+                    prep.running++;
+                    close(prep.waiting[k].first);
+                }
+                else {
+                    refuse(prep.waiting[k].first, "The job has failed, see the log of the daemon.");
+                    done(sock);
+                }
+            }
+            prep.waiting.clear();
+        }
+    }
+}
+
+
+void serve (const char* socket_file, const vector<char*>& databases, int workers, create0_t* create_lib) {
+    // one process per database, started before anything else is open
+    map<string, int> names;
+    vector<int> socks;
+    each(databases) {
+        string name = db_name(databases[i]);
+        if (names.count(name)) {
+            cerr << "Error! Two databases are named '" << name << "'." << endl;
+            exit(1);
+        }
+        names[name] = i;
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair)) fail("starting database", databases[i]);
+        cout.flush();
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0) fail("starting database", databases[i]);
+        if (!pid) {
+            for (unsigned int k = 0; k < socks.size(); k++) close(socks[k]);
+            close(pair[0]);
+            database(databases[i], pair[1], create_lib);
+        }
+        close(pair[1]);
+        socks.push_back(pair[0]);
+    }
+
+    // socket of the requests, unless another daemon listens
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_file) >= sizeof(addr.sun_path)) {
+        cerr << "Error! Socket path '" << socket_file << "' is too long." << endl;
+        exit(1);
+    }
+    strcpy(addr.sun_path, socket_file);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) fail("creating socket", socket_file);
+    if (!connect(listener, (struct sockaddr*) &addr, sizeof(addr))) {
+        cerr << "Error! A daemon listens on '" << socket_file << "' already." << endl;
+        exit(1);
+    }
+    close(listener);
+    unlink(socket_file);
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    mode_t mask = umask(077); // jobs from this user only
+    if (listener < 0 || bind(listener, (struct sockaddr*) &addr, sizeof(addr)) || listen(listener, 64)) fail("creating socket", socket_file);
+    umask(mask);
+    socket_path = socket_file;
+    signal(SIGINT, quit);
+    signal(SIGTERM, quit);
+    signal(SIGPIPE, SIG_IGN);
+    cerr << "Listening on '" << socket_file << "', mining " << workers << " job(s) at a time." << endl;
+
+    // clients whose request is read up to "mine", then queued until a worker is free
+    vector<Client> clients;
+    deque<Client> queue;
+    int running = 0;
+    for (;;) {
+        while (running < workers && queue.size()) {
+            if (send_job(socks[queue.front().database], queue.front().fd, queue.front().request)) running++;
+            close(queue.front().fd);
+            queue.pop_front();
+        }
+
+        vector<struct pollfd> fds;
+        struct pollfd p = { listener, POLLIN, 0 };
+        fds.push_back(p);
+        each(socks) { p.fd = socks[i]; fds.push_back(p); }
+        each(clients) { p.fd = clients[i].fd; fds.push_back(p); }
+        if (poll(&fds[0], fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            fail("waiting on socket", socket_file);
+        }
+
+        if (fds[0].revents) {
+            int client = accept(listener, NULL, NULL);
+            if (client >= 0) {
+                Client c = { client, "", 0, -1 };
+                clients.push_back(c);
+            }
+        }
+        each(socks) {
+            if (!fds[1+i].revents) continue;
+            char done[64];
+            int n = read(socks[i], done, sizeof(done));
+            if (n <= 0) {
+                cerr << "Error! The process of database '" << db_name(databases[i]) << "' has ended." << endl;
+                quit(0);
+            }
+            running -= n;
+        }
+        vector<Client> waiting;
+        each(clients) {
+            Client c = clients[i];
+            if (!fds[1+socks.size()+i].revents) { waiting.push_back(c); continue; }
+            char buf[4096];
+            int n = recv(c.fd, buf, sizeof(buf), MSG_DONTWAIT);
+            if (n < 0 && (errno == EAGAIN || errno == EINTR)) { waiting.push_back(c); continue; }
+            if (n > 0) c.request.append(buf, n);
+            // complete with a line "mine"
+            bool mine = false;
+            string::size_type nl;
+            while (!mine && (nl = c.request.find('\n', c.scanned)) != string::npos) {
+                istringstream iss(c.request.substr(c.scanned, nl - c.scanned));
+                string key;
+                iss >> key;
+                mine = key == "mine";
+                c.scanned = nl + 1;
+            }
+            if (!mine) {
+                if (n > 0) waiting.push_back(c);
+                else if (c.request.empty()) close(c.fd);
+                else refuse(c.fd, "The request ends without 'mine'.");
+                continue;
+            }
+            istringstream iss(c.request.substr(0, c.request.find('\n')));
+            string key, name;
+            iss >> key >> name;
+            map<string, int>::iterator db = names.find(name);
+            if (key != "database" || db == names.end()) {
+                string reply = "The first line is 'database <name>' with one of the databases:";
+                for (db = names.begin(); db != names.end(); db++) reply += " " + db->first;
+                while (recv(c.fd, buf, sizeof(buf), MSG_DONTWAIT) > 0); // the rest of the request, else the reply is lost in a reset
+                refuse(c.fd, reply);
+                continue;
+            }
+            c.database = db->second;
+            queue.push_back(c);
+        }
+        clients.swap(waiting);
+    }
+}
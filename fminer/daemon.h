@@ -0,0 +1,51 @@
+// daemon.h
+
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Mining daemon. Each database (a file of compounds) is read once by a process of its own, which
+// keeps the compounds, their structures (see Fminer::PrepareCompounds), the library and
+// OpenBabel. For each settings and activities of jobs it forks a process that builds the
+// database for them (see Fminer::PrepareMining), which forks a process per job with these
+// settings. The last settings used are kept built. Jobs are requested on a Unix domain socket,
+// one line each:
+//
+//   database <name>         file name of the database without directory and suffix, first line
+//   minfreq <n>             long options of fminer, with their value if any (all optional)
+//   level <n>, p-value <p>, refine-singles, no-aromaticity, no-upper-bound-pruning,
+//   no-bbr-classes, no-dynamic-ub, regression, max-hops <n>, memory-budget <MB>
+//   roots <j> ...           root nodes to mine (default: all)
+//   activities <file>       activities in Activity format, a file in the directory of the database
+//   activity <id> <value>   activity of a compound
+//   mine                    last line
+//
+// Without activities, frequent subgraphs are mined. The fragments are sent back while they are
+// mined, followed by a line "." when the job is done. Errors are sent instead, as a line
+// "Error! ...". The daemon mines a number of jobs at the same time and queues the others. Only
+// the user of the daemon may connect to the socket.
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <string>
+#include <vector>
+
+#include "fminer.h"
+
+using namespace std;
+
+void serve (const char* socket_file, const vector<char*>& databases, int workers, create0_t* create_lib);
+
+#endif
@@ -69,10 +69,23 @@ public:
     virtual bool SetChisqSig(float _chisq_val) = 0;
     virtual bool SetRegression(bool val) = 0;
     virtual bool SetMaxHops(int val) = 0;
+    virtual bool SetMemoryBudget(unsigned long bytes) = 0;
+    virtual bool SetCheckpoint(std::string file, bool resume) = 0;
     virtual std::vector<std::string>* MineRoot(unsigned int j) = 0;
+    virtual std::vector<unsigned long>* GetUnits(unsigned int j) = 0;
+    virtual std::vector<std::string>* MineUnit(unsigned int j, unsigned int unit) = 0;
+    virtual unsigned int GetUnitGraphs() = 0;
+    virtual std::string GetStatistics() = 0;
     virtual void ReadGsp(FILE* gsp) = 0;
+    virtual bool WriteLattice(FILE* lattice) = 0;
+    virtual void ReadLattice(FILE* lattice) = 0;
     virtual bool AddCompound(std::string smiles, unsigned int comp_id) = 0;
+    virtual bool PrepareCompounds() = 0;
+    virtual bool PrepareMining() = 0;
     virtual bool AddActivity(float act, unsigned int comp_id) = 0;
+    virtual bool AddActivity(float act, unsigned int comp_id, unsigned int endpoint) = 0;
+    virtual int GetNoEndpoints() = 0;
+    virtual std::vector<std::string>* GetResult(unsigned int endpoint) = 0;
     virtual int GetNoRootNodes() = 0;
     virtual int GetNoCompounds() = 0;
 
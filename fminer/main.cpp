@@ -17,13 +17,18 @@
 */
 
 #include <getopt.h>
+#include <unistd.h>
 #include <time.h>
 #include <iostream>
 #include <string.h>
 #include <cassert>
 #include <dlfcn.h>
+#include <map>
+#include <set>
 
 #include "fminer.h"
+#include "coordinator.h"
+#include "daemon.h"
 
 using namespace std;
 
@@ -34,6 +39,9 @@ Fminer* fminer;
 destroy_t* destroy_lib;
 void* Lib;
 
+map<Tid, string> folds; // cross-validation fold of each compound
+vector<string> fold_ids; // endpoint k+1 is trained on all folds except fold_ids[k]
+
 
 // helper routines
 void puti ( FILE *f, int i ) {
@@ -56,6 +64,16 @@ void remove_dos_cr(string* str) {
 	for (string::size_type i = str->find(nl); i!=string::npos; i=str->find(nl)) str->erase(i,1); // erase dos cr
 }
 
+// peak resident set size of this process in kB, 0 where /proc is not available
+unsigned long peak_rss () {
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) return strtoul(line.c_str()+6, NULL, 10);
+    }
+    return 0;
+}
+
 void read_gsp (char* graph_file) {
     FILE *input = fopen (graph_file, "r");
     if (!input) {
@@ -65,6 +83,16 @@ void read_gsp (char* graph_file) {
     fminer->ReadGsp(input);
 }
 
+void read_lat (char* graph_file) {
+    FILE *input = fopen (graph_file, "rb");
+    if (!input) {
+        cerr << "Error opening file '" << graph_file << "': " << strerror(errno) << "." << endl;
+        exit(1);
+    }
+    fminer->ReadLattice(input);
+    fclose(input);
+}
+
 void read_smi (char* graph_file) {
     Tid tree_id = 0;
 
@@ -117,21 +145,58 @@ void read_smi (char* graph_file) {
 
 }
 
-void read_act (char* act_file, bool regr) {
+// orders fold ids by number ("2" before "10"), numbers before other ids
+bool fold_less (const string& a, const string& b) {
+    char *end_a, *end_b;
+    long n_a = strtol(a.c_str(), &end_a, 10), n_b = strtol(b.c_str(), &end_b, 10);
+    bool num_a = !a.empty() && !*end_a, num_b = !b.empty() && !*end_b;
+    if (num_a && num_b && n_a != n_b) return n_a < n_b;
+    if (num_a != num_b) return num_a;
+    return a < b;
+}
+
+void read_folds (char* fold_file) {
     ifstream input;
     string line;
-    string tmp_field;
-    string act_name;
-    Tid tid=0;
     unsigned int line_nr = 0;
-    
-    // Open input stream
-    input.open(act_file);
+    set<string> ids;
+
+    input.open(fold_file);
     if (!input) {
-        cerr << "Error opening file '" << act_file << "': " << strerror(errno) << "." << endl;
+        cerr << "Error opening file '" << fold_file << "': " << strerror(errno) << "." << endl;
+        exit(1);
+    }
+
+    // "ID\tfold"
+    while (getline(input, line)) {
+        line_nr++;
+        remove_dos_cr(&line);
+        if (line.empty()) continue;
+        string::size_type tab = line.find('\t');
+        Tid tid = (Tid) atoi(line.substr(0, tab).c_str());
+        if (tab == string::npos || tab+1 == line.size() || line.find('\t', tab+1) != string::npos || tid == 0) {
+            cerr << "Error! Line no. " << line_nr << " in file '" << fold_file << "' is not in correct input format. Please refer to README." << endl;
+            exit(1);
+        }
+        folds[tid] = line.substr(tab+1);
+        ids.insert(folds[tid]);
+    }
+    if (ids.size() < 2) {
+        cerr << "Error! File '" << fold_file << "' must define at least two folds." << endl;
         exit(1);
     }
+    fold_ids.assign(ids.begin(), ids.end());
+    sort(fold_ids.begin(), fold_ids.end(), fold_less);
+}
 
+// act_file names the input in errors
+void read_act (istream& input, const char* act_file, bool regr, unsigned int endpoint) {
+    string line;
+    string tmp_field;
+    string act_name;
+    Tid tid=0;
+    unsigned int line_nr = 0;
+    
     // draw line from input
     unsigned int field_nr = 3; // initialize to 'valid' pattern
 	while (getline(input, line)) {
@@ -178,7 +243,15 @@ void read_act (char* act_file, bool regr) {
 
                 // KS: fminer->AddActivity((bool) act_value, tid);
                 // KS: Do not convert to bool
-                fminer->AddActivity(act_value, tid);
+                if (endpoint) { if (!fminer->AddActivity(act_value, tid, endpoint)) exit(1); }
+                else fminer->AddActivity(act_value, tid);
+
+                // training part of each fold, compounds without fold are always trained on
+                for (unsigned int k = 0; k < fold_ids.size(); k++) {
+                    map<Tid, string>::iterator fold = folds.find(tid);
+                    if (fold != folds.end() && fold->second == fold_ids[k]) continue;
+                    if (!fminer->AddActivity(act_value, tid, k+1)) exit(1);
+                }
                 
                 field_nr=3;
 			}
@@ -201,6 +274,33 @@ void read_act (char* act_file, bool regr) {
 
 }
 
+void read_act (char* act_file, bool regr, unsigned int endpoint) {
+    // Open input stream
+    ifstream input(act_file);
+    if (!input) {
+        cerr << "Error opening file '" << act_file << "': " << strerror(errno) << "." << endl;
+        exit(1);
+    }
+    read_act(input, act_file, regr, endpoint);
+}
+
+// mines all roots, the results of each endpoint are collected in endpoint_results if it has them
+void mine (vector<vector<string> >& endpoint_results) {
+    for ( int j = 0; j < (int) fminer->GetNoRootNodes(); j++ ) {
+        vector<string>* result = fminer->MineRoot(j);
+        if (endpoint_results.size()) {
+            for (unsigned int e = 0; e < endpoint_results.size(); e++) {
+                result = fminer->GetResult(e);
+                endpoint_results[e].insert(endpoint_results[e].end(), result->begin(), result->end());
+            }
+        }
+        else if (!fminer->GetConsoleOut()) { 
+            each (*result) {
+                cout << (*result)[i] << endl;
+            }
+        }
+    }
+}
 
 // main
 int main(int argc, char *argv[], char *envp[]) {
@@ -247,7 +347,21 @@ int main(int argc, char *argv[], char *envp[]) {
     const char* program_name = argv[0];
     char* graph_file = NULL;
     char* act_file = NULL;
+    vector<char*> act_files; // one per endpoint, if more than one
     char* lib_path = NULL;
+    char* stats_file = NULL;
+    char* fold_file = NULL;
+    char* lattice_file = NULL;
+    FILE* lattice_out = NULL;
+    char* checkpoint_file = NULL;
+    bool resume = false;
+    unsigned long memory_budget = 0; // MB
+    int workers = -1; // coordinator with this many local workers
+    char* spool = NULL; // of the coordinator
+    char* worker_spool = NULL;
+    vector<string> args(argv, argv+argc); // before getopt reorders them
+    char* daemon_socket = NULL;
+    int nr_options = 0;
 
     
     // FILE ARGUMENT READ: STATUS 1
@@ -293,7 +407,7 @@ int main(int argc, char *argv[], char *envp[]) {
 
     // OPTIONS ARGUMENT READ
     char c;
-    const char* const short_options = "f:l:p:saubdogm:h";
+    const char* const short_options = "f:l:p:saubdogm:j:M:F:L:C:RW:S:w:D:h";
     const struct option long_options[] = {
         {"minfreq",                1, NULL, 'f'},
         {"level",                  1, NULL, 'l'},
@@ -306,10 +420,21 @@ int main(int argc, char *argv[], char *envp[]) {
         {"no-output",              0, NULL, 'o'},
         {"regression",             0, NULL, 'g'},
         {"max-hops",               1, NULL, 'm'},
+        {"statistics",             1, NULL, 'j'},
+        {"memory-budget",          1, NULL, 'M'},
+        {"folds",                  1, NULL, 'F'},
+        {"lattice",                1, NULL, 'L'},
+        {"checkpoint",             1, NULL, 'C'},
+        {"resume",                 0, NULL, 'R'},
+        {"workers",                1, NULL, 'W'},
+        {"spool",                  1, NULL, 'S'},
+        {"worker",                 1, NULL, 'w'},
+        {"daemon",                 1, NULL, 'D'},
         {"help",                   0, NULL, 'h'},
         {NULL,                     0, NULL, 0}
     };
     while ((c = getopt_long(argc, argv, short_options, long_options, NULL)) != -1) {
+        nr_options++;
         switch(c) {
         case 'f':
             minfreq = atoi(optarg);
@@ -353,6 +478,39 @@ int main(int argc, char *argv[], char *envp[]) {
             max_hops = atoi(optarg);
             arg_max_hops = 1;
             break;
+        case 'j':
+            stats_file = optarg;
+            break;
+        case 'M':
+            memory_budget = strtoul(optarg, NULL, 10);
+            break;
+        case 'F':
+            fold_file = optarg;
+            if (!act_file) status = 1;
+            break;
+        case 'L':
+            lattice_file = optarg;
+            if (act_file) status = 1;
+            break;
+        case 'C':
+            checkpoint_file = optarg;
+            break;
+        case 'R':
+            resume = true;
+            break;
+        case 'W':
+            workers = atoi(optarg);
+            if (workers < 0) status = 1;
+            break;
+        case 'S':
+            spool = optarg;
+            break;
+        case 'w':
+            worker_spool = optarg;
+            break;
+        case 'D':
+            daemon_socket = optarg;
+            break;
         case 'h':
             if ((argc>1) && (argv[1][0]!='-')) status=2;
             break;
@@ -366,6 +524,39 @@ int main(int argc, char *argv[], char *envp[]) {
     }
 
 
+    // databases of the daemon: getopt has moved the file arguments behind the options
+    vector<char*> databases;
+    if (daemon_socket) {
+        graph_file = act_file = NULL;
+        act_files.clear();
+        if (status != 2) status = lib_path && optind+1 < argc ? 0 : 1;
+        if (nr_options != 1 + (workers >= 0)) {
+            cerr << "Error! The daemon takes only -W, the options of mining are given with each job." << endl;
+            status = 1;
+        }
+        for (int i=optind+1; i<argc; i++) {
+            string file = argv[i];
+            string::size_type dot = file.find_last_of(".");
+            string suffix = dot == string::npos ? "" : file.substr(dot);
+            if (suffix != ".smi" && suffix != ".gsp" && suffix != ".lat") {
+                cerr << "Error! Databases of the daemon have suffix .smi, .gsp or .lat: '" << file << "'." << endl;
+                status = 1;
+            }
+            databases.push_back(argv[i]);
+        }
+    }
+
+    // several activity files: getopt has moved the file arguments behind the options
+    if (status == 0 && !daemon_socket && argc-optind > 3) {
+        graph_file = argv[optind+1];
+        act_file = argv[optind+2];
+        for (int i=optind+2; i<argc; i++) act_files.push_back(argv[i]);
+    }
+    if (fold_file && (act_files.size() > 1 || !act_file)) {
+        cerr << "Error! Folds are mined for a single activity file." << endl;
+        status = 1;
+    }
+
     if (status == 0) {
         // INTEGRITY CONSTRAINTS AND HELP OUTPUT
         //  ----------- !du ---------      ----------- !db ---------
@@ -373,15 +564,40 @@ int main(int argc, char *argv[], char *envp[]) {
         if (do_regression && (!adjust_ub || !do_backbone || !do_pruning) ) status = 2; // KS: enforce d,b,u flags not set
     }
 
-    bool input_smi = false, input_gsp = false;
+    bool input_smi = false, input_gsp = false, input_lat = false;
     string graph_file_str;
     if (graph_file) {
         graph_file_str = graph_file;
         string graph_file_suffix = graph_file_str.substr(graph_file_str.find_last_of("."));
         if (graph_file_suffix == ".smi") { input_smi=true; }
         else if (graph_file_suffix == ".gsp") { input_gsp=true; }
+        else if (graph_file_suffix == ".lat") { input_lat=true; }
         else { cerr << "Suffix " << graph_file_suffix << " unknown!" << endl; status=1;}
     }
+    if (resume && !checkpoint_file) {
+        cerr << "Error! A run is resumed from its checkpoint file (-C)." << endl;
+        status = 1;
+    }
+    if ((workers >= 0 || worker_spool) && (act_files.size() > 1 || fold_file || stats_file || checkpoint_file || lattice_file)) {
+        cerr << "Error! Workers mine a single endpoint, without -j, -C or -L." << endl;
+        status = 1;
+    }
+    if ((spool && workers < 0) || (worker_spool && workers >= 0)) {
+        cerr << "Error! A spool directory is given to the coordinator (-W, -S) or to a worker (-w)." << endl;
+        status = 1;
+    }
+    if (lattice_file && input_lat) {
+        cerr << "Error! A lattice is written from compounds in SMILES or gSpan format." << endl;
+        status = 1;
+    }
+
+    // forked workers and jobs of the daemon mined at the same time share the processors (FMINER_THREADS)
+    if (workers > 1 && !getenv("FMINER_THREADS")) {
+        long procs = sysconf(_SC_NPROCESSORS_ONLN);
+        ostringstream threads;
+        threads << (procs > workers ? procs / workers : 1);
+        setenv("FMINER_THREADS", threads.str().c_str(), 1);
+    }
 
     if (status==0 || status == 2) {
 
@@ -409,30 +625,44 @@ int main(int argc, char *argv[], char *envp[]) {
 
             bool all_args_good = 1; // switched to 0 in case of illegal arguments, as reported by lib.
 
-            if (graph_file && act_file) {
+            if (daemon_socket) {} // instances are created for each database, see serve()
+
+            else if (graph_file && act_file) {
                 fminer = create_lib();
-                if (do_regression != def_do_regression) all_args_good *= fminer->SetRegression(do_regression);
-                if (type != def_type || arg_type) all_args_good *= fminer->SetType(type);
+                if (do_regression != def_do_regression) all_args_good &= fminer->SetRegression(do_regression);
+                if (type != def_type || arg_type) all_args_good &= fminer->SetType(type);
                 if (minfreq != def_minfreq || arg_minfreq) fminer->SetMinfreq(minfreq);
-                if (chisq_sig != def_chisq_sig || arg_chisq_sig) all_args_good *= fminer->SetChisqSig(chisq_sig);
-                if (refine_singles != def_refine_singles) all_args_good *= fminer->SetRefineSingles(refine_singles);
+                if (chisq_sig != def_chisq_sig || arg_chisq_sig) all_args_good &= fminer->SetChisqSig(chisq_sig);
+                if (refine_singles != def_refine_singles) all_args_good &= fminer->SetRefineSingles(refine_singles);
                 if (aromatic != def_aromatic) fminer->SetAromatic(aromatic);
-                if (adjust_ub != def_adjust_ub) all_args_good *= fminer->SetDynamicUpperBound(adjust_ub);
-                if (do_pruning != def_do_pruning) all_args_good *= fminer->SetPruning(do_pruning);
-                if (do_backbone != def_do_backbone) all_args_good *= fminer->SetBackbone(do_backbone);
+                if (adjust_ub != def_adjust_ub) all_args_good &= fminer->SetDynamicUpperBound(adjust_ub);
+                if (do_pruning != def_do_pruning) all_args_good &= fminer->SetPruning(do_pruning);
+                if (do_backbone != def_do_backbone) all_args_good &= fminer->SetBackbone(do_backbone);
                 if (do_output != def_do_output) fminer->SetDoOutput(do_output);
-                //if (bbrc_sep != def_bbrc_sep) all_args_good *= fminer->SetBbrcSep(bbrc_sep); // Disabled for console output. Set manually to true and disable console output.
-                if (max_hops != def_max_hops || arg_max_hops)  all_args_good *= fminer->SetMaxHops(max_hops);
+                //if (bbrc_sep != def_bbrc_sep) all_args_good &= fminer->SetBbrcSep(bbrc_sep); // Disabled for console output. Set manually to true and disable console output.
+                if (max_hops != def_max_hops || arg_max_hops)  all_args_good &= fminer->SetMaxHops(max_hops);
+                if (memory_budget) all_args_good &= fminer->SetMemoryBudget(memory_budget << 20);
+                if (checkpoint_file) all_args_good &= fminer->SetCheckpoint(checkpoint_file, resume);
             }
 
             else if (graph_file) {
                 fminer = create_lib();
-                if (type != def_type || arg_type) all_args_good *= fminer->SetType(type);
+                if (type != def_type || arg_type) all_args_good &= fminer->SetType(type);
                 if (minfreq != def_minfreq || arg_minfreq) fminer->SetMinfreq(minfreq);
-                if (refine_singles != def_refine_singles) all_args_good *= fminer->SetRefineSingles(refine_singles);
+                if (refine_singles != def_refine_singles) all_args_good &= fminer->SetRefineSingles(refine_singles);
                 if (aromatic != def_aromatic) fminer->SetAromatic(aromatic);
                 if (do_output != def_do_output) fminer->SetDoOutput(do_output);
+                if (memory_budget) all_args_good &= fminer->SetMemoryBudget(memory_budget << 20);
                 fminer->SetChisqActive(false);
+                if (lattice_file) {
+                    lattice_out = fopen(lattice_file, "wb");
+                    if (!lattice_out) {
+                        cerr << "Error opening file '" << lattice_file << "': " << strerror(errno) << "." << endl;
+                        return 1;
+                    }
+                    all_args_good &= fminer->WriteLattice(lattice_out);
+                }
+                if (checkpoint_file) all_args_good &= fminer->SetCheckpoint(checkpoint_file, resume);
             }
 
             if (!all_args_good) status = 2;
@@ -442,13 +672,16 @@ int main(int argc, char *argv[], char *envp[]) {
     if (status > 0) {
         cerr << endl;
         cerr << "Fminer v2.0, Andreas Maunz, 2010" << endl;
-        cerr << "Usage 1: " << program_name << " <Library> <Options> <Graphs> <Activities>" << endl;
+        cerr << "Usage 1: " << program_name << " <Library> <Options> <Graphs> <Activities> [<Activities> ...]" << endl;
         cerr << "Usage 2: " << program_name << " <Library> <Options> <Graphs>" << endl;
+        cerr << "Usage 3: " << program_name << " <Library> -D <Socket> [-W n] <Graphs> [<Graphs> ...]" << endl;
         cerr << endl;
         cerr << "File formats:" << endl;
         cerr << "       <Library>    Plug-in library to use (/path/to/libbbrc.so or /path/to/liblast.so)." << endl;
-        cerr << "       <Graphs>     File should have suffix .smi or .gsp, indicating SMILES or gSpan format." << endl;
+        cerr << "       <Graphs>     File should have suffix .smi or .gsp, indicating SMILES or gSpan format," << endl;
+        cerr << "                    or .lat for a lattice written with -L, whose patterns are replayed (BBRC only)." << endl;
         cerr << "       <Activities> File must be in Activity format (suffix not relevant)." << endl;
+        cerr << "                    Several files are mined as separate endpoints in one pass (BBRC only)." << endl;
         cerr << endl;
 
     }
@@ -473,7 +706,13 @@ int main(int argc, char *argv[], char *envp[]) {
 
  
     // status 0 -> go ahead
-    fminer->SetConsoleOut(true);
+    if (daemon_socket) {
+        create0_t* create_lib = (create0_t*) dlsym(Lib, "create0");
+        serve(daemon_socket, databases, workers > 0 ? workers : 1, create_lib);
+    }
+    if (fold_file) read_folds (fold_file);
+    bool several = act_files.size() > 1 || fold_ids.size(); // endpoints, with their results printed after mining
+    if (!several) fminer->SetConsoleOut(true);
     
     //////////
     // READ //
@@ -484,14 +723,17 @@ int main(int argc, char *argv[], char *envp[]) {
         cerr << "Reading compounds..." << endl;
         if (input_smi) read_smi (graph_file);
         else if (input_gsp) read_gsp (graph_file);
+        else if (input_lat) read_lat (graph_file);
         cerr << "Reading activities..." << endl;
-        read_act (act_file, fminer->GetRegression());
+        if (act_files.size() < 2) read_act (act_file, fminer->GetRegression(), 0);
+        for (unsigned int e = 0; e < act_files.size(); e++) read_act (act_files[e], fminer->GetRegression(), e);
     }
     
     else if (graph_file) {
         cerr << "Reading compounds..." << endl;
         if (input_smi) read_smi(graph_file);
         else if (input_gsp) read_gsp(graph_file);
+        else if (input_lat) read_lat(graph_file);
     }
 
     //////////
@@ -502,17 +744,30 @@ int main(int argc, char *argv[], char *envp[]) {
 
     cerr << fminer->GetNoCompounds() << " compounds" << endl;
     clock_t t1 = clock ();
-    for ( int j = 0; j < (int) fminer->GetNoRootNodes(); j++ ) {
-        vector<string>* result = fminer->MineRoot(j);
-        if (!fminer->GetConsoleOut()) { 
-            each (*result) {
-                cout << (*result)[i] << endl;
-            }
+    vector<vector<string> > endpoint_results(several ? fminer->GetNoEndpoints() : 0);
+    if (worker_spool) work(args, worker_spool);
+    else if (workers >= 0) coordinate(args, spool, workers);
+    else mine(endpoint_results);
+    // one block per endpoint, headed by its activity file or fold
+    for (unsigned int e = 0; e < endpoint_results.size(); e++) {
+        if (fold_ids.size() && e) cout << "# fold " << fold_ids[e-1] << endl;
+        else if (several) cout << "# " << (act_files.size() ? act_files[e] : act_file) << endl;
+        each (endpoint_results[e]) {
+            cout << endpoint_results[e][i] << endl;
         }
     }
     clock_t t2 = clock ();
 //  statistics->print();
+    if (lattice_out) fclose(lattice_out);
     cerr << "Approximate total runtime: " << ( (float) t2 - t1 ) / CLOCKS_PER_SEC << "s" << endl;
+    unsigned long rss = peak_rss();
+    if (rss) cerr << "Peak memory usage: " << rss << "kB" << endl;
+
+    if (stats_file) {
+        ofstream stats(stats_file);
+        if (!stats) cerr << "Error! Cannot write statistics to '" << stats_file << "'." << endl;
+        else stats << fminer->GetStatistics();
+    }
     
     destroy_lib(fminer);
     dlclose(Lib);
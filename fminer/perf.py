@@ -0,0 +1,229 @@
+#!/usr/bin/env python
+# perf.py
+
+# This file is part of Fminer (fminer).
+#
+# Fminer is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# Fminer is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with Fminer.  If not, see <http://www.gnu.org/licenses/>.
+
+# Performance regression harness. Runs the frontend on the bundled datasets
+# with the configurations of the library test suites, verifies the output
+# against test/fminer_md5.yaml and compares wall time, CPU time, peak RSS,
+# pattern and search node counts to a stored baseline.
+# Run from the fminer directory, like test.sh. Exits non-zero on regression.
+
+import json
+import optparse
+import os
+import platform
+import subprocess
+import sys
+import tempfile
+import time
+
+try:
+    from hashlib import md5
+except ImportError:
+    from md5 import md5
+
+# library -> list of (config name, fminer arguments relative to the test directory)
+CONFIGS = {
+    'bbrc': [
+        ('default',     ['hamster_carcinogenicity.smi', 'hamster_carcinogenicity.class']),
+        ('multinomial', ['hamster_carcinogenicity.smi', 'hamster_carcinogenicity-multinomial.class']),
+        ('kekule',      ['-a', 'hamster_carcinogenicity.smi', 'hamster_carcinogenicity.class']),
+        ('regression',  ['-g', '-f5', 'EPAFHM.smi', 'EPAFHM.act']),
+    ],
+    'last': [
+        ('default',     ['hamster_carcinogenicity.smi', 'hamster_carcinogenicity.class']),
+        ('multinomial', ['-f5', 'hamster_carcinogenicity.smi', 'hamster_carcinogenicity-multinomial.class']),
+        ('kekule',      ['-a', 'hamster_carcinogenicity.smi', 'hamster_carcinogenicity.class']),
+        ('regression',  ['-g', '-f5', 'EPAFHM.smi', 'EPAFHM.act']),
+    ],
+}
+
+# environment of the ruby test suites (tc_fminer_ruby.rb), plus search statistics
+ENV_SET = {'FMINER_LAZAR': '1', 'FMINER_SMARTS': '1', 'FMINER_STATISTICS': '1'}
+ENV_UNSET = ['FMINER_SILENT', 'FMINER_NR_HITS', 'FMINER_PVALUES', 'FMINER_NO_AROMATIC_WC']
+
+
+def read_md5_yaml(path):
+    """Parses the two-level arch/config md5 files of the test suites."""
+    res = {}
+    arch = None
+    f = open(path)
+    for line in f:
+        if not line.strip():
+            continue
+        if not line[0].isspace():
+            arch = line.strip().rstrip(':')
+            res[arch] = {}
+        elif arch is not None:
+            key, val = line.strip().split(':', 1)
+            res[arch][key.strip()] = val.strip()
+    f.close()
+    return res
+
+
+def count_patterns(lib, out):
+    if lib == 'last':
+        return out.count(b'<graph ')
+    return len([l for l in out.split(b'\n') if l.strip()])
+
+
+def peak_rss(err, rss):
+    """Peak RSS as reported by the frontend, which excludes the launcher."""
+    for line in err.split(b'\n'):
+        if line.startswith(b'Peak memory usage:'):
+            return int(line.split(b':', 1)[1].strip().rstrip(b'kB'))
+    return rss
+
+
+def count_nodes(err):
+    """Total search nodes from the FMINER_STATISTICS summary, None if absent."""
+    lines = err.split(b'\n')
+    for i in range(len(lines) - 1):
+        if lines[i].strip() == b'TOTAL:':
+            return int(lines[i + 1].rsplit(b'total:', 1)[1])
+    return None
+
+
+def run_once(cmd, cwd, env):
+    out = tempfile.TemporaryFile()
+    err = tempfile.TemporaryFile()
+    start = time.time()
+    p = subprocess.Popen(cmd, cwd=cwd, env=env, stdout=out, stderr=err)
+    pid, status, ru = os.wait4(p.pid, 0)
+    wall = time.time() - start
+    p.returncode = status
+    out.seek(0)
+    err.seek(0)
+    res = (status, wall, ru.ru_utime + ru.ru_stime, ru.ru_maxrss, out.read(), err.read())
+    out.close()
+    err.close()
+    return res
+
+
+def run_config(opts, lib, name, args, expected):
+    testdir = os.path.abspath(os.path.join('..', 'lib' + lib, 'test'))
+    libpath = os.path.abspath(getattr(opts, 'lib' + lib))
+    cmd = [os.path.abspath(opts.fminer), libpath] + args
+    env = dict(os.environ)
+    for k in ENV_UNSET:
+        env.pop(k, None)
+    env.update(ENV_SET)
+
+    r = {}
+    for i in range(opts.repeat):
+        status, wall, cpu, rss, out, err = run_once(cmd, testdir, env)
+        if status != 0:
+            sys.stderr.write("Error! '%s' exited with status %d.\n" % (' '.join(cmd), status))
+            return None
+        # best of n for timings, the rest is deterministic
+        if not r or wall < r['wall']:
+            r['wall'] = wall
+        if 'cpu' not in r or cpu < r['cpu']:
+            r['cpu'] = cpu
+        r['rss'] = max(r.get('rss', 0), peak_rss(err, rss))
+    r['md5'] = md5(out).hexdigest()
+    r['md5_ok'] = expected is None or r['md5'] == expected
+    r['patterns'] = count_patterns(lib, out)
+    r['nodes'] = count_nodes(err)
+    return r
+
+
+def compare(key, cur, base, tol, slack):
+    """Returns a list of regression messages for one configuration."""
+    msgs = []
+    if cur['patterns'] != base.get('patterns'):
+        msgs.append('patterns %s -> %s' % (base.get('patterns'), cur['patterns']))
+    if cur['nodes'] is not None and base.get('nodes') is not None:
+        if cur['nodes'] > base['nodes'] * (1.0 + tol):
+            msgs.append('nodes %d -> %d' % (base['nodes'], cur['nodes']))
+    for m in ['wall', 'cpu']:
+        if m in base and cur[m] > base[m] * (1.0 + tol) + slack:
+            msgs.append('%s %.3fs -> %.3fs' % (m, base[m], cur[m]))
+    if 'rss' in base and cur['rss'] > base['rss'] * (1.0 + tol):
+        msgs.append('rss %dkB -> %dkB' % (base['rss'], cur['rss']))
+    return msgs
+
+
+def main():
+    parser = optparse.OptionParser(usage='%prog [options] [lib/config ...]')
+    parser.add_option('--fminer', default='./fminer', help='frontend binary (default: %default)')
+    parser.add_option('--libbbrc', default='../libbbrc/libbbrc.so', help='(default: %default)')
+    parser.add_option('--liblast', default='../liblast/liblast.so', help='(default: %default)')
+    parser.add_option('-r', '--repeat', type='int', default=3, help='runs per configuration, best time counts (default: %default)')
+    parser.add_option('-b', '--baseline', default='test/perf_baseline.json', help='baseline file (default: %default)')
+    parser.add_option('-t', '--tolerance', type='float', default=0.10, help='relative tolerance (default: %default)')
+    parser.add_option('-s', '--slack', type='float', default=0.05, help='absolute tolerance for timings in seconds (default: %default)')
+    parser.add_option('-o', '--output', help='write results as JSON to this file')
+    parser.add_option('-u', '--update', action='store_true', help='store results as new baseline')
+    parser.add_option('--no-md5', action='store_true', help='do not verify output checksums')
+    opts, sel = parser.parse_args()
+
+    arch = platform.machine()
+    results = {}
+    failed = False
+    for lib in ['bbrc', 'last']:
+        md5s = {}
+        if not opts.no_md5:
+            yaml = read_md5_yaml(os.path.join('..', 'lib' + lib, 'test', 'fminer_md5.yaml'))
+            if arch in yaml:
+                md5s = yaml[arch]
+            else:
+                sys.stderr.write("Notice: No checksums for architecture '%s'.\n" % arch)
+        for name, args in CONFIGS[lib]:
+            key = lib + '/' + name
+            if sel and key not in sel and lib not in sel:
+                continue
+            r = run_config(opts, lib, name, args, md5s.get(name))
+            if r is None:
+                failed = True
+                continue
+            results[key] = r
+            sys.stderr.write('%-18s wall %8.3fs cpu %8.3fs rss %8dkB patterns %7d nodes %9s md5 %s\n' %
+                (key, r['wall'], r['cpu'], r['rss'], r['patterns'], r['nodes'], r['md5_ok'] and 'ok' or 'MISMATCH'))
+            if not r['md5_ok']:
+                failed = True
+
+    report = {'arch': arch, 'repeat': opts.repeat, 'results': results}
+    if opts.output:
+        f = open(opts.output, 'w')
+        json.dump(report, f, indent=1, sort_keys=True)
+        f.close()
+
+    if opts.update:
+        f = open(opts.baseline, 'w')
+        json.dump(report, f, indent=1, sort_keys=True)
+        f.close()
+        sys.stderr.write("Baseline written to '%s'.\n" % opts.baseline)
+    elif os.path.exists(opts.baseline):
+        f = open(opts.baseline)
+        base = json.load(f)['results']
+        f.close()
+        for key in sorted(results.keys()):
+            if key not in base:
+                continue
+            msgs = compare(key, results[key], base[key], opts.tolerance, opts.slack)
+            if msgs:
+                failed = True
+                sys.stderr.write('REGRESSION %s: %s\n' % (key, ', '.join(msgs)))
+    else:
+        sys.stderr.write("Notice: No baseline '%s', use -u to create one.\n" % opts.baseline)
+
+    return failed and 1 or 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -41,6 +41,140 @@ testBbrcFsmP0Classification()
   fi
 }
 
+testBbrcStatistics()
+{
+  mkdir $testdir >/dev/null 2>&1
+  rm -f $testdir/stats.json
+  $fminer $libbrc -j $testdir/stats.json $hamster>$testdir/tmp4 2>$testdir/tmp4e
+  h=`md5sum $testdir/tmp4 | sed 's/\s.*//g'`
+  r=`grep -c '"root": ' $testdir/stats.json`
+  assertEquals "testBbrcStatistics" "$h" "`md5sum $testdir/tmp1 | sed 's/\s.*//g'`"
+  assertTrue "testBbrcStatistics" "[ $r -gt 0 ]"
+}
+
+testBbrcStatisticCache()
+{
+  mkdir $testdir >/dev/null 2>&1
+  multinomial='../libbbrc/test/hamster_carcinogenicity.smi ../libbbrc/test/hamster_carcinogenicity-multinomial.class'
+  for job in ":$hamster" "$fsmargs:$hamster" "-f5:$multinomial" "-g -f5:$epafhm"; do
+    # all legs in one slot, so that each hit is checked against the evaluation without cache
+    FMINER_STATISTIC_CACHE=1 $fminer $libbrc ${job%%:*} ${job#*:}>$testdir/tmp14 2>$testdir/tmp14e
+    h=`md5sum $testdir/tmp14 | sed 's/\s.*//g'`
+    assertEquals "testBbrcStatisticCache" "$h" "`FMINER_STATISTIC_CACHE=0 $fminer $libbrc ${job%%:*} ${job#*:} 2>/dev/null | md5sum | sed 's/\s.*//g'`"
+  done
+}
+
+testBbrcEndpoints()
+{
+  mkdir $testdir >/dev/null 2>&1
+  awk -F'\t' 'BEGIN{OFS="\t"} {$3=1-$3; print}' ${hamster#* } >$testdir/flipped
+  for args in "" "$fsmargs"; do
+    # each block against a plain run on its activity file
+    $fminer $libbrc $args $hamster $testdir/flipped>$testdir/tmp6 2>$testdir/tmp6e
+    $fminer $libbrc $args ${hamster% *} $testdir/flipped>$testdir/tmp6p 2>/dev/null
+    h=`awk '/^# /{n++;next} n==1' $testdir/tmp6 | md5sum | sed 's/\s.*//g'`
+    assertEquals "testBbrcEndpoints" "$h" "`$fminer $libbrc $args $hamster 2>/dev/null | md5sum | sed 's/\s.*//g'`"
+    h=`awk '/^# /{n++;next} n==2' $testdir/tmp6 | md5sum | sed 's/\s.*//g'`
+    assertEquals "testBbrcEndpoints" "$h" "`md5sum $testdir/tmp6p | sed 's/\s.*//g'`"
+  done
+}
+
+testBbrcFolds()
+{
+  mkdir $testdir >/dev/null 2>&1
+  awk -F'\t' '{print $1"\t"(NR%3)}' ${hamster#* } >$testdir/folds
+  $fminer $libbrc $fsmargs -F $testdir/folds $hamster>$testdir/tmp5 2>$testdir/tmp5e
+  for k in 0 1 2; do
+    # a fold against a separate run on its training part, fragments compared by their occurrences
+    awk -F'\t' -v k=$k 'NR==FNR{f[$1]=$2;next} f[$1]!=k' $testdir/folds ${hamster#* } >$testdir/train$k
+    $fminer $libbrc $fsmargs ${hamster% *} $testdir/train$k 2>/dev/null | sed 's/^[^,]*, //' | sort >$testdir/tmp5s
+    h=`awk -v k=$k '/^# /{on=($0=="# fold " k);next} on' $testdir/tmp5 | sed 's/^[^,]*, //' | sort | md5sum | sed 's/\s.*//g'`
+    assertEquals "testBbrcFolds" "$h" "`md5sum $testdir/tmp5s | sed 's/\s.*//g'`"
+  done
+}
+
+testBbrcCheckpoint()
+{
+  mkdir $testdir >/dev/null 2>&1
+  for args in "" "$fsmargs"; do
+    # interrupted when the output reaches 2kB (SIGXFSZ), then resumed
+    rm -f $testdir/checkpoint
+    ( exec 2>/dev/null; ulimit -f 4; FMINER_CHECKPOINT_INTERVAL=0 $fminer $libbrc $args --checkpoint=$testdir/checkpoint $hamster>$testdir/tmp9; true )
+    FMINER_CHECKPOINT_INTERVAL=0 $fminer $libbrc $args --checkpoint=$testdir/checkpoint --resume $hamster>>$testdir/tmp9 2>$testdir/tmp9e
+    r=`grep -c '^Resuming' $testdir/tmp9e`
+    assertEquals "testBbrcCheckpoint" "$r" "1"
+    h=`md5sum $testdir/tmp9 | sed 's/\s.*//g'`
+    assertEquals "testBbrcCheckpoint" "$h" "`$fminer $libbrc $args $hamster 2>/dev/null | md5sum | sed 's/\s.*//g'`"
+  done
+}
+
+testBbrcLattice()
+{
+  mkdir $testdir >/dev/null 2>&1
+  rm -f $testdir/hamster.lat
+  $fminer $libbrc --lattice=$testdir/hamster.lat ${hamster% *} >/dev/null 2>&1
+  for args in "" "$fsmargs" "-f4"; do
+    # the replay against mining the compounds
+    $fminer $libbrc $args $testdir/hamster.lat ${hamster#* }>$testdir/tmp8 2>$testdir/tmp8e
+    h=`md5sum $testdir/tmp8 | sed 's/\s.*//g'`
+    assertEquals "testBbrcLattice" "$h" "`$fminer $libbrc $args $hamster 2>/dev/null | md5sum | sed 's/\s.*//g'`"
+  done
+}
+
+testBbrcWorkers()
+{
+  mkdir $testdir >/dev/null 2>&1
+  for args in "" "$fsmargs"; do
+    # graphs in gSpan format numbered as by a single process
+    env -u FMINER_SMARTS $fminer $libbrc $args --workers=2 $hamster>$testdir/tmp10 2>$testdir/tmp10e
+    h=`md5sum $testdir/tmp10 | sed 's/\s.*//g'`
+    assertEquals "testBbrcWorkers" "$h" "`env -u FMINER_SMARTS $fminer $libbrc $args $hamster 2>/dev/null | md5sum | sed 's/\s.*//g'`"
+    $fminer $libbrc $args --workers=2 $hamster>$testdir/tmp10 2>$testdir/tmp10e
+    h=`md5sum $testdir/tmp10 | sed 's/\s.*//g'`
+    assertEquals "testBbrcWorkers" "$h" "`$fminer $libbrc $args $hamster 2>/dev/null | md5sum | sed 's/\s.*//g'`"
+  done
+}
+
+testBbrcThreads()
+{
+  mkdir $testdir >/dev/null 2>&1
+  for args in "" "$fsmargs" "--memory-budget=1"; do
+    # occurrence lists and sibling joins split from 4 occurrences on
+    FMINER_THREADS=4 FMINER_CHUNK_SIZE=4 $fminer $libbrc --statistics=$testdir/tmp13 $args $hamster>$testdir/tmp12 2>$testdir/tmp12e
+    h=`md5sum $testdir/tmp12 | sed 's/\s.*//g'`
+    assertEquals "testBbrcThreads" "$h" "`FMINER_THREADS=1 $fminer $libbrc $args $hamster 2>/dev/null | md5sum | sed 's/\s.*//g'`"
+    # the sibling joins are released with their level, only the leg pools hold occurrences after mining
+    assertTrue "testBbrcThreads" "grep -q '\"occurrence_bytes\": {\"current\": \([0-9]*\), \"pooled\": \1,' $testdir/tmp13"
+  done
+}
+
+testBbrcDaemon()
+{
+  mkdir $testdir >/dev/null 2>&1
+  rm -f $testdir/sock
+  cp $hamster $testdir
+  head -60 ${hamster#* } >$testdir/part.class
+  $fminer $libbrc --daemon=$testdir/sock $testdir/hamster_carcinogenicity.smi 2>$testdir/tmp11d &
+  daemon=$!
+  while [ ! -S $testdir/sock ] && kill -0 $daemon 2>/dev/null; do sleep 1; done
+  assertEquals "testBbrcDaemon" "srwx------" "`ls -l $testdir/sock | cut -c1-10`"
+  # each job against a plain run with its settings, compounds without activity left out
+  for job in "activities hamster_carcinogenicity.class::${hamster#* }" "activities hamster_carcinogenicity.class\nno-aromaticity:-a:${hamster#* }" "activities part.class\nminfreq 4:-f4:$testdir/part.class" "::" "activities hamster_carcinogenicity.class::${hamster#* }"; do
+    printf "database hamster_carcinogenicity\n${job%%:*}\nmine\n" | perl -MIO::Socket::UNIX -e '$s = IO::Socket::UNIX->new(Peer => $ARGV[0]) or die; print $s <STDIN>; shutdown($s, 1); print while <$s>;' $testdir/sock>$testdir/tmp11 2>$testdir/tmp11e
+    args=${job#*:}
+    assertEquals "testBbrcDaemon" "." "`tail -n 1 $testdir/tmp11`"
+    h=`sed '$d' $testdir/tmp11 | md5sum | sed 's/\s.*//g'`
+    assertEquals "testBbrcDaemon" "$h" "`$fminer $libbrc ${args%:*} ${hamster% *} ${args#*:} 2>/dev/null | md5sum | sed 's/\s.*//g'`"
+  done
+  # the database is built once for each settings
+  assertEquals "testBbrcDaemon" "4" "`grep -c '^Settings' $testdir/tmp11d`"
+  # activities outside the directory of the database
+  printf "database hamster_carcinogenicity\nactivities ../${hamster#* }\nmine\n" | perl -MIO::Socket::UNIX -e '$s = IO::Socket::UNIX->new(Peer => $ARGV[0]) or die; print $s <STDIN>; shutdown($s, 1); print while <$s>;' $testdir/sock>$testdir/tmp11 2>$testdir/tmp11e
+  assertEquals "testBbrcDaemon" "Error!" "`cut -d' ' -f1 $testdir/tmp11`"
+  kill $daemon
+  wait $daemon
+}
+
 #-----------------------------------------------------------------------------
 # suite functions
 #
@@ -146,7 +146,11 @@
  * <b>FMINER_PVALUES</b>     : Produce p-values instead of chi-square values (e.g. export FMINER_PVALUES=1).<br />
  * <b>FMINER_NO_AROMATIC_WC</b>: Disallow aromatic wildcard bonds on aliphatic bonds, when aromatic perception was switched off ('-a') (e.g. export FMINER_NO_AROMATIC_WC=1).<br />
  * <b>FMINER_SILENT</b>      : Redirect STDERR (debug output) of fminer to local file 'fminer_debug.txt'<br />
- * <b>FMINER_NR_HITS</b>     : Display (in the occurrence lists) the number of times each fragment occurs in a molecule.
+ * <b>FMINER_NR_HITS</b>     : Display (in the occurrence lists) the number of times each fragment occurs in a molecule.<br />
+ * <b>FMINER_STATISTICS</b>  : Print the number of search nodes per pattern size to STDERR when the instance is destroyed. Counters of candidates, pruned branches and BBRC representatives per root and depth are always available as JSON from Bbrc::GetStatistics() (frontend: '-j').<br />
+ * <b>FMINER_PROGRESS</b>    : Print a progress line (root, depth, nodes per second, representatives, memory, ETA for the current root) to STDERR every given number of seconds (default 10) while mining.<br />
+ * <b>FMINER_PROFILE</b>     : Write time spent per phase as JSON to the given file when the instance is destroyed. Requires compiling with -DFMINER_PROFILE (PROFILE line in the Makefile), costs nothing otherwise.<br />
+ * <b>FMINER_TRACE</b>       : Write the coarse phases (database setup, mining per root) as Chrome trace events to the given file. Same requirement as FMINER_PROFILE.
 
 
  *
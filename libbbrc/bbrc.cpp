@@ -22,7 +22,12 @@
 #include "bbrc.h"
 #include "globals.h"
 #include "ranker.h"
+#include "profile.h"
 
+#ifdef FMINER_PROFILE
+// sets the epoch of the phase timers when the library is loaded
+static struct BbrcProfileStart { BbrcProfileStart() { BbrcProfile::start(); } } bbrc_profile_start;
+#endif
 
 // 1. Constructors and Initializers
 
@@ -40,6 +45,11 @@ Bbrc::Bbrc() : init_mining_done(false) {
         FILE* fp = freopen ("fminer_debug.txt","w",stderr);
       }
       if (getenv("FMINER_NR_HITS")) fm::bbrc_nr_hits = true;
+      if (getenv("FMINER_PROGRESS")) fm::bbrc_progress = atoi(getenv("FMINER_PROGRESS")) > 0 ? atoi(getenv("FMINER_PROGRESS")) : 10;
+      if (getenv("FMINER_THREADS")) fm::bbrc_threads = atoi(getenv("FMINER_THREADS")) > 0 ? atoi(getenv("FMINER_THREADS")) : 1;
+      if (getenv("FMINER_CHUNK_SIZE") && atoi(getenv("FMINER_CHUNK_SIZE")) > 0) fm::bbrc_chunk_size = atoi(getenv("FMINER_CHUNK_SIZE"));
+      if (getenv("FMINER_STATISTIC_CACHE")) fm::bbrc_statistic_cache = atoi(getenv("FMINER_STATISTIC_CACHE")) > 0 ? atoi(getenv("FMINER_STATISTIC_CACHE")) : 0;
+      if (getenv("FMINER_CHECKPOINT_INTERVAL")) fm::bbrc_checkpoint_interval = atoi(getenv("FMINER_CHECKPOINT_INTERVAL")) > 0 ? atoi(getenv("FMINER_CHECKPOINT_INTERVAL")) : 0;
   }
   else {
     cerr << "Error! Cannot create more than 1 instance." << endl; 
@@ -63,6 +73,11 @@ Bbrc::Bbrc(int _type, unsigned int _minfreq) : init_mining_done(false) {
         FILE* fp = freopen ("fminer_debug.txt","w",stderr);
       }
       if (getenv("FMINER_NR_HITS")) fm::bbrc_nr_hits = true;
+      if (getenv("FMINER_PROGRESS")) fm::bbrc_progress = atoi(getenv("FMINER_PROGRESS")) > 0 ? atoi(getenv("FMINER_PROGRESS")) : 10;
+      if (getenv("FMINER_THREADS")) fm::bbrc_threads = atoi(getenv("FMINER_THREADS")) > 0 ? atoi(getenv("FMINER_THREADS")) : 1;
+      if (getenv("FMINER_CHUNK_SIZE") && atoi(getenv("FMINER_CHUNK_SIZE")) > 0) fm::bbrc_chunk_size = atoi(getenv("FMINER_CHUNK_SIZE"));
+      if (getenv("FMINER_STATISTIC_CACHE")) fm::bbrc_statistic_cache = atoi(getenv("FMINER_STATISTIC_CACHE")) > 0 ? atoi(getenv("FMINER_STATISTIC_CACHE")) : 0;
+      if (getenv("FMINER_CHECKPOINT_INTERVAL")) fm::bbrc_checkpoint_interval = atoi(getenv("FMINER_CHECKPOINT_INTERVAL")) > 0 ? atoi(getenv("FMINER_CHECKPOINT_INTERVAL")) : 0;
 
   }
   else {
@@ -90,6 +105,11 @@ Bbrc::Bbrc(int _type, unsigned int _minfreq, float _chisq_val, bool _do_backbone
         FILE* fp = freopen ("fminer_debug.txt","w",stderr);
       }
       if (getenv("FMINER_NR_HITS")) fm::bbrc_nr_hits = true;
+      if (getenv("FMINER_PROGRESS")) fm::bbrc_progress = atoi(getenv("FMINER_PROGRESS")) > 0 ? atoi(getenv("FMINER_PROGRESS")) : 10;
+      if (getenv("FMINER_THREADS")) fm::bbrc_threads = atoi(getenv("FMINER_THREADS")) > 0 ? atoi(getenv("FMINER_THREADS")) : 1;
+      if (getenv("FMINER_CHUNK_SIZE") && atoi(getenv("FMINER_CHUNK_SIZE")) > 0) fm::bbrc_chunk_size = atoi(getenv("FMINER_CHUNK_SIZE"));
+      if (getenv("FMINER_STATISTIC_CACHE")) fm::bbrc_statistic_cache = atoi(getenv("FMINER_STATISTIC_CACHE")) > 0 ? atoi(getenv("FMINER_STATISTIC_CACHE")) : 0;
+      if (getenv("FMINER_CHECKPOINT_INTERVAL")) fm::bbrc_checkpoint_interval = atoi(getenv("FMINER_CHECKPOINT_INTERVAL")) > 0 ? atoi(getenv("FMINER_CHECKPOINT_INTERVAL")) : 0;
 
   }
   else {
@@ -101,6 +121,12 @@ Bbrc::Bbrc(int _type, unsigned int _minfreq, float _chisq_val, bool _do_backbone
 
 Bbrc::~Bbrc() {
     if (fm::bbrc_instance_present) {
+        if (getenv("FMINER_STATISTICS") && fm::bbrc_statistics) fm::bbrc_statistics->print();
+#ifdef FMINER_PROFILE
+        if (getenv("FMINER_PROFILE")) { ofstream f(getenv("FMINER_PROFILE")); BbrcProfile::write_json(f); }
+        if (getenv("FMINER_TRACE")) { ofstream f(getenv("FMINER_TRACE")); BbrcProfile::write_trace(f); }
+#endif
+        ClearEndpoints();
         delete fm::bbrc_database;
         delete fm::bbrc_statistics; 
         delete fm::bbrc_chisq; 
@@ -108,8 +134,20 @@ Bbrc::~Bbrc() {
         delete fm::bbrc_graphstate;
         delete fm::bbrc_closelegoccurrences;
         delete fm::bbrc_legoccurrences;
+        delete fm::bbrc_lattice;
+        fm::bbrc_lattice = NULL;
+        delete fm::bbrc_checkpoint;
+        fm::bbrc_checkpoint = NULL;
 
         fm::bbrc_Bbrccandidatelegsoccurrences.clear();
+        fm::bbrc_candidatelabels.clear();
+        fm::bbrc_candidatelastself.clear();
+        fm::bbrc_candidatetouched.clear();
+        fm::bbrc_legchunks.clear();
+        fm::bbrc_siblingjoins.clear();
+        fm::bbrc_pathlegpool.clear();
+        fm::bbrc_treelegpool.clear();
+        fm::bbrc_closelegpool.clear();
         fm::bbrc_candidatecloselegsoccs.clear();
         fm::bbrc_candidateBbrccloselegsoccsused.clear();
 
@@ -119,6 +157,7 @@ Bbrc::~Bbrc() {
 
 void Bbrc::Reset() { 
     if (fm::bbrc_instance_present) {
+        ClearEndpoints();
         delete fm::bbrc_database;
         delete fm::bbrc_statistics;
         delete fm::bbrc_chisq;
@@ -126,7 +165,11 @@ void Bbrc::Reset() {
         delete fm::bbrc_graphstate;
         delete fm::bbrc_closelegoccurrences;
         delete fm::bbrc_legoccurrences;
+        delete fm::bbrc_lattice;
+        delete fm::bbrc_checkpoint;
     }
+    fm::bbrc_lattice = NULL;
+    fm::bbrc_checkpoint = NULL;
     fm::bbrc_database = new BbrcDatabase();
     fm::bbrc_db_built = false;
     fm::bbrc_statistics = new BbrcStatistics();
@@ -137,6 +180,14 @@ void Bbrc::Reset() {
     fm::bbrc_legoccurrences = new BbrcLegOccurrences();
 
     fm::bbrc_Bbrccandidatelegsoccurrences.clear();
+    fm::bbrc_candidatelabels.clear();
+    fm::bbrc_candidatelastself.clear();
+    fm::bbrc_candidatetouched.clear();
+    fm::bbrc_legchunks.clear();
+    fm::bbrc_siblingjoins.clear();
+    fm::bbrc_pathlegpool.clear();
+    fm::bbrc_treelegpool.clear();
+    fm::bbrc_closelegpool.clear();
     fm::bbrc_candidatecloselegsoccs.clear();
     fm::bbrc_candidateBbrccloselegsoccsused.clear();
 
@@ -151,6 +202,8 @@ void Bbrc::Reset() {
     inchi_compound_map.clear();
     inchi_compound_mmap.clear();
     activity_map.clear();
+    endpoint_maps.clear();
+    structures.clear();
 
     if (getenv("FMINER_SILENT")) {
         fclose (stderr);
@@ -158,6 +211,16 @@ void Bbrc::Reset() {
     }
 }
 
+// Deletes the constraints of the further endpoints, those of the first are deleted with the others.
+void Bbrc::ClearEndpoints() {
+    for (unsigned int e = 1; e < fm::bbrc_endpoints.size(); e++) {
+        delete fm::bbrc_endpoints[e].chisq;
+        delete fm::bbrc_endpoints[e].ks;
+    }
+    fm::bbrc_endpoints.clear();
+    endpoint_results.clear();
+}
+
 void Bbrc::Defaults() {
     fm::bbrc_minfreq = 2;
     fm::bbrc_type = 2;
@@ -167,13 +230,20 @@ void Bbrc::Defaults() {
     fm::bbrc_refine_singles = false;
     fm::bbrc_do_output=true;
     fm::bbrc_bbrc_sep=false;
-    fm::bbrc_updated = true;
     fm::bbrc_gsp_out=true;
     fm::bbrc_nr_hits = false;
+    fm::bbrc_progress = 0;
+    fm::bbrc_threads = sysconf(_SC_NPROCESSORS_ONLN) > 0 ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+    fm::bbrc_chunk_size = 32768;
+    fm::bbrc_statistic_cache = 4096;
+    fm::bbrc_checkpoint_interval = 60;
+    fm::bbrc_memory_budget = 0;
+    fm::bbrc_unit = NOLEG;
 
     // BBRC
     fm::bbrc_ks->sig = 0.95;
     fm::bbrc_chisq->sig = -1.0;
+    fm::bbrc_chisq->level = 0.95;
     fm::bbrc_do_backbone = true;
     fm::bbrc_adjust_ub = true;
     fm::bbrc_regression=false;
@@ -349,9 +419,10 @@ bool Bbrc::SetChisqSig(float _chisq_val) {
          fm::bbrc_ks->sig = _chisq_val; 
     }
     else {
+        fm::bbrc_chisq->level = _chisq_val;
         fm::bbrc_chisq->sig = gsl_cdf_chisq_Pinv(_chisq_val, 1);
-        return 1;
     }
+    return 1;
 }
 
 bool Bbrc::SetRegression(bool val) {
@@ -368,6 +439,17 @@ bool Bbrc::SetRegression(bool val) {
     return 1;
 }
 
+bool Bbrc::SetMemoryBudget(unsigned long bytes) {
+    fm::bbrc_memory_budget = bytes;
+    return 1;
+}
+
+bool Bbrc::SetCheckpoint(string file, bool resume) {
+    delete fm::bbrc_checkpoint;
+    fm::bbrc_checkpoint = new BbrcCheckpoint(file, resume);
+    return 1;
+}
+
 // Forbidden in BBRC
 bool Bbrc::SetMaxHops(int val) {
     return 0;
@@ -375,88 +457,179 @@ bool Bbrc::SetMaxHops(int val) {
 
 // 4. Other methods
 
-vector<string>* Bbrc::MineRoot(unsigned int j) {
-    fm::bbrc_result->clear();
-    if (!init_mining_done) {
-        if (!fm::bbrc_db_built) {
-          AddDataCanonical();
-        }
-        // Adjust chisq bound
-        if (!fm::bbrc_regression) {
-          if (fm::bbrc_chisq->nr_acts.size()>1 && fm::bbrc_chisq->nr_acts.size() < 6) {
-            if (fm::bbrc_chisq->sig == -1.0) { // do not override user-supplied threshold, only machine default.
-              fm::bbrc_chisq->sig=fm::bbrc_chisq->df_thresholds[fm::bbrc_chisq->nr_acts.size()-1];
-            }
-          }
-          else if (fm::bbrc_chisq->nr_acts.size()==1) {
-            cout << "";
-          }
-          else {
-            cerr << "Error! Too many classes: '" << fm::bbrc_chisq->nr_acts.size() << "' (Max. 5)." << endl;
-            exit(1);
-          }
-        }
-        fm::bbrc_database->edgecount (); 
-        fm::bbrc_database->reorder (); 
-        BbrcinitBbrcLegStatics (); 
-        fm::bbrc_graphstate->init (); 
-        if (fm::bbrc_bbrc_sep && !fm::bbrc_do_backbone && fm::bbrc_do_output && !fm::bbrc_console_out) (*fm::bbrc_result) << fm::bbrc_graphstate->sep();
-        init_mining_done=true; 
-
-        if (!fm::bbrc_regression) {
-             cerr << "Settings:" << endl \
-             << "---" << endl \
-             << "Type:                                 " << GetType() << endl \
-             << "Minimum frequency:                    " << GetMinfreq() << endl \
-             << "Aromatic:                             " << GetAromatic() << endl \
-             << "Chi-square active (chi-square-value): " << GetChisqActive() << " (" << GetChisqSig()<< ")" << endl \
-             << "BBRC mining:                          " << GetBackbone() << endl \
-             << "Statistical metric (dynamic) pruning: " << GetPruning() << " (" << GetDynamicUpperBound() << ")" << endl \
-             << "Refine patterns with single support:  " << GetRefineSingles() << endl \
-             << "Do output:                            " << GetDoOutput() << endl \
-             << "BBRC sep:                             " << GetBbrcSep() << endl \
-             << "Regression:                           " << GetRegression() << endl \
-             << "---" << endl;
+// Builds the database and the search settings before the first root is mined.
+void Bbrc::InitMining() {
+    if (init_mining_done) return;
+    if (!fm::bbrc_db_built) {
+      AddDataCanonical();
+    }
+    // Further endpoints: settings of the first
+    for (unsigned int e = 1; e < fm::bbrc_endpoints.size(); e++) {
+      fm::bbrc_endpoints[e].chisq->sig = fm::bbrc_chisq->sig;
+      fm::bbrc_endpoints[e].chisq->level = fm::bbrc_chisq->level;
+      fm::bbrc_endpoints[e].chisq->active = fm::bbrc_chisq->active;
+      fm::bbrc_endpoints[e].ks->sig = fm::bbrc_ks->sig;
+    }
+    if (fm::bbrc_endpoints.size() > 1 && fm::bbrc_console_out) {
+      cerr << "Notice: Disabling console output, using result vectors for several endpoints." << endl;
+      fm::bbrc_console_out = false;
+    }
+    // Adjust chisq bound
+    if (!fm::bbrc_regression) {
+      for (unsigned int e = 0; e < fm::bbrc_endpoints.size(); e++) {
+        ChisqBbrcConstraint* chisq = fm::bbrc_endpoints[e].chisq;
+        if (chisq->nr_acts.size()>1) { // k classes: k-1 degrees of freedom
+          chisq->sig = gsl_cdf_chisq_Pinv(chisq->level, chisq->nr_acts.size()-1);
         }
-        else {
-             cerr << "Settings:" << endl \
-             << "---" << endl \
-             << "Type:                                 " << GetType() << endl \
-             << "Minimum frequency:                    " << GetMinfreq() << endl \
-             << "Aromatic:                             " << GetAromatic() << endl \
-             << "KS active (p-value):                  " << GetChisqActive() << " (" << GetChisqSig()<< ")" << endl \
-             << "BBRC mining:                          " << GetBackbone() << endl \
-             << "Statistical metric (dynamic) pruning: " << GetPruning() << " (" << GetDynamicUpperBound() << ")" << endl \
-             << "Refine patterns with single support:  " << GetRefineSingles() << endl \
-             << "Do output:                            " << GetDoOutput() << endl \
-             << "BBRC sep:                             " << GetBbrcSep() << endl \
-             << "Regression:                           " << GetRegression() << endl \
-             << "---" << endl;
+        else if (chisq->nr_acts.size()==0 && chisq->active) {
+          cerr << "Error! No classes";
+          if (e) cerr << " for endpoint " << e;
+          cerr << "." << endl;
+          exit(1);
         }
+      }
+    }
+    if (fm::bbrc_lattice && !fm::bbrc_lattice->out) { // labels are those of the lattice
+      fm::bbrc_database->group ();
+      fm::bbrc_lattice->check ();
+    }
+    else {
+      { BBRC_PROFILE_TRACE(BBRC_PROFILE_EDGECOUNT); fm::bbrc_database->edgecount (); }
+      { BBRC_PROFILE_TRACE(BBRC_PROFILE_REORDER); fm::bbrc_database->reorder (); }
+    }
+    // tids are grouped by the activity of the first endpoint now
+    for (unsigned int e = 1; e < fm::bbrc_endpoints.size(); e++) {
+      vector<float>& activities = fm::bbrc_regression ? fm::bbrc_endpoints[e].ks->activities : fm::bbrc_endpoints[e].chisq->activities;
+      activities.clear();
+      each(fm::bbrc_database->trees) activities.push_back(fm::bbrc_database->trees[i]->endpoints[e-1]);
+    }
+    BbrcinitBbrcLegStatics (); 
+    fm::bbrc_graphstate->init (); 
+    if (fm::bbrc_lattice && fm::bbrc_lattice->out) fm::bbrc_lattice->header ();
+    if (fm::bbrc_bbrc_sep && !fm::bbrc_do_backbone && fm::bbrc_do_output && !fm::bbrc_console_out) (*fm::bbrc_result) << fm::bbrc_graphstate->sep();
+    init_mining_done=true; 
 
+    if (!fm::bbrc_regression) {
+         cerr << "Settings:" << endl \
+         << "---" << endl \
+         << "Type:                                 " << GetType() << endl \
+         << "Minimum frequency:                    " << GetMinfreq() << endl \
+         << "Aromatic:                             " << GetAromatic() << endl \
+         << "Chi-square active (chi-square-value): " << GetChisqActive() << " (" << GetChisqSig()<< ")" << endl \
+         << "BBRC mining:                          " << GetBackbone() << endl \
+         << "Statistical metric (dynamic) pruning: " << GetPruning() << " (" << GetDynamicUpperBound() << ")" << endl \
+         << "Refine patterns with single support:  " << GetRefineSingles() << endl \
+         << "Do output:                            " << GetDoOutput() << endl \
+         << "BBRC sep:                             " << GetBbrcSep() << endl \
+         << "Regression:                           " << GetRegression() << endl;
+         if (fm::bbrc_endpoints.size() > 1) cerr << "Endpoints:                            " << fm::bbrc_endpoints.size() << endl;
+         cerr << "---" << endl;
+    }
+    else {
+         cerr << "Settings:" << endl \
+         << "---" << endl \
+         << "Type:                                 " << GetType() << endl \
+         << "Minimum frequency:                    " << GetMinfreq() << endl \
+         << "Aromatic:                             " << GetAromatic() << endl \
+         << "KS active (p-value):                  " << GetChisqActive() << " (" << GetChisqSig()<< ")" << endl \
+         << "BBRC mining:                          " << GetBackbone() << endl \
+         << "Statistical metric (dynamic) pruning: " << GetPruning() << " (" << GetDynamicUpperBound() << ")" << endl \
+         << "Refine patterns with single support:  " << GetRefineSingles() << endl \
+         << "Do output:                            " << GetDoOutput() << endl \
+         << "BBRC sep:                             " << GetBbrcSep() << endl \
+         << "Regression:                           " << GetRegression() << endl;
+         if (fm::bbrc_endpoints.size() > 1) cerr << "Endpoints:                            " << fm::bbrc_endpoints.size() << endl;
+         cerr << "---" << endl;
     }
+    if (fm::bbrc_checkpoint) fm::bbrc_checkpoint->start();
+}
 
+vector<string>* Bbrc::MineRoot(unsigned int j) {
+    for (unsigned int e = 0; e < fm::bbrc_endpoints.size(); e++) fm::bbrc_endpoints[e].result->clear();
+    InitMining();
 
     if (j >= fm::bbrc_database->nodelabels.size()) { cerr << "Error! Root node " << j << " does not exist." << endl;  exit(1); }
-    if ( fm::bbrc_database->nodelabels[j].frequency >= fm::bbrc_minfreq && fm::bbrc_database->nodelabels[j].frequentedgelabels.size () ) {
+    if (fm::bbrc_checkpoint && fm::bbrc_checkpoint->done(j)) return fm::bbrc_result; // mined before the checkpoint
+    if (fm::bbrc_lattice && !fm::bbrc_lattice->out) {
+        BBRC_PROFILE_TRACE(BBRC_PROFILE_MINE_ROOT);
+        fm::bbrc_lattice->replay(j); // instead of mining
+    }
+    else if ( fm::bbrc_database->nodelabels[j].frequency >= fm::bbrc_minfreq && fm::bbrc_database->nodelabels[j].frequentedgelabels.size () ) {
+        BBRC_PROFILE_TRACE(BBRC_PROFILE_MINE_ROOT);
+        fm::bbrc_statistics->nr_roots = fm::bbrc_database->nodelabels.size();
+        fm::bbrc_statistics->startRoot ( j, fm::bbrc_database->nodelabels[j].inputlabel );
+        if (fm::bbrc_lattice) {
+          fm::bbrc_lattice->add ( BBRC_LATTICE_ROOT, j, 0, fm::bbrc_database->nodelabels[j].occurrences );
+          fm::bbrc_lattice->enter ( 0 );
+        }
         BbrcPath path(j);
+        if (fm::bbrc_checkpoint) fm::bbrc_checkpoint->startRoot(j);
         path.expand(); // mining step
+        if (fm::bbrc_lattice) fm::bbrc_lattice->leave ();
     }
+    if (fm::bbrc_checkpoint) fm::bbrc_checkpoint->endRoot(j);
     if (getenv("FMINER_SILENT")) {
       fclose (stderr);
     }
     return fm::bbrc_result;
 }
 
+vector<string>* Bbrc::MineUnit(unsigned int j, unsigned int leg) {
+    fm::bbrc_unit = leg;
+    fm::bbrc_gsp_printed = 0; fm::bbrc_gsp_written = 0;
+    MineRoot(j);
+    fm::bbrc_unit = NOLEG;
+    return fm::bbrc_result;
+}
+
+// Graphs printed are numbered by print (), representatives and results written to strings by to_s ()
+unsigned int Bbrc::GetUnitGraphs() {
+    return (fm::bbrc_console_out && !fm::bbrc_do_backbone) ? fm::bbrc_gsp_printed : fm::bbrc_gsp_written;
+}
+
+vector<unsigned long>* Bbrc::GetUnits(unsigned int j) {
+    InitMining();
+    units.clear();
+    if (j >= fm::bbrc_database->nodelabels.size()) { cerr << "Error! Root node " << j << " does not exist." << endl;  exit(1); }
+    if (fm::bbrc_lattice && !fm::bbrc_lattice->out) fm::bbrc_lattice->units(j, units);
+    else if ( fm::bbrc_database->nodelabels[j].frequency >= fm::bbrc_minfreq && fm::bbrc_database->nodelabels[j].frequentedgelabels.size () ) {
+        BbrcPath path(j);
+        path.units(units);
+    }
+    return &units;
+}
+
+string Bbrc::GetStatistics() {
+    return fm::bbrc_statistics->to_json();
+}
+
 void Bbrc::ReadGsp(FILE* gsp){
     fm::bbrc_database->readGsp(gsp);
 }
 
+bool Bbrc::WriteLattice(FILE* lattice) {
+    delete fm::bbrc_lattice;
+    fm::bbrc_lattice = new BbrcLattice(lattice, true);
+    return true;
+}
+
+void Bbrc::ReadLattice(FILE* lattice) {
+    if (fm::bbrc_db_built || inchi_compound_mmap.size() || fm::bbrc_database->trees.size()) {
+      cerr << "Error! A lattice is read instead of compounds." << endl;
+      exit(1);
+    }
+    delete fm::bbrc_lattice;
+    fm::bbrc_lattice = new BbrcLattice(lattice, false);
+    fm::bbrc_lattice->read();
+}
+
 bool Bbrc::AddCompound(string smiles, unsigned int comp_id) {
+  BBRC_PROFILE(BBRC_PROFILE_INGEST);
   if (fm::bbrc_db_built) {
     cerr << "BbrcDatabase has been already processed! Please reset() and insert a new dataset." << endl;
     return false;
   }
+  structures.clear(); // prepared without this one
   stringstream ss(smiles);
   OBConversion conv(&ss, &cout);
   if(!conv.SetInAndOutFormats("SMI","INCHI")) {
@@ -469,7 +642,8 @@ bool Bbrc::AddCompound(string smiles, unsigned int comp_id) {
     return false;
   }
   conv.SetOptions("w",OBConversion::OUTOPTIONS);
-  string inchi = conv.WriteString(&mol);
+  string inchi;
+  { BBRC_PROFILE(BBRC_PROFILE_INCHI); inchi = conv.WriteString(&mol); }
   // remove newline
   string::size_type pos = inchi.find_last_not_of("\n");
   if (pos != string::npos) {
@@ -495,6 +669,25 @@ bool Bbrc::AddCompound(string smiles, unsigned int comp_id) {
   return true;
 }
 
+// Structures are read in the order of AddDataCanonical(), which numbers the compounds
+bool Bbrc::PrepareCompounds() {
+  if (fm::bbrc_db_built || fm::bbrc_database->trees.size() || (fm::bbrc_lattice && !fm::bbrc_lattice->out)) {
+    cerr << "Error! Compounds are prepared from SMILES before mining." << endl;
+    return false;
+  }
+  structures.assign(inchi_compound_mmap.size(), vector<int>());
+  unsigned int k = 0;
+  for (map<string, pair<unsigned int, string> >::iterator it = inchi_compound_mmap.begin(); it != inchi_compound_mmap.end(); it++, k++) {
+    if (it->second.first > 0 && !BbrcDatabase::readSmi(it->second.second, structures[k])) structures[k].clear();
+  }
+  return true;
+}
+
+bool Bbrc::PrepareMining() {
+  InitMining();
+  return true;
+}
+
 bool Bbrc::AddActivity(float act, unsigned int comp_id) {
   if (fm::bbrc_db_built) {
     cerr << "BbrcDatabase has been already processed! Please reset() and insert a new dataset." << endl;
@@ -504,6 +697,27 @@ bool Bbrc::AddActivity(float act, unsigned int comp_id) {
   return true;
 }
 
+bool Bbrc::AddActivity(float act, unsigned int comp_id, unsigned int endpoint) {
+  if (!endpoint) return AddActivity(act, comp_id);
+  if (fm::bbrc_db_built) {
+    cerr << "BbrcDatabase has been already processed! Please reset() and insert a new dataset." << endl;
+    return false;
+  }
+  if (endpoint_maps.size() < endpoint) endpoint_maps.resize(endpoint);
+  endpoint_maps[endpoint-1].insert(make_pair(comp_id, act));
+  return true;
+}
+
+int Bbrc::GetNoEndpoints() {
+  return fm::bbrc_db_built ? fm::bbrc_endpoints.size() : endpoint_maps.size() + 1;
+}
+
+vector<string>* Bbrc::GetResult(unsigned int endpoint) {
+  if (!fm::bbrc_db_built) AddDataCanonical();
+  if (endpoint >= fm::bbrc_endpoints.size()) { cerr << "Error! Endpoint " << endpoint << " does not exist." << endl;  exit(1); }
+  return fm::bbrc_endpoints[endpoint].result;
+}
+
 
 
 // the class factories
@@ -523,51 +737,91 @@ extern "C" void destroy(Fminer* f) {
 extern "C" void usage() {
     cerr << endl;
     cerr << "Options for Usage 1 (BBRC mining using dynamic upper bound pruning): " << endl;
-    cerr << "       [-f minfreq] [-l type] [-s] [-a] [-o] [-g] [-d [-b [-u]]] [-p p_value]" << endl;
+    cerr << "       [-f minfreq] [-l type] [-s] [-a] [-o] [-g] [-j file] [-M mb] [-F file] [-C file [-R]] [-W n [-S dir] | -w dir] [-d [-b [-u]]] [-p p_value]" << endl;
     cerr << endl;
     cerr << "Options for Usage 2 (Frequent subgraph mining): " << endl;
-    cerr << "       [-f minfreq] [-l type] [-s] [-a] [-o]" << endl;
+    cerr << "       [-f minfreq] [-l type] [-s] [-a] [-o] [-j file] [-M mb] [-L file] [-C file [-R]] [-W n [-S dir] | -w dir]" << endl;
     cerr << endl;
 }
 
 bool Bbrc::AddDataCanonical() {
+    BBRC_PROFILE_TRACE(BBRC_PROFILE_ADD_DATA);
     // AM: now insert all structures into the database
     // in canonical ordering according to inchis
     comp_runner=0;
     if (fm::bbrc_regression) {
-      vector<float> activity_values;
-      for (map<string, pair<unsigned int, string> >::iterator it = inchi_compound_mmap.begin(); it != inchi_compound_mmap.end(); it++) {
-        if (activity_map.find(it->second.first) != activity_map.end()) { // need this for reading value in the next line!
-          activity_values.push_back(activity_map.find(it->second.first)->second); // 0 gets push w/o previous check line!
-        }
-      }
-      // cut quantiles
-      float min_thr, max_thr = 0.0;
-      min_thr = quantile(activity_values,0.0125); // find 1.25% quantile
-      max_thr = quantile(activity_values,0.9875); // find 98.75% quantile
-
-      for (map<string, pair<unsigned int, string> >::iterator it = inchi_compound_mmap.begin(); it != inchi_compound_mmap.end(); it++) {
-        if (activity_map.find(it->second.first) != activity_map.end()) {
-          activity_map[it->second.first]=activity_map[it->second.first];
-          if (activity_map[it->second.first] < min_thr) activity_map[it->second.first]=min_thr;
-          if (activity_map[it->second.first] > max_thr) activity_map[it->second.first]=max_thr;
-        }
-      }
+      ClipActivities(activity_map);
+      each(endpoint_maps) ClipActivities(endpoint_maps[i]);
     }
 
-    for (map<string, pair<unsigned int, string> >::iterator it = inchi_compound_mmap.begin(); it != inchi_compound_mmap.end(); it++) {
-      AddCompoundCanonical(it->second.second, it->second.first); // smiles, comp_id
-      float activity = activity_map.find(it->second.first)->second;
-      AddActivityCanonical(activity, it->second.first); // act, comp_id
+    // the first endpoint is the one of AddActivity(act, comp_id)
+    fm::bbrc_endpoints.clear();
+    fm::bbrc_endpoints.push_back(BbrcEndpoint(fm::bbrc_chisq, fm::bbrc_ks, fm::bbrc_result));
+    endpoint_results.assign(endpoint_maps.size(), vector<string>());
+    each(endpoint_maps) fm::bbrc_endpoints.push_back(BbrcEndpoint(new ChisqBbrcConstraint(-1.0), new KSBbrcConstraint(0.95), &endpoint_results[i]));
+
+    if (fm::bbrc_lattice && !fm::bbrc_lattice->out) {
+      each(fm::bbrc_lattice->compounds) {
+        if (AddCompoundLattice(fm::bbrc_lattice->compounds[i])) AddActivitiesCanonical(fm::bbrc_lattice->compounds[i]);
+      }
+    }
+    unsigned int k = 0;
+    for (map<string, pair<unsigned int, string> >::iterator it = inchi_compound_mmap.begin(); it != inchi_compound_mmap.end(); it++, k++) {
+      AddCompoundCanonical(it->second.second, it->second.first, structures.size() ? &structures[k] : NULL); // smiles, comp_id
+      AddActivitiesCanonical(it->second.first);
     }
 
     fm::bbrc_db_built=true;
     inchi_compound_map.clear();
     inchi_compound_mmap.clear();
     activity_map.clear();
+    endpoint_maps.clear();
+    structures.clear();
+    return true;
+}
+
+// Adds the activities of all endpoints to the tree of a compound.
+void Bbrc::AddActivitiesCanonical(unsigned int comp_id) {
+    float activity = activity_map.find(comp_id)->second;
+    if (AddActivityCanonical(activity, comp_id)) { // act, comp_id
+      BbrcDatabaseTreePtr tree = fm::bbrc_database->trees_map[comp_id];
+      each(endpoint_maps) {
+        map<unsigned int, float>::iterator act = endpoint_maps[i].find(comp_id);
+        tree->endpoints.push_back(act != endpoint_maps[i].end() ? act->second : NAN);
+        if (isnan(tree->endpoints.back())) continue;
+        if (!fm::bbrc_regression) { fm::bbrc_endpoints[i+1].chisq->nr_acts[tree->endpoints.back()]++; fm::bbrc_endpoints[i+1].chisq->n++; }
+        else fm::bbrc_endpoints[i+1].ks->all.push_back(tree->endpoints.back());
+      }
+    }
 }
 
-bool Bbrc::AddCompoundCanonical(string smiles, unsigned int comp_id) {
+// Limits continuous activities to their 1.25% and 98.75% quantiles.
+void Bbrc::ClipActivities(map<unsigned int, float>& activities) {
+    vector<unsigned int> ids; // of the compounds
+    if (fm::bbrc_lattice && !fm::bbrc_lattice->out) ids = fm::bbrc_lattice->compounds;
+    for (map<string, pair<unsigned int, string> >::iterator it = inchi_compound_mmap.begin(); it != inchi_compound_mmap.end(); it++) ids.push_back(it->second.first);
+
+    vector<float> activity_values;
+    each(ids) {
+      if (activities.find(ids[i]) != activities.end()) { // need this for reading value in the next line!
+        activity_values.push_back(activities.find(ids[i])->second); // 0 gets push w/o previous check line!
+      }
+    }
+    // cut quantiles
+    float min_thr, max_thr = 0.0;
+    min_thr = quantile(activity_values,0.0125); // find 1.25% quantile
+    max_thr = quantile(activity_values,0.9875); // find 98.75% quantile
+
+    each(ids) {
+      if (activities.find(ids[i]) != activities.end()) {
+        activities[ids[i]]=activities[ids[i]];
+        if (activities[ids[i]] < min_thr) activities[ids[i]]=min_thr;
+        if (activities[ids[i]] > max_thr) activities[ids[i]]=max_thr;
+      }
+    }
+}
+
+bool Bbrc::AddCompoundCanonical(string smiles, unsigned int comp_id, const vector<int>* structure) {
   bool insert_done=false;
   if (comp_id<=0) { cerr << "Error! IDs must be of type: Int > 0." << endl;}
   else {
@@ -576,7 +830,7 @@ bool Bbrc::AddCompoundCanonical(string smiles, unsigned int comp_id) {
       return false;
     }
     else {
-      if (fm::bbrc_database->readTreeSmi (smiles, comp_no, comp_id, comp_runner)) {
+      if (structure ? fm::bbrc_database->readStructure (*structure, comp_no, comp_id, comp_runner) : fm::bbrc_database->readTreeSmi (smiles, comp_no, comp_id, comp_runner)) {
         insert_done=true;
         comp_no++;
       }
@@ -587,6 +841,19 @@ bool Bbrc::AddCompoundCanonical(string smiles, unsigned int comp_id) {
   return insert_done;
 }
 
+// Compounds of a lattice have no structure, their patterns are replayed (see ReadLattice()).
+bool Bbrc::AddCompoundLattice(unsigned int comp_id) {
+  if (activity_map.find(comp_id) == activity_map.end() && GetChisqActive()) {
+    cerr << "Error on compound '" << comp_runner << "', id '" << comp_id << "': no activity found." << endl;
+    comp_runner++;
+    return false;
+  }
+  fm::bbrc_database->addTree(comp_no, comp_id, comp_runner);
+  comp_no++;
+  comp_runner++;
+  return true;
+}
+
 bool Bbrc::AddActivityCanonical(float act, unsigned int comp_id) {
   if (fm::bbrc_database->trees_map.find(comp_id) == fm::bbrc_database->trees_map.end()) { 
     cerr << "No structure for ID " << comp_id << " when adding activity. Ignoring entry!" << endl; return false; 
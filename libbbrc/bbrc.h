@@ -96,17 +96,30 @@ class Bbrc : public Fminer {
     bool SetChisqSig(float _chisq_val); //!< Set significance threshold here (between 0 and 1). Same as '-p'.
     bool SetRegression(bool val); //!< Set 'true' here to enable continuous activity values. Same as '-g'.
     bool SetMaxHops(int val); //!< Dummy method for max hops (only used in LAST-PM). Same as '-m'.
+    bool SetMemoryBudget(unsigned long bytes); //!< Compact occurrence lists and compress those of waiting legs when they exceed this many bytes (0: no budget), warn once if that does not suffice. Same as '-M' (in MB).
+    bool SetCheckpoint(string file, bool resume); //!< Write a checkpoint to this file after the units (top-level legs and roots) completed while mining, every FMINER_CHECKPOINT_INTERVAL seconds. Pass 'true' to resume from it: completed units are skipped and the console output, redirected to a file, is truncated to the checkpoint, so it is continued exactly once. Same as '-C' and '--resume'.
     //@}
     /** @name Others
      *  Other functions.
      */
     //@{
     vector<string>* MineRoot(unsigned int j); //!< Mine fragments rooted at the j-th root node (element type).
+    vector<unsigned long>* GetUnits(unsigned int j); //!< Get the units of work of the j-th root node, i.e. its top-level legs, as their number of occurrences (0: nothing to mine). Units are mined independently with MineUnit(), and their fragments in order are those of MineRoot().
+    vector<string>* MineUnit(unsigned int j, unsigned int leg); //!< Mine the fragments of one unit (see GetUnits()) of the j-th root node. Its graphs in gSpan format are numbered from 1.
+    unsigned int GetUnitGraphs(); //!< Get the number of graph ids in gSpan format the last MineUnit() used, also for candidates not output. The ids of a unit in MineRoot() follow those of the units before it.
+    string GetStatistics(); //!< Get search statistics of the roots mined so far (candidates, pruning, representatives by root and depth) as JSON.
     void ReadGsp(FILE* gsp); //!< Read in a gSpan file
+    bool WriteLattice(FILE* lattice); //!< Write the search tree of frequent subgraph mining (no activities) to this file while mining, see ReadLattice(). Same as '-L'.
+    void ReadLattice(FILE* lattice); //!< Read a lattice written by WriteLattice() instead of compounds. MineRoot() then replays it for the activities added, with stricter minimum frequency, significance or BBRC settings, without graph search.
     bool AddCompound(string smiles, unsigned int comp_id); //!< Add a compound to the database.
+    bool PrepareCompounds(); //!< Read the structures of the compounds added so far, before activities and settings. The database of the next run is then built from them, selecting the compounds with activities and labelling them for the aromaticity set, without reading their SMILES again. Prepare once and mine in processes forked after, as the daemon ('-D') does.
+    bool PrepareMining(); //!< Build the database for the activities and settings given, as the first MineRoot() does: select and label the compounds, then count and order the edge labels. Processes forked after that mine without building it again, as the daemon ('-D') does for each of its settings.
     // KS: bool AddActivity(bool act, unsigned int comp_id); //!< Add an activity to the database.
     // KS: recognize regr field
     bool AddActivity(float act, unsigned int comp_id); //!< Add an activity to the database.
+    bool AddActivity(float act, unsigned int comp_id, unsigned int endpoint); //!< Add an activity of a further endpoint (1, 2, ...) to the database. All endpoints are mined in one search.
+    int GetNoEndpoints(); //!< Get number of endpoints (activity columns).
+    vector<string>* GetResult(unsigned int endpoint); //!< Get the fragments of an endpoint found by the last MineRoot() (endpoint 0: the result of MineRoot()).
     int GetNoRootNodes() {if (!fm::bbrc_db_built) AddDataCanonical() ; return fm::bbrc_database->nodelabels.size();} //!< Get number of root nodes (different element types).
     int GetNoCompounds() {if (!fm::bbrc_db_built) AddDataCanonical() ; return fm::bbrc_database->trees.size();} //!< Get number of compounds in the database.
     //@}
@@ -117,17 +130,26 @@ class Bbrc : public Fminer {
     void AddKS(float val){fm::bbrc_ks->all.push_back(val);}
 
     bool init_mining_done;
+    void InitMining();
+    vector<unsigned long> units; // of GetUnits()
     int comp_runner;
     int comp_no;
 
     vector<string> r;
+    vector<vector<string> > endpoint_results; // r of the further endpoints
     // ONLY FOR INTERNAL USE. DO NOT MAKE PUBLIC!
     map<string, pair<unsigned int, string> > inchi_compound_map;    // AM: structure inchi => (id, smi) for canonical input to check for double structures
     map<string, pair<unsigned int, string> > inchi_compound_mmap;   // AM: structure inchi => (id, smi) for canonical input to use for actual storage
     map<unsigned int, float> activity_map;                          // AM: structure inchi => (id, smi) for canonical input
+    vector<map<unsigned int, float> > endpoint_maps;                // activity_map of the further endpoints
     bool AddDataCanonical();                                        //!< Only to be called by MineRoot!
-    bool AddCompoundCanonical(string smiles, unsigned int comp_id); //!< Only to be called by AddDataCanonical!
+    vector<vector<int> > structures;                                // of PrepareCompounds(), in the order of inchi_compound_mmap, empty if unreadable
+    bool AddCompoundCanonical(string smiles, unsigned int comp_id, const vector<int>* structure); //!< Only to be called by AddDataCanonical!
+    bool AddCompoundLattice(unsigned int comp_id);                  //!< Only to be called by AddDataCanonical!
+    void AddActivitiesCanonical(unsigned int comp_id);              //!< Only to be called by AddDataCanonical!
     bool AddActivityCanonical(float act, unsigned int comp_id);     //!< Only to be called by AddDataCanonical!
+    void ClipActivities(map<unsigned int, float>& activities);      //!< Only to be called by AddDataCanonical!
+    void ClearEndpoints();
 
 };
 
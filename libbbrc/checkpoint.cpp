@@ -0,0 +1,181 @@
+// checkpoint.cpp
+
+/*
+    This file is part of LibBbrc (libbbrc).
+
+    LibBbrc is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    LibBbrc is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with LibBbrc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+#include "database.h"
+#include "constraints.h"
+#include "lattice.h"
+
+namespace fm {
+    extern unsigned int bbrc_minfreq;
+    extern int bbrc_type;
+    extern bool bbrc_do_backbone;
+    extern bool bbrc_adjust_ub;
+    extern bool bbrc_do_pruning;
+    extern bool bbrc_aromatic;
+    extern bool bbrc_refine_singles;
+    extern bool bbrc_do_output;
+    extern bool bbrc_regression;
+    extern bool bbrc_do_yaml;
+    extern bool bbrc_pvalues;
+    extern bool bbrc_gsp_out;
+    extern bool bbrc_aromatic_wc;
+    extern bool bbrc_console_out;
+    extern bool bbrc_nr_hits;
+    extern int bbrc_checkpoint_interval;
+    extern unsigned int bbrc_gsp_printed;
+    extern unsigned int bbrc_gsp_written;
+
+    extern BbrcDatabase* bbrc_database;
+    extern BbrcStatistics* bbrc_statistics;
+    extern ChisqBbrcConstraint* bbrc_chisq;
+    extern KSBbrcConstraint* bbrc_ks;
+    extern BbrcLattice* bbrc_lattice;
+    extern vector<BbrcEndpoint> bbrc_endpoints;
+}
+
+// File: magic line, settings line, then the output length, root and top-level legs completed,
+// graphs numbered in gSpan format, and the search statistics (see BbrcStatistics::save).
+#define BBRC_CHECKPOINT_MAGIC "FMINER CHECKPOINT 1"
+
+// Settings and data the checkpoint is valid for.
+string BbrcCheckpoint::settings () {
+  ostringstream os;
+  os << fm::bbrc_minfreq << " " << fm::bbrc_type << " " << fm::bbrc_chisq->active << " " << fm::bbrc_chisq->level << " " << fm::bbrc_ks->sig
+     << " " << fm::bbrc_do_backbone << fm::bbrc_adjust_ub << fm::bbrc_do_pruning << fm::bbrc_aromatic << fm::bbrc_refine_singles << fm::bbrc_regression
+     << " " << fm::bbrc_do_output << fm::bbrc_do_yaml << fm::bbrc_pvalues << fm::bbrc_gsp_out << fm::bbrc_aromatic_wc << fm::bbrc_nr_hits
+     << " " << fm::bbrc_database->trees.size () << " " << fm::bbrc_database->nodelabels.size () << " " << fm::bbrc_endpoints.size ();
+  return os.str ();
+}
+
+void BbrcCheckpoint::start () {
+  if ( fm::bbrc_do_output && !fm::bbrc_console_out ) {
+    cerr << "Error! Checkpoints are written for a single endpoint, with output to the console." << endl;
+    exit(1);
+  }
+  if ( fm::bbrc_lattice && fm::bbrc_lattice->out ) {
+    cerr << "Error! Checkpoints are not written together with a lattice." << endl;
+    exit(1);
+  }
+  struct stat st;
+  if ( fm::bbrc_do_output && ( fstat ( fileno ( stdout ), &st ) || !S_ISREG ( st.st_mode ) ) ) {
+    cerr << "Error! Output must be redirected to a file for checkpoints." << endl;
+    exit(1);
+  }
+  if ( resume ) read ();
+  else write ( true );
+}
+
+bool BbrcCheckpoint::done ( unsigned int root ) {
+  return resume && root < resume_root;
+}
+
+void BbrcCheckpoint::startRoot ( unsigned int root ) {
+  this->root = root;
+  legs = 0;
+  if ( resume && root == resume_root && resume_legs ) fm::bbrc_statistics->roots.back ().levels = partial.levels;
+}
+
+bool BbrcCheckpoint::skip ( unsigned int leg ) {
+  return resume && root == resume_root && leg < resume_legs;
+}
+
+void BbrcCheckpoint::leg ( unsigned int leg ) {
+  legs = leg + 1;
+  write ( false );
+}
+
+void BbrcCheckpoint::endRoot ( unsigned int root ) {
+  this->root = root + 1;
+  legs = 0;
+  write ( this->root == fm::bbrc_database->nodelabels.size () );
+}
+
+// Replaces the checkpoint by a new one if the interval has passed (force: always). The output
+// is on disk before the checkpoint refers to it.
+void BbrcCheckpoint::write ( bool force ) {
+  double t = time ( NULL );
+  if ( !force && t - last < fm::bbrc_checkpoint_interval ) return;
+  last = t;
+  if ( fm::bbrc_do_output ) {
+    cout.flush ();
+    fflush ( stdout );
+    fsync ( fileno ( stdout ) );
+    output = lseek ( fileno ( stdout ), 0, SEEK_CUR );
+  }
+
+  ostringstream os;
+  os << BBRC_CHECKPOINT_MAGIC << endl << settings () << endl << output << " " << root << " " << legs << " " << fm::bbrc_gsp_printed << " " << fm::bbrc_gsp_written << endl;
+  fm::bbrc_statistics->save ( os );
+
+  string tmp = file + ".tmp";
+  FILE* f = fopen ( tmp.c_str (), "w" );
+  if ( !f || fputs ( os.str ().c_str (), f ) == EOF || fflush ( f ) || fsync ( fileno ( f ) ) || fclose ( f ) || rename ( tmp.c_str (), file.c_str () ) ) {
+    cerr << "Error writing checkpoint '" << file << "': " << strerror ( errno ) << "." << endl;
+    exit(1);
+  }
+}
+
+// Restores the statistics and truncates the output to the state of the checkpoint.
+void BbrcCheckpoint::read () {
+  ifstream is ( file.c_str () );
+  if ( !is ) {
+    cerr << "Error opening file '" << file << "': " << strerror ( errno ) << "." << endl;
+    exit(1);
+  }
+  string magic, line;
+  getline ( is, magic );
+  getline ( is, line );
+  is >> output >> resume_root >> resume_legs >> fm::bbrc_gsp_printed >> fm::bbrc_gsp_written;
+  if ( magic != BBRC_CHECKPOINT_MAGIC || is.fail () || !fm::bbrc_statistics->load ( is ) || ( resume_legs && fm::bbrc_statistics->roots.empty () ) ) {
+    cerr << "Error! Checkpoint '" << file << "' is corrupt." << endl;
+    exit(1);
+  }
+  if ( line != settings () ) {
+    cerr << "Error! Checkpoint '" << file << "' was written with other settings or compounds." << endl;
+    exit(1);
+  }
+  if ( resume_legs ) { // restored when the root starts again
+    partial = fm::bbrc_statistics->roots.back ();
+    fm::bbrc_statistics->roots.pop_back ();
+  }
+
+  if ( fm::bbrc_do_output ) {
+    cout.flush ();
+    fflush ( stdout );
+    struct stat st;
+    int fd = fileno ( stdout );
+    if ( fstat ( fd, &st ) || st.st_size < output ) {
+      cerr << "Error! Output is shorter than at checkpoint '" << file << "', append it to the output of the interrupted run." << endl;
+      exit(1);
+    }
+    if ( ftruncate ( fd, output ) || lseek ( fd, output, SEEK_SET ) < 0 ) {
+      cerr << "Error! Cannot truncate the output: " << strerror ( errno ) << "." << endl;
+      exit(1);
+    }
+  }
+  root = resume_root;
+  legs = resume_legs;
+  last = time ( NULL );
+  cerr << "Resuming at root " << resume_root << ", top-level leg " << resume_legs << "." << endl;
+}
@@ -0,0 +1,61 @@
+// checkpoint.h
+
+/*
+    This file is part of LibBbrc (libbbrc).
+
+    LibBbrc is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    LibBbrc is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with LibBbrc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Checkpoints of long mining runs. The units of work are the top-level legs of the roots, which
+// are mined in order, so the units completed are given by a root and the number of its top-level
+// legs done. A checkpoint holds them together with the search statistics and the length of the
+// output, and replaces the previous one atomically. A resumed run truncates the output to that
+// length and skips the units completed, so every fragment is output exactly once. No BBRC state
+// crosses units: each top-level leg starts the max of its branch (see bbrcEvaluateTop).
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+
+#include "misc.h"
+
+using namespace std;
+
+class BbrcCheckpoint {
+  public:
+    BbrcCheckpoint ( string file, bool resume ) : file ( file ), resume ( resume ), root ( 0 ), legs ( 0 ), resume_root ( 0 ), resume_legs ( 0 ), output ( 0 ), last ( 0 ), partial ( -1, -1 ) { }
+
+    string file;
+    bool resume; // from the checkpoint in file
+
+    void start (); // after the mining is initialized: reads the checkpoint to resume, or writes the first one
+    bool done ( unsigned int root ); // the root was completed before
+    void startRoot ( unsigned int root ); // before the top-level legs: statistics of the root up to the checkpoint
+    bool skip ( unsigned int leg ); // the top-level leg of the current root was completed before
+    void leg ( unsigned int leg ); // the top-level leg is completed
+    void endRoot ( unsigned int root ); // the root is completed
+
+  private:
+    unsigned int root, legs; // roots before root and its first legs top-level legs are completed
+    unsigned int resume_root, resume_legs;
+    long output; // bytes output at the checkpoint
+    double last; // time of the checkpoint
+    BbrcRootStatistics partial; // root resumed
+    string settings ();
+    void write ( bool force );
+    void read ();
+};
+
+#endif
@@ -30,6 +30,8 @@ namespace fm {
     extern vector<vector< CloseBbrcLegOccurrences> > bbrc_candidatecloselegsoccs;
     extern vector<bool> bbrc_candidateBbrccloselegsoccsused;
     extern bool bbrc_Bbrccloselegsoccsused;
+    extern BbrcLegPool<BbrcCloseBbrcLeg> bbrc_closelegpool;
+    extern BbrcStatistics* bbrc_statistics;
 }
 
 void BbrcaddCloseExtensions ( vector<BbrcCloseBbrcLegPtr> &targetcloselegs, int number ) {
@@ -39,7 +41,7 @@ void BbrcaddCloseExtensions ( vector<BbrcCloseBbrcLegPtr> &targetcloselegs, int
         vector<CloseBbrcLegOccurrences> &edgelabeloccs = fm::bbrc_candidatecloselegsoccs[i];
         for ( BbrcEdgeLabel j = 0; j < edgelabeloccs.size (); j++ ) {
           if ( edgelabeloccs[j].frequency >= fm::bbrc_minfreq ) {
-            BbrcCloseBbrcLegPtr closelegptr = new BbrcCloseBbrcLeg;
+            BbrcCloseBbrcLegPtr closelegptr = fm::bbrc_closelegpool.get ( *fm::bbrc_statistics );
             closelegptr->tuple.label = j;
             closelegptr->tuple.to = i;
             closelegptr->tuple.from = number;
@@ -55,7 +57,7 @@ void BbrcaddCloseExtensions ( vector<BbrcCloseBbrcLegPtr> &targetcloselegs, vect
   for ( int i = 0; i < (int) sourcecloselegs.size (); i++ ) {
     CloseBbrcLegOccurrencesPtr closelegoccurrencesptr = bbrc_join ( sourceoccs, sourcecloselegs[i]->occurrences );
     if ( closelegoccurrencesptr ) {
-      BbrcCloseBbrcLegPtr closelegptr = new BbrcCloseBbrcLeg;
+      BbrcCloseBbrcLegPtr closelegptr = fm::bbrc_closelegpool.get ( *fm::bbrc_statistics );
       closelegptr->tuple = sourcecloselegs[i]->tuple;
       swap ( closelegptr->occurrences, *closelegoccurrencesptr );
       targetcloselegs.push_back ( closelegptr );
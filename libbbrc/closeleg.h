@@ -52,6 +52,11 @@ struct CloseBbrcLegOccurrences {
   CloseBbrcLegOccurrences () : frequency ( 0 ) { }
 };
 
+inline void swap ( CloseBbrcLegOccurrences &a, CloseBbrcLegOccurrences &b ) {
+  a.elements.swap ( b.elements );
+  std::swap ( a.frequency, b.frequency );
+}
+
 typedef CloseBbrcLegOccurrences *CloseBbrcLegOccurrencesPtr;
 
 struct BbrcCloseBbrcLeg {
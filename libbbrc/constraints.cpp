@@ -21,17 +21,80 @@
 #include "constraints.h"
 
 
-void ChisqBbrcConstraint::generateIntSubsets(set<int>& myset, set<set<int> >&subsets) {
-    set<int>::iterator vi;
-    for(vi = myset.begin(); vi != myset.end(); ++vi) {
-      set<int> subset = myset;
-      subset.erase(*vi);
-      subsets.insert(subset);
-      if(subset.size() > 1) generateIntSubsets(subset, subsets);
+// Orders classes by the chi^2 gain of their hits, (f-1)/n, see UpperBound().
+class BbrcClassGainGreater {
+  public:
+    BbrcClassGainGreater(vector<int>& _f_sizes, vector<float>& _n_sizes) : f_sizes(_f_sizes), n_sizes(_n_sizes) {}
+    bool operator() (unsigned int a, unsigned int b) const {
+      return (f_sizes[a]-1) * n_sizes[b] > (f_sizes[b]-1) * n_sizes[a];
     }
+  private:
+    vector<int>& f_sizes;
+    vector<float>& n_sizes;
+};
+
+// Upper bound for chi^2 of more specific features (see Morishita and Sese, 2000): refinements may
+// lose the hits of whole classes, so the bound is the maximum over the proper subsets of classes.
+// Up to 5 classes the subsets are enumerated. Beyond, classes are allowed to be taken in
+// fractions t (t^2 <= t bounds the squared terms), which gives a bound that is never below
+// the subset maximum: with x hits taken, the best fractions are the classes by descending
+// (f-1)/n, so the bound is maximized along that order, segment by segment.
+float ChisqBbrcConstraint::UpperBound(vector<int>& f_sizes) {
+    unsigned int k = f_sizes.size();
+    float bound = 0.0;
+
+    if (k <= 5) {
+      vector<int> f_selected_sizes(k);
+      for (unsigned int subset = 1; subset + 1 < (1u << k); subset++) {
+        int f_sum = 0;
+        for (unsigned int j = 0; j < k; j++) {
+          f_selected_sizes[j] = (subset >> j & 1) ? f_sizes[j] : 0;
+          f_sum += f_selected_sizes[j];
+        }
+        float current = ChiSq(f_sum, f_selected_sizes);
+        if (current > bound) bound = current;
+      }
+      return bound;
+    }
+
+    // chi^2 with continuity correction for x hits in total, of which y_i in class i:
+    // (n/x) * (sum y_i^2/n_i - sum y_i/n_i + 1/4 sum 1/n_i) - x + k
+    vector<float> n_sizes;
+    double c = 0.0;
+    for (map<float, unsigned int>::iterator it = nr_acts.begin(); it != nr_acts.end(); it++) {
+      n_sizes.push_back(it->second);
+      c += 0.25 / it->second;
+    }
+    vector<unsigned int> order;
+    int f_min = 0;
+    for (unsigned int j = 0; j < k; j++) {
+      if (f_sizes[j] == 0) continue;
+      order.push_back(j);
+      if (!f_min || f_sizes[j] < f_min) f_min = f_sizes[j];
+    }
+    sort(order.begin(), order.end(), BbrcClassGainGreater(f_sizes, n_sizes));
+
+    double x0 = 0.0, g0 = 0.0; // hits and gain sum(y_i^2/n_i - y_i/n_i) of the classes before
+    for (unsigned int j = 0; j < order.size(); j++) {
+      double f = f_sizes[order[j]];
+      double slope = (f - 1.0) / n_sizes[order[j]];
+      double x1 = x0 + f;
+      double a = c + g0 - slope * x0; // along this segment: n*a/x + n*slope - x + k
+      double from = maxi(x0, (double) f_min);
+      double peak = a < 0.0 ? sqrt(-(double) n * a) : from;
+      double xs[3] = { from, x1, peak };
+      for (unsigned int i = 0; i < 3; i++) {
+        if (xs[i] < from || xs[i] > x1) continue;
+        float current = n * a / xs[i] + n * slope - xs[i] + k;
+        if (current > bound) bound = current;
+      }
+      x0 = x1;
+      g0 += f * slope;
+    }
+    return bound;
 }
 
-float ChisqBbrcConstraint::ChiSq(int x_val, vector<int> y) {
+float ChisqBbrcConstraint::ChiSq(int x_val, vector<int>& y) {
         assert(y.size() == nr_acts.size()); // equal class amounts as integrity constraint.
         int integrity = 0;
         each(y) integrity+=y[i]; 
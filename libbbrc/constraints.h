@@ -23,84 +23,92 @@
 #define CONSTRAINTS_H
 
 #include <set>
+#include <math.h>
 #include <gsl/gsl_cdf.h>
 #include <gsl/gsl_randist.h>
 #include <gsl/gsl_statistics.h>
 #include "legoccurrence.h"
 #include "database.h"
+#include "profile.h"
 #include <assert.h>
 
 namespace fm {
     extern BbrcDatabase* bbrc_database;
+    extern unsigned int bbrc_statistic_cache;
 }
 
 class BbrcConstraint {};
 
+//! Statistics of recently evaluated supports. A leg whose key (the support per class for the chi-square
+//! test, the activities of the supporting compounds for the KS test) equals that of a recent leg, such
+//! as its parent or a sibling, reuses their values instead of a new evaluation. The hash only selects
+//! the slot; a hit needs the same key.
+template <class K> class BbrcStatisticCache {
+  public:
+    BbrcStatisticCache ( unsigned int share ) : share ( share ) {}
+    bool find ( const vector<K>& key, BbrcTidHash hash, float& p, float& u, unsigned int& f ) {
+      unsigned int slots = ( fm::bbrc_statistic_cache + share - 1 ) / share;
+      if ( entries.size () != slots ) entries.assign ( slots, Entry () );
+      if ( entries.empty () ) return false;
+      Entry& e = entries[hash % entries.size ()];
+      if ( !e.used || e.key != key ) return false;
+      p = e.p; u = e.u; f = e.f;
+      return true;
+    }
+    void insert ( const vector<K>& key, BbrcTidHash hash, float p, float u, unsigned int f ) {
+      if ( entries.empty () ) return;
+      Entry& e = entries[hash % entries.size ()];
+      e.used = true; e.key = key; e.p = p; e.u = u; e.f = f;
+    }
+  private:
+    struct Entry {
+      Entry () : used ( false ) {}
+      bool used;
+      vector<K> key;
+      float p, u;
+      unsigned int f;
+    };
+    unsigned int share; // of fm::bbrc_statistic_cache slots, for larger keys
+    vector<Entry> entries;
+};
+
 class ChisqBbrcConstraint : public BbrcConstraint {
 
   public:
     map<float, unsigned int> nr_acts;
     unsigned int n;
     float sig, chisq, p, u;
+    unsigned int f; // compounds of the endpoint supporting the leg of the last Calc()
+    float level; // of sig, which is converted with the degrees of freedom of the classes in MineRoot()
     bool active;
-    map<float, set<BbrcTid> > f_sets;     // gather unique Tids per class
+    vector<float> activities; // for each tid, of a further endpoint (empty: the first endpoint, fm::bbrc_database->activities)
+    map<float, set<BbrcTid> > f_sets;     // gather unique Tids per class, filled by Occurrences()
     map<float, map<BbrcTid,int> > f_maps; // count hits in <*,int>
-    map<int, float> df_thresholds;
 
     // Constructor
-    ChisqBbrcConstraint (float sig) : n(0), sig(sig), chisq(0.0), p(0.0), u(0.0) {
-      df_thresholds[1]=3.84;
-      df_thresholds[2]=5.99;
-      df_thresholds[3]=7.82;
-      df_thresholds[4]=9.49;
-    }
+    ChisqBbrcConstraint (float sig) : n(0), sig(sig), chisq(0.0), p(0.0), u(0.0), f(0), level(0.95), occurrences(NULL), cache(1) {}
 
     // Calculate chisq and upper bound
-    template <typename OccurrenceType>
-    void Calc(vector<OccurrenceType>& legocc) {
+    void Calc(BbrcLegOccurrences& legoccurrences) {
+        BBRC_PROFILE(BBRC_PROFILE_STATISTIC);
         u = p = chisq = 0.0;
+        occurrences = &legoccurrences.elements;
         int f_sum = 0; // f_sum
         vector<int> f_sizes;
 
-        BbrcLegActivityOccurrence(legocc);
-        map<float, set<BbrcTid> >::iterator  f_sets_it;
-        for (f_sets_it=f_sets.begin(); f_sets_it!=f_sets.end(); f_sets_it++) f_sizes.push_back(f_sets_it->second.size()); // f_sizes
+        BbrcLegActivityOccurrence(legoccurrences.elements, f_sizes);
+        BbrcTidHash hash = BBRC_TIDHASH_SEED;
+        each(f_sizes) hash = bbrc_tidhash(hash, f_sizes[i]);
+        if (cache.find(f_sizes, hash, p, u, f)) return;
         each(f_sizes) f_sum+=f_sizes[i]; // f_sum
         p = ChiSq(f_sum, f_sizes); // chisq
-
-        set<int> f_indices;
-        for (int i=0; i<f_sizes.size(); i++) f_indices.insert(i);
-        set<set<int> > f_subsets;
-        set<set<int> >::iterator f_subsets_it;
-        generateIntSubsets(f_indices, f_subsets);
-        for (f_subsets_it = f_subsets.begin(); f_subsets_it!=f_subsets.end(); f_subsets_it++) {
-          if (f_subsets_it->size() > 0) {
-            f_sum=0; // f_sum
-            vector<int> f_selected_sizes;
-            for (int j=0; j<f_sizes.size(); j++) { 
-              if (f_subsets_it->find(j)!=f_subsets_it->end()) {
-                f_selected_sizes.push_back(f_sizes[j]);
-                f_sum+=f_sizes[j]; // f_sum
-              }
-              else f_selected_sizes.push_back(0);
-            }
-            float current = ChiSq(f_sum,f_selected_sizes);
-            if (current > u) u=current; // u
-          }
-       }
+        u = UpperBound(f_sizes); // u
+        f = f_sum;
+        cache.insert(f_sizes, hash, p, u, f);
     }
 
-
-    private:
-
-    //!< Calculates chi^2 and upper bound values
-    float ChiSq(int x_val, vector<int> y);
-    void generateIntSubsets(set<int>& myset, set<set<int> >&subsets);
- 
-
-    //!< Counts occurrences of legs in active and inactive compounds
-    template <typename OccurrenceType>
-    void BbrcLegActivityOccurrence(vector<OccurrenceType>& legocc) {
+    //!< Gathers the compounds (input ids) per class and the hits per compound of the leg of the last Calc(), for output
+    void Occurrences() {
 
       f_sets.clear();
       f_maps.clear();
@@ -113,9 +121,11 @@ class ChisqBbrcConstraint : public BbrcConstraint {
         f_sets[nr_acts_it->first]=tmp;
       }
 
+      vector<BbrcLegOccurrence>& legocc = *occurrences;
       each (legocc) { 
-        float activity = fm::bbrc_database->trees[legocc[i].tid]->activity;
-        BbrcTid orig_tid = fm::bbrc_database->trees[legocc[i].tid]->orig_tid;
+        float activity = activities.empty() ? fm::bbrc_database->activities[legocc[i].tid] : activities[legocc[i].tid];
+        if (isnan(activity)) continue; // not measured for this endpoint
+        BbrcTid orig_tid = fm::bbrc_database->orig_tids[legocc[i].tid];
 
         f_maps[activity].insert(make_pair(orig_tid,1)); // each occurrence with 1, failure if present
         insert_ret = f_sets[activity].insert(orig_tid); 
@@ -124,6 +134,60 @@ class ChisqBbrcConstraint : public BbrcConstraint {
       }
 
     }
+
+    private:
+
+    vector<BbrcLegOccurrence>* occurrences; // of the last Calc()
+    vector<unsigned int> class_index; // position of each class of the database in nr_acts
+    vector<unsigned int> tid_class; // position of the class of each tid in nr_acts, for a further endpoint
+    BbrcStatisticCache<int> cache;
+
+    //!< Calculates chi^2 and upper bound values
+    float ChiSq(int x_val, vector<int>& y);
+    float UpperBound(vector<int>& f_sizes);
+ 
+
+    //!< Counts occurrences of legs in active and inactive compounds
+    // The database is grouped by activity (BbrcDatabase::group) and the tids in legocc ascend,
+    // so a compound is counted when its tid changes, in the class whose range holds the tid.
+    // Further endpoints are not grouped, they look up the class of each tid.
+    void BbrcLegActivityOccurrence(vector<BbrcLegOccurrence>& legocc, vector<int>& f_sizes) {
+
+      if (!activities.empty()) {
+        if (tid_class.size() != activities.size()) {
+          tid_class.resize(activities.size());
+          each(activities) tid_class[i] = isnan(activities[i]) ? nr_acts.size() : distance(nr_acts.begin(), nr_acts.find(activities[i]));
+        }
+        f_sizes.assign(nr_acts.size() + 1, 0);
+        BbrcTid lasttid = NOTID;
+        each (legocc) {
+          if (legocc[i].tid == lasttid) continue;
+          lasttid = legocc[i].tid;
+          f_sizes[tid_class[lasttid]]++;
+        }
+        f_sizes.pop_back();
+        return;
+      }
+
+      vector<BbrcTid>& classes = fm::bbrc_database->classes;
+      if (class_index.size() != classes.size() - 1) {
+        class_index.clear();
+        for (unsigned int c = 0; c + 1 < classes.size(); c++)
+          class_index.push_back(distance(nr_acts.begin(), nr_acts.find(fm::bbrc_database->activities[classes[c]])));
+      }
+
+      f_sizes.assign(nr_acts.size(), 0);
+      unsigned int c = 0;
+      BbrcTid lasttid = NOTID;
+      each (legocc) {
+        BbrcTid tid = legocc[i].tid;
+        if (tid == lasttid) continue;
+        lasttid = tid;
+        while (tid >= classes[c + 1]) c++;
+        if (class_index[c] < f_sizes.size()) f_sizes[class_index[c]]++;
+      }
+
+    }
     
 
 
@@ -134,41 +198,60 @@ class KSBbrcConstraint : public BbrcConstraint {
     vector<float> all;
     vector<float> feat;
     float sig, p;
+    unsigned int f; // compounds of the endpoint supporting the leg of the last Calc()
+    vector<float> activities; // for each tid, of a further endpoint (empty: the first endpoint, fm::bbrc_database->activities)
     map<float, set<BbrcTid> > f_sets;
     map<float, map<BbrcTid,int> > f_maps; 
 
-    KSBbrcConstraint (float sig) : sig(sig), p(0.0) {}
+    KSBbrcConstraint (float sig) : sig(sig), p(0.0), f(0), occurrences(NULL), cache(16) {}
 
-    template <typename OccurrenceType>
-    void Calc(vector<OccurrenceType>& legocc) {
-        BbrcLegActivityOccurrence(legocc);
+    void Calc(BbrcLegOccurrences& legoccurrences) {
+        BBRC_PROFILE(BBRC_PROFILE_STATISTIC);
+        occurrences = &legoccurrences.elements;
+        float u;
+        BbrcLegActivityOccurrence(legoccurrences.elements);
+        if (cache.find(feat, legoccurrences.tidhash, p, u, f)) return;
         p = KS(all,feat);
+        f = feat.size();
+        cache.insert(feat, legoccurrences.tidhash, p, 0.0, f);
     }
 
-  private:
-    float KS(vector<float> all_activities, vector<float> feat_activities);
-
-    //!< Stores activities of occurrences of legs
-    template <typename OccurrenceType>
-    void BbrcLegActivityOccurrence(vector<OccurrenceType>& legocc) {
+    //!< Gathers the compounds (input ids) and the hits per compound of the leg of the last Calc(), for output
+    void Occurrences() {
 
-     feat.clear();
-     f_sets.clear();
-     f_maps.clear();
+      f_sets.clear();
+      f_maps.clear();
 
       std::pair< set<BbrcTid>::iterator, bool > insert_ret;
+      vector<BbrcLegOccurrence>& legocc = *occurrences;
       each (legocc) {
-        float activity = fm::bbrc_database->trees[legocc[i].tid]->activity;
-        BbrcTid orig_tid = fm::bbrc_database->trees[legocc[i].tid]->orig_tid;
+        if (!activities.empty() && isnan(activities[legocc[i].tid])) continue; // not measured for this endpoint
+        BbrcTid orig_tid = fm::bbrc_database->orig_tids[legocc[i].tid];
 
         f_maps[0.0].insert(make_pair(orig_tid,1)); // each occurrence with 1, failure if present (use 0.0 as dummy key for regression)
         insert_ret = f_sets[0.0].insert(orig_tid); 
         if (!insert_ret.second) { 
           f_maps[0.0][orig_tid]++; // increase if present
         }
-        else {
-          feat.push_back(activity); // only if not present
-        }
+      }
+    }
+
+  private:
+    vector<BbrcLegOccurrence>* occurrences; // of the last Calc()
+    BbrcStatisticCache<float> cache; // a 16th of the slots, the keys have an entry per compound
+
+    float KS(vector<float> all_activities, vector<float> feat_activities);
+
+    //!< Stores activities of occurrences of legs, once per compound (the tids in legocc ascend)
+    void BbrcLegActivityOccurrence(vector<BbrcLegOccurrence>& legocc) {
+
+      feat.clear();
+      BbrcTid lasttid = NOTID;
+      each (legocc) {
+        if (legocc[i].tid == lasttid) continue;
+        lasttid = legocc[i].tid;
+        if (activities.empty()) feat.push_back(fm::bbrc_database->activities[lasttid]);
+        else if (!isnan(activities[lasttid])) feat.push_back(activities[lasttid]);
       }
     }
 
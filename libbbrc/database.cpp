@@ -23,10 +23,14 @@
 #include "constraints.h"
 #include <algorithm>
 #include <iostream>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 namespace fm {
     extern bool bbrc_aromatic;
     extern unsigned int bbrc_minfreq;
+    extern int bbrc_threads;
 }
 
 ostream &operator<< ( ostream &stream, BbrcDatabaseTreeEdge &databasetreeedge ) {
@@ -55,6 +59,12 @@ ostream &operator<< ( ostream &stream, BbrcDatabaseTree &databasetree ) {
 
 
 bool BbrcDatabase::readTreeSmi (string smi, BbrcTid tid, BbrcTid orig_tid, int line_nr) {
+    static vector<int> structure;
+    return readSmi (smi, structure) && readStructure (structure, tid, orig_tid, line_nr);
+}
+
+// Labels of both aromaticities, so that a structure read once serves any setting.
+bool BbrcDatabase::readSmi (string smi, vector<int> &structure) {
 
     OBMol mol;
 
@@ -74,213 +84,308 @@ bool BbrcDatabase::readTreeSmi (string smi, BbrcTid tid, BbrcTid orig_tid, int l
         return(0);
     }
 
-    // create and store new tree object
-    BbrcDatabaseTreePtr tree = new BbrcDatabaseTree ( tid , orig_tid , line_nr );
-
-
-    // SEGFAULT
-    trees.push_back(tree);
-    trees_map[orig_tid] = tree;
-
-    int nodessize = 0, edgessize = 0;
-    static vector<BbrcDatabaseTreeNode> nodes;
-    static vector<vector<BbrcDatabaseTreeEdge> > edges;
-    nodes.resize ( 0 );
-
-//    cerr << "Atoms are (Type(ID)):" << endl;
-    OBAtomIterator atom;
-    mol.BeginAtom(atom);
+    structure.assign ( 2, 0 ); // numbers of nodes and edges
 
 	///////////
 	// NODES //
 	///////////
 
-//    cerr << endl;
-    do {
+    // atom type as label, aromatic atoms +150
+    OBAtomIterator atom;
+    for ( OBAtom *a = mol.BeginAtom(atom); a; a = mol.NextAtom(atom), structure[0]++ )
+        structure.push_back ( a->IsAromatic() ? a->GetAtomicNum()+150 : a->GetAtomicNum() );
 
-        //cerr << " " << (*atom)->GetType() << " (idx " << (*atom)->GetIdx() << ")" << endl;
+    ///////////
+    // EDGES //
+    ///////////
 
-        InputBbrcNodeLabel inputnodelabel=0;
+    OBBondIterator bond;
+    for ( OBBond *b = mol.BeginBond(bond); b; b = mol.NextBond(bond), structure[1]++ ) {
+        structure.push_back ( b->GetBeginAtomIdx()-1 );     // USE OB INDICES (same as nodelabel+1)!
+        structure.push_back ( b->GetEndAtomIdx()-1 );
+        structure.push_back ( b->IsAromatic() ? b->GetBondOrder() | AROMATICBOND : b->GetBondOrder() );
+    }
+    return(1);
+}
 
-        // set atom type as label
-        // code for 'c' is set to -1 (aromatic carbon).
-        if (fm::bbrc_aromatic) {
-            (*atom)->IsAromatic() ? inputnodelabel = (*atom)->GetAtomicNum()+150 : inputnodelabel = (*atom)->GetAtomicNum();
-        }
-        else inputnodelabel = (*atom)->GetAtomicNum();
-        nodessize++;
-
-        // Insert into map, using subsequent numbering for internal labels:
-    	// node nr. 1, node nr. 2, ...
-	    // Store direction inputlabel -> internal label
-    	//cerr << "BbrcNodeLabelMap: insert " << inputnodelabel << " --> " << nodelabels.size() << endl;
-        map_insert_pair ( nodelabelmap ) p = nodelabelmap.insert ( make_pair ( inputnodelabel, (nodelabels.size()) ) );
-
-        // Store direction internal label -> node
-        // if node has NOT been present, label it and set frequency to 1
-        if ( p.second ) {
-          vector_push_back ( BbrcDatabaseBbrcNodeLabel, nodelabels, nodelabel );
-          nodelabel.inputlabel = inputnodelabel;
-          nodelabel.occurrences.parent = NULL;
-          nodelabel.occurrences.number = 1;
-          nodelabel.lasttid = tid;
-          //cerr << "Created node label " << nodelabel.inputlabel << " (freq " << nodelabel.frequency <<  ")" << endl;
-        }
-        // if node has been present, increase frequency
-        else {
-          BbrcDatabaseBbrcNodeLabel &nodelabel = nodelabels[p.first->second];
-          if ( nodelabel.lasttid != tid ) nodelabel.frequency++;
-          nodelabel.lasttid = tid;
-          //cerr << "Updated node label " << nodelabel.inputlabel << " (freq " << nodelabel.frequency << ")" << endl;
-        }
+// One graph of a mapped gSpan file, from its 't' line up to the next. Its labels are kept in
+// the buffer of the thread that parsed it: node labels, then node, node, edge label per edge.
+struct BbrcGspGraph {
+  const char *begin, *end;
+  BbrcTid orig_tid;
+  vector<int> *data;
+  unsigned int first, nodessize, edgessize;
+  BbrcDatabaseTreePtr tree;
+  const char* error;
+};
 
-        // Tree node
-        vector_push_back ( BbrcDatabaseTreeNode, nodes, node );
-        node.nodelabel = p.first->second;                           // refer to nodelabel
-    //    node.atom = (*atom);                                        // attach OB atom
-        node.incycle = false;
-        //cerr << "Created tree node for OB index " << node.atom->GetIdx() << " (nodelabel " << (int) node.nodelabel << ", nodes[] size " << nodessize << ")" << endl;
+// A contiguous range of graphs with the buffers of one thread.
+struct BbrcGspTask {
+  BbrcDatabase *database;
+  vector<BbrcGspGraph> *graphs;
+  unsigned int from, to;
+  bool build;
+  vector<int> data, pos, nodestack;
+  vector<bool> visited1, visited2;
+};
 
-    } while (mol.NextAtom(atom));
+// readint and readcommand on a buffer: skip to the next number (command), consume one character after it
+static int readint ( const char *&p, const char *end ) {
+  while ( p < end && ( *p < '0' || *p > '9' ) ) p++;
+  if ( p == end ) return -1;
+  int n = 0;
+  while ( p < end && *p >= '0' && *p <= '9' ) n = n * 10 + *p++ - '0';
+  if ( p < end ) p++;
+  return n;
+}
 
+static char readcommand ( const char *&p, const char *end ) {
+  while ( p < end && ( *p < 'a' || *p > 'z' ) ) p++;
+  if ( p == end ) return -1;
+  return *p++;
+}
 
-    // copy nodes to tree and prepare edges storage size
-    // edges[nodeid] gives the edges going out of node with id 'nodeid'
-    tree->nodes.reserve ( nodessize );
-    if ( edges.size () < (unsigned int) nodessize )
-        edges.resize ( nodessize );					// edges stored per node
-    for ( int i = 0; i < nodessize; i++ ) {
-        edges[i].resize ( 0 );						// no edges yet
-        tree->nodes.push_back ( nodes[i] );
+// Text to input labels, needs nothing shared.
+static void parseGsp ( BbrcGspTask &task, BbrcGspGraph &graph ) {
+  const char *p = graph.begin, *end = graph.end;
+  const char *eol = p;
+  while ( eol < end && eol - p < 99 && *eol != '\n' ) eol++; // as much as readGspStream sees of the header
+  const char *digit = p;
+  while ( digit < eol && ( *digit < '1' || *digit > '9' ) ) digit++;
+  graph.orig_tid = digit < eol ? readint ( digit, eol ) : 0;
+  p = eol;
+
+  vector<int> &data = task.data;
+  graph.data = &data;
+  graph.first = data.size ();
+  graph.nodessize = graph.edgessize = 0;
+  char command = readcommand ( p, end );
+  while ( command == 'v' ) {
+    int dummy = readint ( p, end );
+    data.push_back ( readint ( p, end ) );
+    if ( dummy != (int) graph.nodessize++ ) {
+      graph.error = "Error reading input file - node number does not correspond to its position.";
+      return;
+    }
+    command = readcommand ( p, end );
+  }
+  while ( command == 'e' ) {
+    int nodeid1 = readint ( p, end ), nodeid2 = readint ( p, end );
+    if ( nodeid1 < 0 || nodeid1 >= (int) graph.nodessize || nodeid2 < 0 || nodeid2 >= (int) graph.nodessize ) {
+      graph.error = "Error reading input file - edge between unknown nodes.";
+      return;
     }
-    //cerr << endl;
+    data.push_back ( nodeid1 );
+    data.push_back ( nodeid2 );
+    data.push_back ( readint ( p, end ) );
+    graph.edgessize++;
+    command = readcommand ( p, end );
+  }
+}
 
-    InputBbrcEdgeLabel inputedgelabel;
-    InputBbrcNodeId nodeid1, nodeid2;
+// Edge storage and cycles of a tree, once its labels are known.
+static void buildGsp ( BbrcGspTask &task, BbrcGspGraph &graph ) {
+  BbrcDatabaseTreePtr tree = graph.tree;
+  int nodessize = graph.nodessize, edgessize = graph.edgessize;
+  const int *edges = &(*graph.data)[graph.first + nodessize]; // node, node, internal edge label
+
+  vector<int> &pos = task.pos;
+  pos.assign ( nodessize + 1, 0 );
+  for ( int i = 0; i < edgessize; i++ ) {
+    pos[edges[3*i] + 1]++;
+    pos[edges[3*i+1] + 1]++;
+  }
+  for ( int i = 0; i < nodessize; i++ ) {
+    tree->nodes[i].edges._size = pos[i+1];
+    pos[i+1] += pos[i];
+  }
+  tree->edges = new BbrcDatabaseTreeEdge[edgessize * 2];
+  for ( int i = 0; i < nodessize; i++ )
+    tree->nodes[i].edges.array = tree->edges + pos[i];
+  for ( int i = 0; i < edgessize; i++ ) { // per node in the order of the file, as readTreeGsp
+    int nodeid1 = edges[3*i], nodeid2 = edges[3*i+1];
+    BbrcDatabaseTreeEdge &edge = tree->edges[pos[nodeid1]++];
+    edge.edgelabel = edges[3*i+2];
+    edge.tonode = nodeid2;
+    BbrcDatabaseTreeEdge &edge2 = tree->edges[pos[nodeid2]++];
+    edge2.edgelabel = edges[3*i+2];
+    edge2.tonode = nodeid1;
+  }
 
-    //cerr << "Bonds are (idx[label] bo idx[label]):" << endl;
-    OBBondIterator bond;
+  vector<int> &nodestack = task.nodestack;
+  vector<bool> &visited1 = task.visited1, &visited2 = task.visited2;
+  nodestack.resize ( 0 );
+  visited1.assign ( nodessize, false );
+  visited2.assign ( nodessize, false );
+  for ( int i = 0; i < nodessize; i++ ) {
+    if ( !visited1[i] ) {
+      nodestack.push_back ( i );
+      visited1[i] = visited2[i] = true;
+      task.database->determineCycledNodes ( tree, nodestack, visited1, visited2 );
+      visited2[i] = false;
+      nodestack.pop_back ();
+    }
+  }
+}
 
-    ///////////
-    // EDGES //
-    ///////////
-    
-    if (mol.BeginBond(bond)) {
-
-//        cerr << endl;
-        
-        do {
-
-            nodeid1 = (InputBbrcNodeId) ((*bond)->GetBeginAtomIdx())-1;     // USE OB INDICES (same as nodelabel+1)!
-            nodeid2 = (InputBbrcNodeId) ((*bond)->GetEndAtomIdx())-1;       //
-            int bondorder = (*bond)->GetBondOrder();
-
-            // set input edge label
-            inputedgelabel = bondorder;
-            if (fm::bbrc_aromatic && (*bond)->IsAromatic()) inputedgelabel = 4;
-
-//            cerr << nodeid1 << inputedgelabel << "(" << (*bond)->IsAromatic() << ")" << nodeid2 << " ";
-            BbrcNodeLabel node1label = tree->nodes[nodeid1].nodelabel;
-            BbrcNodeLabel node2label = tree->nodes[nodeid2].nodelabel;
-            
-            //cerr << "(" << (*bond)->GetBeginAtomIdx() << "[" << (int) node1label << "] " << (*bond)->GetBondOrder() << " " << (*bond)->GetEndAtomIdx() << "[" << (int) node2label << "]"<< ")" << endl;
-
-            
-            // Direction of edge always from low to high
-            if ( node1label > node2label ) {
-                BbrcNodeLabel temp = node1label;
-                node1label = node2label;
-                node2label = temp;
-            }
+static void *runGspTask ( void *arg ) {
+  BbrcGspTask &task = *(BbrcGspTask *) arg;
+  for ( unsigned int i = task.from; i < task.to; i++ ) {
+    if ( task.build ) buildGsp ( task, (*task.graphs)[i] );
+    else parseGsp ( task, (*task.graphs)[i] );
+  }
+  return NULL;
+}
 
-            // Create combined input label for edge
-            BbrcCombinedInputLabel combinedinputlabel;
-            combinedinputlabel = combineInputLabels ( inputedgelabel, node1label, node2label );
-
-            // Insert into map, analoguous to nodes, using subsequent numbering for internal labels:
-            // edge nr. 1, edge nr. 2, ...
-            
-            // Direction inputlabel -> internal label
-            //cerr << "BbrcEdgeLabelMap: insert " << combinedinputlabel << "-->" << edgelabels.size() << endl;
-            map_insert_pair ( edgelabelmap ) p = edgelabelmap.insert ( make_pair ( combinedinputlabel, edgelabels.size () ) );
-     
-            // Direction internal label -> edge
-            if ( p.second ) {
-              vector_push_back ( BbrcDatabaseBbrcEdgeLabel, edgelabels, edgelabel );
-              edgelabel.fromnodelabel = node1label;	// directed edges
-              edgelabel.tonodelabel = node2label;
-              edgelabel.inputedgelabel = inputedgelabel;
-              edgelabel.lasttid = tid;
-              //cerr << "Created edge " << edgelabel.inputedgelabel << " (" << (int) edgelabel.fromnodelabel << "-->" << (int) edgelabel.tonodelabel << ")" << ":" << edgelabel.frequency << endl;
-            }
-            else {
-              BbrcDatabaseBbrcEdgeLabel &edgelabel = edgelabels[p.first->second];
-              if ( edgelabel.lasttid != tid )
-                edgelabel.frequency++;
-                edgelabel.lasttid = tid;
-                //cerr << "Updated edge " << edgelabel.inputedgelabel << " (" << (int) edgelabel.fromnodelabel << "-->" << (int) edgelabel.tonodelabel << ")" << ":" << edgelabel.frequency << endl;
-            }
-        
-            // Tree edge (2 versions)
-            vector_push_back ( BbrcDatabaseTreeEdge, edges[nodeid1], edge );
-            edge.edgelabel = p.first->second;
-            edge.tonode = nodeid2;
-    //        edge.bond = (*bond);
-                
-            vector_push_back ( BbrcDatabaseTreeEdge, edges[nodeid2], edge2 );
-            edge2.edgelabel = p.first->second;
-            edge2.tonode = nodeid1;
-    //        edge2.bond = (*bond);
-           
-            edgessize++;
-
-        } while (mol.NextBond(bond));
+// Runs parseGsp or buildGsp on all tasks, one thread each (see bbrc_parallel).
+static void runGsp ( vector<BbrcGspTask> &tasks, bool build ) {
+  for ( unsigned int t = 0; t < tasks.size (); t++ )
+    tasks[t].build = build;
+  bbrc_parallel ( tasks, tasks.size (), runGspTask );
+}
+
+// Maps the file and splits it at the 't' lines. The graphs are parsed and built in parallel, only
+// the numbering of the labels (in the order of the file, as readTreeGsp) is serial.
+// Streams that cannot be mapped (pipes) are read with readGspStream.
+void BbrcDatabase::readGsp (FILE* input) {
+  struct stat st;
+  long offset = ftell ( input );
+  if ( offset < 0 || fstat ( fileno ( input ), &st ) || !S_ISREG ( st.st_mode ) || st.st_size <= offset ) {
+    readGspStream ( input );
+    return;
+  }
+  void *map = mmap ( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno ( input ), 0 );
+  if ( map == MAP_FAILED ) {
+    readGspStream ( input );
+    return;
+  }
+  madvise ( map, st.st_size, MADV_SEQUENTIAL );
+  const char *begin = (const char *) map + offset, *end = (const char *) map + st.st_size;
+
+  unsigned int threads = fm::bbrc_threads > 1 ? fm::bbrc_threads : 1;
+  vector<BbrcGspTask> tasks ( threads );
+  vector<BbrcGspGraph> graphs;
+  BbrcTid tid = trees.size ();
+  for ( const char *p = begin; p < end; ) { // in batches, so that the buffers stay small
+    graphs.clear ();
+    while ( p < end && graphs.size () < 1024 * threads ) {
+      const char *next = p;
+      do {
+        next = (const char *) memchr ( next, '\n', end - next );
+        next = next ? next + 1 : end;
+      } while ( next < end && *next != 't' );
+      BbrcGspGraph graph;
+      graph.begin = p; graph.end = next; graph.tree = NULL; graph.error = NULL;
+      graphs.push_back ( graph );
+      p = next;
+    }
+    for ( unsigned int t = 0; t < threads; t++ ) {
+      tasks[t].database = this;
+      tasks[t].graphs = &graphs;
+      tasks[t].from = graphs.size () * t / threads;
+      tasks[t].to = graphs.size () * (t+1) / threads;
+      tasks[t].data.resize ( 0 );
     }
+    runGsp ( tasks, false );
+    for ( unsigned int i = 0; i < graphs.size (); i++, tid++ )
+      internGsp ( graphs[i], tid );
+    runGsp ( tasks, true );
+  }
 
-    // copy edges to tree
-    tree->edges = new BbrcDatabaseTreeEdge[edgessize * 2];	// allocate space
-                                                        // two instances per edge (both directions)
-    int pos = 0;
-    for ( int i = 0; i < nodessize; i++ ) {				// for all nodes...
-        int s = edges[i].size ();
-        tree->nodes[i].edges._size = s;						// edges stored in s steps from ...
-        tree->nodes[i].edges.array = tree->edges + pos;		// ... offset for that node's edges
-        for ( int j = 0; j < s; j++, pos++ ) {
-            //cerr << i << " " << j << " L: " << edges[i][j].tonode << endl;
-            tree->edges[pos] = edges[i][j];					// flattened storage
-        }
+  munmap ( map, st.st_size );
+  fseek ( input, 0, SEEK_END );
+}
+
+// Numbers the labels of a parsed graph and creates its tree. Must see the graphs in the order of the file.
+void BbrcDatabase::internGsp ( BbrcGspGraph &graph, BbrcTid tid ) {
+  if ( graph.error ) {
+    cerr << graph.error << endl;
+    exit ( 1 );
+  }
+  BbrcDatabaseTreePtr tree = graph.tree = new BbrcDatabaseTree ( tid , graph.orig_tid , tid );
+  trees.push_back ( tree );
+  trees_map[graph.orig_tid] = tree;
+
+  int *labels = &(*graph.data)[graph.first];
+  tree->nodes.resize ( graph.nodessize );
+  for ( unsigned int j = 0; j < graph.nodessize; j++ ) {
+    map_insert_pair ( nodelabelmap ) p = nodelabelmap.insert ( make_pair ( labels[j], nodelabels.size () ) );
+    if ( p.second ) {
+      vector_push_back ( BbrcDatabaseBbrcNodeLabel, nodelabels, nodelabel );
+      nodelabel.inputlabel = labels[j];
+      nodelabel.occurrences.parent = NULL;
+      nodelabel.occurrences.number = 1;
+      nodelabel.lasttid = tid;
     }
-  
-    ////////////
-    // CYCLES //
-    ////////////
-
-    static vector<int> nodestack;
-    static vector<bool> visited1, visited2;
-    nodestack.resize ( 0 );
-    visited1.resize ( 0 );
-    visited1.resize ( nodessize, false );
-    visited2.resize ( 0 );
-    visited2.resize ( nodessize, false );
-  
+    else {
+      BbrcDatabaseBbrcNodeLabel &nodelabel = nodelabels[p.first->second];
+      if ( nodelabel.lasttid != tid )
+        nodelabel.frequency++;
+      nodelabel.lasttid = tid;
+    }
+    tree->nodes[j].nodelabel = p.first->second;
+    tree->nodes[j].incycle = false;
+  }
 
+  int *edges = labels + graph.nodessize;
+  for ( unsigned int j = 0; j < graph.edgessize; j++ ) {
+    BbrcNodeLabel node1label = tree->nodes[edges[3*j]].nodelabel;
+    BbrcNodeLabel node2label = tree->nodes[edges[3*j+1]].nodelabel;
+    InputBbrcEdgeLabel inputedgelabel = edges[3*j+2];
+    if ( node1label > node2label ) {
+      BbrcNodeLabel temp = node1label;
+      node1label = node2label;
+      node2label = temp;
+    }
+    BbrcCombinedInputLabel combinedinputlabel = combineInputLabels ( inputedgelabel, node1label, node2label );
 
-    // for every node...
-    for ( int i = 0; i < nodessize; i++ ) {
-        if ( !visited1[i] ) {
-            nodestack.push_back ( i );
-            visited1[i] = visited2[i] = true;		// visited1: has been reached by DFS
-											        // visited2: is on the current path (indicator for cycle)
-	        // ...perform DFS
-            determineCycledNodes ( tree, nodestack, visited1, visited2 );
-            visited2[i] = false;
-            nodestack.pop_back ();
-        }
+    map_insert_pair ( edgelabelmap ) p = edgelabelmap.insert ( make_pair ( combinedinputlabel, edgelabels.size () ) );
+    if ( p.second ) {
+      vector_push_back ( BbrcDatabaseBbrcEdgeLabel, edgelabels, edgelabel );
+      edgelabel.fromnodelabel = node1label;
+      edgelabel.tonodelabel = node2label;
+      edgelabel.inputedgelabel = inputedgelabel;
+      edgelabel.lasttid = tid;
     }
-    return(1);
+    else {
+      BbrcDatabaseBbrcEdgeLabel &edgelabel = edgelabels[p.first->second];
+      if ( edgelabel.lasttid != tid )
+        edgelabel.frequency++;
+      edgelabel.lasttid = tid;
+    }
+    edges[3*j+2] = p.first->second; // internal label from here on
+  }
 }
 
-void BbrcDatabase::readGsp (FILE* input) {
+// Numbers the labels as internGsp and builds the edges and cycles as buildGsp, in the order of the atoms
+// and bonds of the compound. Aromatic atoms and bonds keep their own labels with fm::bbrc_aromatic.
+bool BbrcDatabase::readStructure (const vector<int> &structure, BbrcTid tid, BbrcTid orig_tid, int line_nr) {
+  if ( structure.size () < 2 ) return false;
+  static BbrcGspTask task;
+  BbrcGspGraph graph;
+  graph.orig_tid = orig_tid;
+  graph.data = &task.data;
+  graph.first = 0;
+  graph.nodessize = structure[0];
+  graph.edgessize = structure[1];
+  graph.error = NULL;
+  task.database = this;
+  task.data.assign ( structure.begin () + 2, structure.end () );
+  for ( unsigned int j = 0; j < graph.nodessize; j++ ) {
+    int &label = task.data[j];
+    if ( !fm::bbrc_aromatic && label > 150 ) label -= 150;
+  }
+  for ( unsigned int j = 0; j < graph.edgessize; j++ ) {
+    int &label = task.data[graph.nodessize + 3*j + 2];
+    if ( label & AROMATICBOND ) label = fm::bbrc_aromatic ? 4 : label & ~AROMATICBOND;
+  }
+  internGsp ( graph, tid );
+  graph.tree->line_nr = line_nr;
+  buildGsp ( task, graph );
+  return true;
+}
+
+void BbrcDatabase::readGspStream (FILE* input) {
   BbrcTid tid2 = 0; 
 
   char array[100];
@@ -542,7 +647,29 @@ bool operator< ( const BbrcDatabaseTreeEdge &a, const BbrcDatabaseTreeEdge &b )
   return a.edgelabel < b.edgelabel;
 }
 
+// missing activities (NaN) last
+bool BbrcActivityLess ( const BbrcDatabaseTreePtr a, const BbrcDatabaseTreePtr b ) {
+  return !isnan ( a->activity ) && ( isnan ( b->activity ) || a->activity < b->activity );
+}
+
+void BbrcDatabase::group () {
+  stable_sort ( trees.begin (), trees.end (), BbrcActivityLess ); // stable: within a class, trees keep the input order
+  orig_tids.resize ( trees.size () );
+  activities.resize ( trees.size () );
+  classes.clear ();
+  for ( BbrcTid i = 0; i < trees.size (); i++ ) {
+    trees[i]->tid = i;
+    orig_tids[i] = trees[i]->orig_tid;
+    activities[i] = trees[i]->activity;
+    if ( !i || BbrcActivityLess ( trees[i-1], trees[i] ) )
+      classes.push_back ( i );
+  }
+  classes.push_back ( trees.size () );
+}
+
 void BbrcDatabase::reorder () {
+
+    group ();
     
 
     // PHASE I: LABEL EDGES ACCORDING TO FREQUENCY
@@ -637,6 +764,15 @@ void BbrcDatabase::printTrees () {
     cout << trees[i];
 }
 
+// The patterns of the compound are replayed from a lattice, there are no nodes.
+BbrcDatabaseTreePtr BbrcDatabase::addTree ( BbrcTid tid, BbrcTid orig_tid, int line_nr ) {
+  BbrcDatabaseTreePtr tree = new BbrcDatabaseTree ( tid, orig_tid, line_nr );
+  tree->edges = NULL;
+  trees.push_back ( tree );
+  trees_map[orig_tid] = tree;
+  return tree;
+}
+
 BbrcDatabase::~BbrcDatabase () {
   for (unsigned int i = 0; i < trees.size (); i++ )
     delete trees[i];
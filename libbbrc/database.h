@@ -46,6 +46,7 @@ typedef unsigned int BbrcCombinedInputLabel;
 // maximum 255 node labels for now.
 
 #define NOINPUTEDGELABEL ((InputBbrcEdgeLabel) -1)
+#define AROMATICBOND 0x100 // flag on the bond order of an aromatic bond, see readSmi
 #define NOINPUTNODELABEL ((InputBbrcNodeLabel) -1)
 
 template<class T>
@@ -94,6 +95,7 @@ struct BbrcDatabaseTree {
   // KS: int activity;
   // KS: float
   float activity;
+  vector<float> endpoints; // activities of the further endpoints, NaN if missing
 
   // KS: BbrcDatabaseTree ( BbrcTid tid , BbrcTid orig_tid , int line_nr ): tid ( tid ), orig_tid (orig_tid ), line_nr (line_nr), activity ( -1 ) { }
   // KS: initialize to 0.0
@@ -131,6 +133,9 @@ class BbrcDatabase {
     BbrcDatabase() {}
     vector<BbrcDatabaseTreePtr> trees;
     map<BbrcTid, BbrcDatabaseTreePtr> trees_map;
+    vector<BbrcTid> orig_tids; // for each tid, the id of the compound in the input
+    vector<float> activities; // for each tid, the activity of the compound
+    vector<BbrcTid> classes; // first tid of each activity class in ascending order of activity, then trees.size ()
     vector<BbrcDatabaseBbrcNodeLabel> nodelabels;
     vector<BbrcDatabaseBbrcEdgeLabel> edgelabels;
     map<InputBbrcNodeLabel,BbrcNodeLabel> nodelabelmap;
@@ -147,17 +152,30 @@ class BbrcDatabase {
     void edgecount ();
 
      // after "edgecount",
+     // - groups the trees by activity (see group)
      // - removes infrequent data
      // - cleans up the datastructures used until now for counting frequencies
      // - changes the edge label order to optimise the search, fills the database with order numbers instead of
      //   the numbers assigned in the previous Bbrclevels; fills edgelabelsindexes.
     void reorder ();
 
+     // renumbers the trees in ascending order of activity, so that the support of a pattern per class
+     // can be counted along the (sorted) tids of its occurrences. Fills orig_tids, activities and classes.
+    void group ();
+
     void printTrees ();
     ~BbrcDatabase ();
     bool readTreeSmi (string smi, BbrcTid tid , BbrcTid orig_tid, int line_nr);
+     // structure of a compound without the database: number of nodes and edges, input node labels
+     // (aromatic atoms +150), then node, node, bond order (AROMATICBOND set if aromatic) per edge
+    static bool readSmi (string smi, vector<int> &structure);
+     // a tree from a structure of readSmi, labelled for fm::bbrc_aromatic as readTreeSmi
+    bool readStructure (const vector<int> &structure, BbrcTid tid, BbrcTid orig_tid, int line_nr);
     void readGsp (FILE* input);
+    void readGspStream (FILE* input);
+    void internGsp (struct BbrcGspGraph &graph, BbrcTid tid);
     void readTreeGsp (FILE *input, BbrcTid orig_tid, BbrcTid tid);
+    BbrcDatabaseTreePtr addTree ( BbrcTid tid, BbrcTid orig_tid, int line_nr ); // compound without structure, see BbrcLattice
   
   	// Perform DFS through tree to identify cycles
     void determineCycledNodes ( BbrcDatabaseTreePtr tree, vector<int> &nodestack, vector<bool> &visited1, vector<bool> &visited2 );
@@ -23,6 +23,10 @@
 
 #include "database.h"
 #include "constraints.h"
+#include "path.h"
+#include "patterntree.h"
+#include "lattice.h"
+#include "checkpoint.h"
 
 namespace fm {
     // switched by fminer binary
@@ -37,9 +41,9 @@ namespace fm {
     bool bbrc_do_output; // fminer, set
     bool bbrc_bbrc_sep; // fminer, set
     bool bbrc_regression; // fminer, set
+    unsigned long bbrc_memory_budget; // fminer, set (bytes, 0: none)
 
     // internally controlled by Defaults()
-    bool bbrc_updated; // demand
     bool bbrc_do_yaml; // ENV
     bool bbrc_pvalues; // ENV
     bool bbrc_gsp_out; // ENV
@@ -47,6 +51,12 @@ namespace fm {
     bool bbrc_console_out; // set
     bool bbrc_db_built; // set
     bool bbrc_nr_hits;  // ENV
+    int bbrc_progress;  // ENV, seconds between progress lines (0: off)
+    int bbrc_threads;   // ENV, worker threads (default: online processors)
+    unsigned int bbrc_chunk_size; // ENV, occurrences each thread gets at least, see bbrc_split ()
+    unsigned int bbrc_statistic_cache; // ENV, slots of the chi-square statistic cache (0: none), see BbrcStatisticCache
+    int bbrc_checkpoint_interval; // ENV, seconds between checkpoints (0: after every unit)
+    int bbrc_unit; // set, top-level leg mined by MineRoot() (NOLEG: all), see MineUnit()
 
     // controlled by constructurs & destructor
     bool bbrc_instance_present;
@@ -59,10 +69,32 @@ namespace fm {
     // controlled by Reset()
     vector<string>* bbrc_result=NULL;
 
+    // controlled by WriteLattice(), ReadLattice() and Reset()
+    BbrcLattice* bbrc_lattice=NULL;
+
+    // controlled by SetCheckpoint() and Reset()
+    BbrcCheckpoint* bbrc_checkpoint=NULL;
+
+    // controlled by BbrcGraphState for the whole process, and by a resumed BbrcCheckpoint
+    unsigned int bbrc_gsp_printed=0; // number of the last graph printed in gSpan format, see print()
+    unsigned int bbrc_gsp_written=0; // same for graphs written to strings, see to_s()
+
+    // controlled by MineRoot() and Reset(), the first endpoint is bbrc_chisq, bbrc_ks and bbrc_result
+    vector<BbrcEndpoint> bbrc_endpoints;
+
     // controlled by destructor & Reset()
     BbrcLegOccurrences* bbrc_legoccurrences=NULL; 
     CloseBbrcLegOccurrences* bbrc_closelegoccurrences=NULL; 
     vector<BbrcLegOccurrences> bbrc_Bbrccandidatelegsoccurrences;
+    vector<BbrcEdgeLabel> bbrc_candidatelabels; // labels touched by the last bbrc_extend, sorted
+    vector<BbrcTid> bbrc_candidatelastself;
+    vector<bool> bbrc_candidatetouched;
+    vector<BbrcLegChunk> bbrc_legchunks; // parts of long occurrence lists, see bbrc_join and bbrc_extend
+    vector<BbrcSiblingJoin> bbrc_siblingjoins; // joins of a leg with its siblings, see bbrc_join_siblings
+    BbrcThreadPool bbrc_threadpool; // workers of bbrc_parallel
+    BbrcLegPool<BbrcPathBbrcLeg> bbrc_pathlegpool; // legs of unwound search levels
+    BbrcLegPool<BbrcLeg> bbrc_treelegpool;
+    BbrcLegPool<BbrcCloseBbrcLeg> bbrc_closelegpool;
     vector<vector< CloseBbrcLegOccurrences> > bbrc_candidatecloselegsoccs;
     vector<bool> bbrc_candidateBbrccloselegsoccsused;
     KSBbrcConstraint* bbrc_ks=NULL;
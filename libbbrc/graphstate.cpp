@@ -26,6 +26,7 @@
 #include "graphstate.h"
 #include "database.h"
 #include "misc.h"
+#include "profile.h"
 
 
 namespace fm {
@@ -41,6 +42,8 @@ namespace fm {
     extern bool bbrc_aromatic_wc;
     extern bool bbrc_aromatic;
     extern bool bbrc_nr_hits;
+    extern unsigned int bbrc_gsp_printed;
+    extern unsigned int bbrc_gsp_written;
 }
 
 BbrcGraphState::BbrcGraphState () {
@@ -324,11 +327,10 @@ int BbrcGraphState::enumerateSpanning () {
 // PRINT GSP TO STDOUT
 
 void BbrcGraphState::print ( FILE *f ) {
-  static int counter = 0;
-  counter++;
+  fm::bbrc_gsp_printed++;
   putc ( 't', f );
   putc ( ' ', f );
-  puti ( f, (int) counter );
+  puti ( f, (int) fm::bbrc_gsp_printed );
   putc ( '\n', f );
   for ( int i = 0; i < (int) nodes.size (); i++ ) {
     putc ( 'v', f );
@@ -413,6 +415,7 @@ void BbrcGraphState::DfsOut(int cur_n, int from_n) {
 // ENTRY: BRANCH TO GSP (STDOUT) or PRINT YAML/LAZAR TO STDOUT
 
 void BbrcGraphState::print ( unsigned int frequency ) {
+    BBRC_PROFILE(BBRC_PROFILE_OUTPUT);
     float p, sig;
     if (fm::bbrc_chisq->active) {
         if (!fm::bbrc_regression) {
@@ -466,8 +469,8 @@ void BbrcGraphState::print ( unsigned int frequency ) {
             map<float, set<BbrcTid> > f_sets;
             map<float, map<BbrcTid,int> > f_maps;
 
-            if (!fm::bbrc_regression) { f_sets = fm::bbrc_chisq->f_sets; f_maps = fm::bbrc_chisq->f_maps; }
-            else { f_sets = fm::bbrc_ks->f_sets; f_maps = fm::bbrc_ks->f_maps; }
+            if (!fm::bbrc_regression) { fm::bbrc_chisq->Occurrences(); f_sets = fm::bbrc_chisq->f_sets; f_maps = fm::bbrc_chisq->f_maps; }
+            else { fm::bbrc_ks->Occurrences(); f_sets = fm::bbrc_ks->f_sets; f_maps = fm::bbrc_ks->f_maps; }
 
             map<float, set<BbrcTid> >::iterator f_sets_it;
             set<BbrcTid> fa_set;
@@ -542,12 +545,11 @@ void BbrcGraphState::print ( unsigned int frequency ) {
 // PRINT GSP TO OSS
 
 void BbrcGraphState::to_s ( string& oss ) {
-  static int counter = 0;
-  counter++;
+  fm::bbrc_gsp_written++;
   oss.append( "t");
   oss.append( " ");
   char x[20]; 
-  sprintf(x, "%i", counter);
+  sprintf(x, "%i", (int) fm::bbrc_gsp_written);
   (oss.append( x)).append("\n");
   for ( int i = 0; i < (int) nodes.size (); i++ ) {
     oss.append( "v");
@@ -636,6 +638,7 @@ void BbrcGraphState::DfsOut(int cur_n, string& oss, int from_n) {
 // ENTRY: BRANCH TO GSP (OSS) or PRINT YAML/LAZAR TO OSS
 
 string BbrcGraphState::to_s ( unsigned int frequency ) {
+    BBRC_PROFILE(BBRC_PROFILE_OUTPUT);
 
     float p, sig;
     if (fm::bbrc_chisq->active) {
@@ -692,8 +695,8 @@ string BbrcGraphState::to_s ( unsigned int frequency ) {
             map<float, set<BbrcTid> > f_sets;
             map<float, map<BbrcTid,int> > f_maps;
 
-            if (!fm::bbrc_regression) { f_sets = fm::bbrc_chisq->f_sets; f_maps = fm::bbrc_chisq->f_maps; }
-            else { f_sets = fm::bbrc_ks->f_sets; f_maps = fm::bbrc_ks->f_maps; }
+            if (!fm::bbrc_regression) { fm::bbrc_chisq->Occurrences(); f_sets = fm::bbrc_chisq->f_sets; f_maps = fm::bbrc_chisq->f_maps; }
+            else { fm::bbrc_ks->Occurrences(); f_sets = fm::bbrc_ks->f_sets; f_maps = fm::bbrc_ks->f_maps; }
 
             map<float, set<BbrcTid> >::iterator f_sets_it;
             set<BbrcTid> fa_set;
@@ -0,0 +1,366 @@
+// lattice.cpp
+
+/*
+    This file is part of LibBbrc (libbbrc).
+
+    LibBbrc is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    LibBbrc is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with LibBbrc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <string.h>
+#include "lattice.h"
+#include "graphstate.h"
+#include "checkpoint.h"
+
+namespace fm {
+    extern unsigned int bbrc_minfreq;
+    extern int bbrc_type;
+    extern bool bbrc_aromatic;
+    extern bool bbrc_refine_singles;
+    extern bool bbrc_do_backbone;
+    extern bool bbrc_bbrc_sep;
+    extern int bbrc_progress;
+
+    extern BbrcDatabase* bbrc_database;
+    extern ChisqBbrcConstraint* bbrc_chisq;
+    extern vector<BbrcEndpoint> bbrc_endpoints;
+    extern BbrcStatistics* bbrc_statistics;
+    extern BbrcGraphState* bbrc_graphstate;
+    extern BbrcCheckpoint* bbrc_checkpoint;
+    extern int bbrc_unit;
+}
+
+// File: magic line, then unsigned varints. Header: minfreq, type, refine singles, aromatic;
+// the input ids of the compounds; the input node labels; the edge labels by rank (input edge
+// label, from and to node label). Then one record per node in the order of the search: kind,
+// distance to the parent (0: root), connecting node (root: node label), edge label, frequency,
+// highest leg frequency and the tids of the support, delta coded.
+#define BBRC_LATTICE_MAGIC "FMINER LATTICE 1\n"
+
+
+// 1. Writing
+
+void BbrcLattice::put ( unsigned int val ) {
+  while ( val >= 0x80 ) {
+    putc ( ( val & 0x7f ) | 0x80, file );
+    val >>= 7;
+  }
+  putc ( val, file );
+}
+
+void BbrcLattice::header () {
+  BbrcDatabase &database = *fm::bbrc_database;
+  if ( fm::bbrc_chisq->active || fm::bbrc_endpoints.size () > 1 ) {
+    cerr << "Error! A lattice is written by frequent subgraph mining of all compounds, without activities." << endl;
+    exit(1);
+  }
+  fputs ( BBRC_LATTICE_MAGIC, file );
+  put ( fm::bbrc_minfreq );
+  put ( fm::bbrc_type );
+  put ( fm::bbrc_refine_singles );
+  put ( fm::bbrc_aromatic );
+  put ( database.orig_tids.size () );
+  for ( unsigned int i = 0; i < database.orig_tids.size (); i++ )
+    put ( database.orig_tids[i] );
+  put ( database.nodelabels.size () );
+  for ( unsigned int i = 0; i < database.nodelabels.size (); i++ )
+    put ( (unsigned short) database.nodelabels[i].inputlabel );
+  put ( database.edgelabelsindexes.size () );
+  for ( unsigned int i = 0; i < database.edgelabelsindexes.size (); i++ ) {
+    BbrcDatabaseBbrcEdgeLabel &label = database.edgelabels[database.edgelabelsindexes[i]];
+    put ( (unsigned short) label.inputedgelabel );
+    put ( label.fromnodelabel );
+    put ( label.tonodelabel );
+  }
+}
+
+// The record waits for the highest leg frequency, known when the pattern is expanded.
+void BbrcLattice::add ( BbrcLatticeKind kind, BbrcNodeId connectingnode, BbrcEdgeLabel edgelabel, BbrcLegOccurrences &legoccurrences ) {
+  if ( pending ) flush ();
+  last.kind = kind;
+  last.parent = stack.empty () ? NOLATTICENODE : stack.back ();
+  last.connectingnode = connectingnode;
+  last.edgelabel = edgelabel;
+  last.maxleg = 0;
+  lasttids.clear ();
+  vector<BbrcLegOccurrence> &elements = legoccurrences.elements;
+  for ( unsigned int i = 0; i < elements.size (); i++ )
+    if ( lasttids.empty () || elements[i].tid != lasttids.back () ) lasttids.push_back ( elements[i].tid );
+  last.frequency = lasttids.size ();
+  pending = true;
+}
+
+void BbrcLattice::enter ( BbrcFrequency maxleg ) {
+  last.maxleg = maxleg;
+  stack.push_back ( count );
+  flush ();
+}
+
+void BbrcLattice::leave () {
+  stack.pop_back ();
+  if ( stack.empty () ) { // root done
+    if ( pending ) flush ();
+    fflush ( file );
+  }
+}
+
+void BbrcLattice::flush () {
+  putc ( last.kind, file );
+  put ( last.parent == NOLATTICENODE ? 0 : count - last.parent );
+  put ( last.connectingnode );
+  put ( last.edgelabel );
+  put ( last.frequency );
+  put ( last.maxleg );
+  BbrcTid tid = 0;
+  for ( unsigned int i = 0; i < lasttids.size (); i++ ) {
+    put ( lasttids[i] - tid );
+    tid = lasttids[i];
+  }
+  count++;
+  pending = false;
+}
+
+
+// 2. Reading
+
+unsigned int BbrcLattice::get () {
+  unsigned int val = 0;
+  for ( int shift = 0; shift < 35; shift += 7 ) {
+    int c = getc ( file );
+    if ( c == EOF ) break;
+    val |= (unsigned int) ( c & 0x7f ) << shift;
+    if ( !( c & 0x80 ) ) return val;
+  }
+  cerr << "Error! Lattice file is corrupt." << endl;
+  exit(1);
+}
+
+void BbrcLattice::read () {
+  char magic[sizeof ( BBRC_LATTICE_MAGIC )];
+  if ( !fgets ( magic, sizeof ( magic ), file ) || strcmp ( magic, BBRC_LATTICE_MAGIC ) ) {
+    cerr << "Error! Not a lattice file." << endl;
+    exit(1);
+  }
+  minfreq = get ();
+  type = get ();
+  refine_singles = get ();
+  aromatic = get ();
+  compounds.resize ( get () );
+  for ( unsigned int i = 0; i < compounds.size (); i++ )
+    compounds[i] = get ();
+
+  BbrcDatabase &database = *fm::bbrc_database;
+  database.nodelabels.resize ( get () );
+  for ( unsigned int i = 0; i < database.nodelabels.size (); i++ )
+    database.nodelabels[i].inputlabel = get ();
+  database.edgelabels.resize ( get () );
+  database.edgelabelsindexes.resize ( database.edgelabels.size () );
+  for ( unsigned int i = 0; i < database.edgelabels.size (); i++ ) {
+    database.edgelabels[i].inputedgelabel = get ();
+    database.edgelabels[i].fromnodelabel = get ();
+    database.edgelabels[i].tonodelabel = get ();
+    database.edgelabels[i].edgelabel = i;
+    database.edgelabelsindexes[i] = i;
+  }
+
+  roots.assign ( database.nodelabels.size (), NOLATTICENODE );
+  vector<unsigned int> lastchild;
+  int kind;
+  while ( ( kind = getc ( file ) ) != EOF ) {
+    BbrcLatticeNode node;
+    unsigned int n = nodes.size ();
+    unsigned int distance = get ();
+    node.kind = kind;
+    node.parent = distance ? n - distance : NOLATTICENODE;
+    node.connectingnode = get ();
+    node.edgelabel = get ();
+    node.frequency = get ();
+    node.maxleg = get ();
+    node.tids = tids.size ();
+    node.child = node.next = NOLATTICENODE;
+    BbrcTid tid = 0;
+    for ( unsigned int i = 0; i < node.frequency; i++ ) {
+      tid += get ();
+      if ( tid >= compounds.size () ) node.kind = BBRC_LATTICE_TREE + 1;
+      tids.push_back ( tid );
+    }
+    if ( node.kind > BBRC_LATTICE_TREE || distance > n || ( node.kind == BBRC_LATTICE_ROOT ) != ( distance == 0 ) || ( !distance && node.connectingnode >= roots.size () ) ) {
+      cerr << "Error! Lattice file is corrupt." << endl;
+      exit(1);
+    }
+    if ( !distance ) roots[node.connectingnode] = n;
+    else if ( nodes[node.parent].child == NOLATTICENODE ) nodes[node.parent].child = n;
+    else nodes[lastchild[node.parent]].next = n;
+    if ( distance ) lastchild[node.parent] = n;
+    lastchild.push_back ( NOLATTICENODE );
+    nodes.push_back ( node );
+  }
+  cerr << "Lattice: " << compounds.size () << " compounds, " << nodes.size () << " patterns." << endl;
+}
+
+void BbrcLattice::check () {
+  if ( fm::bbrc_minfreq < minfreq || fm::bbrc_type > type || ( fm::bbrc_refine_singles && !refine_singles ) || fm::bbrc_aromatic != aromatic ) {
+    cerr << "Error! The lattice (minimum frequency " << minfreq << ", type " << type << ", refine singles " << refine_singles << ", aromatic " << aromatic << ") does not cover these settings." << endl;
+    exit(1);
+  }
+  tidmap.assign ( compounds.size (), NOTID );
+  complete = true;
+  for ( unsigned int i = 0; i < compounds.size (); i++ ) {
+    map<BbrcTid, BbrcDatabaseTreePtr>::iterator tree = fm::bbrc_database->trees_map.find ( compounds[i] );
+    if ( tree != fm::bbrc_database->trees_map.end () ) tidmap[i] = tree->second->tid;
+    else complete = false;
+  }
+  if ( !complete ) cerr << "Notice: Not all compounds of the lattice are mined, patterns are visited in the order of the lattice." << endl;
+}
+
+
+// 3. Replay, following BbrcPath::expand, BbrcPath::expand2 and BbrcPatternTree::expand
+
+BbrcFrequency BbrcLattice::frequency ( unsigned int n ) {
+  if ( complete ) return nodes[n].frequency;
+  BbrcFrequency frequency = 0;
+  for ( unsigned int i = 0; i < nodes[n].frequency; i++ )
+    if ( tidmap[tids[nodes[n].tids + i]] != NOTID ) frequency++;
+  return frequency;
+}
+
+// One occurrence per compound, in ascending tids of the replay.
+void BbrcLattice::occurrences ( unsigned int n, BbrcLegOccurrences &legoccurrences ) {
+  vector<BbrcTid> support;
+  for ( unsigned int i = 0; i < nodes[n].frequency; i++ ) {
+    BbrcTid tid = tidmap[tids[nodes[n].tids + i]];
+    if ( tid != NOTID ) support.push_back ( tid );
+  }
+  sort ( support.begin (), support.end () );
+  support.erase ( unique ( support.begin (), support.end () ), support.end () );
+  legoccurrences.elements.clear ();
+  for ( unsigned int i = 0; i < support.size (); i++ ) {
+    legoccurrences.elements.push_back ( BbrcLegOccurrence ( support[i], 0, 0, 0 ) );
+    legoccurrences.tidhash = bbrc_tidhash ( legoccurrences.tidhash, support[i] );
+  }
+  legoccurrences.frequency = support.size ();
+  legoccurrences.maxdegree = 0;
+  legoccurrences.parent = NULL;
+}
+
+void BbrcLattice::replay ( BbrcNodeLabel root ) {
+  unsigned int r = roots[root];
+  if ( r == NOLATTICENODE || frequency ( r ) < fm::bbrc_minfreq ) return;
+  unsigned int legs = 0;
+  for ( unsigned int c = nodes[r].child; c != NOLATTICENODE; c = nodes[c].next )
+    if ( frequency ( c ) >= fm::bbrc_minfreq ) legs++;
+  if ( !legs ) return;
+
+  InputBbrcNodeLabel inl = fm::bbrc_database->nodelabels[root].inputlabel;
+  cerr << "Root: " << inl << endl;
+  fm::bbrc_statistics->nr_roots = fm::bbrc_database->nodelabels.size ();
+  fm::bbrc_statistics->startRoot ( root, inl );
+  fm::bbrc_statistics->top_legs = legs;
+  if ( fm::bbrc_checkpoint ) fm::bbrc_checkpoint->startRoot ( root );
+  fm::bbrc_graphstate->insertStartNode ( root );
+
+  unsigned int leg = 0;
+  for ( unsigned int c = nodes[r].child; c != NOLATTICENODE; c = nodes[c].next ) {
+    if ( frequency ( c ) < fm::bbrc_minfreq ) continue;
+    if ( fm::bbrc_unit != NOLEG && (int) leg != fm::bbrc_unit ) { leg++; continue; } // another unit
+    if ( fm::bbrc_checkpoint && fm::bbrc_checkpoint->skip ( leg ) ) { fm::bbrc_statistics->top_done++; leg++; continue; } // replayed before the checkpoint
+    BbrcLegOccurrences legoccurrences;
+    occurrences ( c, legoccurrences );
+    fm::bbrc_graphstate->insertNode ( nodes[c].connectingnode, nodes[c].edgelabel, 0 );
+    BbrcMax child;
+    bbrcEvaluateTop ( legoccurrences, child );
+    expandPath ( c, child );
+    fm::bbrc_statistics->top_done++;
+    fm::bbrc_graphstate->deleteNode ();
+    if ( fm::bbrc_checkpoint ) fm::bbrc_checkpoint->leg ( leg );
+    leg++;
+  }
+
+  fm::bbrc_graphstate->deleteStartNode ();
+}
+
+void BbrcLattice::units ( BbrcNodeLabel root, vector<unsigned long> &sizes ) {
+  unsigned int r = roots[root];
+  if ( r == NOLATTICENODE || frequency ( r ) < fm::bbrc_minfreq ) return;
+  for ( unsigned int c = nodes[r].child; c != NOLATTICENODE; c = nodes[c].next ) {
+    BbrcFrequency f = frequency ( c );
+    if ( f >= fm::bbrc_minfreq ) sizes.push_back ( f );
+  }
+}
+
+void BbrcLattice::visit ( bool tree ) {
+  fm::bbrc_statistics->patternsize++;
+  fm::bbrc_statistics->node ( fm::bbrc_progress );
+  if ( fm::bbrc_statistics->patternsize > (int) fm::bbrc_statistics->frequenttreenumbers.size () ) {
+    fm::bbrc_statistics->frequenttreenumbers.resize ( fm::bbrc_statistics->patternsize, 0 );
+    fm::bbrc_statistics->frequentpathnumbers.resize ( fm::bbrc_statistics->patternsize, 0 );
+    fm::bbrc_statistics->frequentgraphnumbers.resize ( fm::bbrc_statistics->patternsize, 0 );
+  }
+  if ( tree ) ++fm::bbrc_statistics->frequenttreenumbers[fm::bbrc_statistics->patternsize-1];
+  else ++fm::bbrc_statistics->frequentpathnumbers[fm::bbrc_statistics->patternsize-1];
+}
+
+void BbrcLattice::grow ( unsigned int c, const BbrcMax &max ) {
+  BbrcLegOccurrences legoccurrences;
+  occurrences ( c, legoccurrences );
+  fm::bbrc_graphstate->insertNode ( nodes[c].connectingnode, nodes[c].edgelabel, 0 );
+  BbrcMax child;
+  if ( bbrcEvaluate ( legoccurrences, max, fm::bbrc_refine_singles || ( legoccurrences.frequency > 1 ), child ) ) {   // UB-PRUNING
+    if ( nodes[c].kind == BBRC_LATTICE_PATH ) expandPath ( c, child );
+    else expandTree ( c, child );
+  }
+  fm::bbrc_graphstate->deleteNode ();
+}
+
+// The children of a path are its path legs, then those of its tree phase.
+void BbrcLattice::expandPath ( unsigned int n, const BbrcMax &max ) {
+  visit ( false );
+
+  bool leaf = true;
+  for ( unsigned int c = nodes[n].child; c != NOLATTICENODE; c = nodes[c].next )
+    if ( nodes[c].kind == BBRC_LATTICE_PATH && frequency ( c ) >= fm::bbrc_minfreq ) leaf = false;
+  if ( fm::bbrc_do_backbone && leaf ) bbrcRepresentatives ( max );
+
+  for ( unsigned int c = nodes[n].child; c != NOLATTICENODE; c = nodes[c].next )
+    if ( nodes[c].kind == BBRC_LATTICE_PATH && frequency ( c ) >= fm::bbrc_minfreq ) grow ( c, max );
+
+  vector<bool> uptmp;
+  for ( unsigned int e = 0; e < fm::bbrc_endpoints.size (); e++ ) uptmp.push_back ( fm::bbrc_endpoints[e].updated );
+
+  if ( fm::bbrc_bbrc_sep && !fm::bbrc_do_backbone && nodes[n].maxleg >= fm::bbrc_minfreq ) bbrcSeparate ();
+
+  if ( fm::bbrc_type > 1 ) {
+    for ( unsigned int c = nodes[n].child; c != NOLATTICENODE; c = nodes[c].next )
+      if ( nodes[c].kind == BBRC_LATTICE_TREE && frequency ( c ) >= fm::bbrc_minfreq ) grow ( c, max );
+  }
+
+  for ( unsigned int e = 0; e < fm::bbrc_endpoints.size (); e++ ) fm::bbrc_endpoints[e].updated = uptmp[e];
+  fm::bbrc_statistics->patternsize--;
+}
+
+void BbrcLattice::expandTree ( unsigned int n, const BbrcMax &max ) {
+  visit ( true );
+
+  bool leaf = true;
+  for ( unsigned int c = nodes[n].child; c != NOLATTICENODE; c = nodes[c].next )
+    if ( frequency ( c ) >= fm::bbrc_minfreq ) leaf = false;
+  if ( fm::bbrc_do_backbone && leaf ) bbrcRepresentatives ( max );
+
+  for ( unsigned int c = nodes[n].child; c != NOLATTICENODE; c = nodes[c].next )
+    if ( frequency ( c ) >= fm::bbrc_minfreq ) grow ( c, max );
+
+  if ( fm::bbrc_bbrc_sep && !fm::bbrc_do_backbone && leaf ) bbrcSeparate ();
+
+  fm::bbrc_statistics->patternsize--;
+}
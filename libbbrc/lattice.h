@@ -0,0 +1,106 @@
+// lattice.h
+
+/*
+    This file is part of LibBbrc (libbbrc).
+
+    LibBbrc is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    LibBbrc is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with LibBbrc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Search tree of frequent subgraph mining on disk. A run without activities writes every
+// pattern it enumerates: the edge that grows it from its parent (DFS code), the parent link
+// and its support. A later run replays the tree for the activities of the same compounds,
+// with any stricter minimum frequency and significance and with BBRC representatives, instead
+// of the graph search. Stricter minimum frequencies keep the order of the edge labels, so the
+// replay visits the patterns in the order of a direct run and selects the same representatives.
+
+#ifndef LATTICE_H
+#define LATTICE_H
+
+#include <vector>
+#include <map>
+#include <cstdio>
+
+#include "misc.h"
+#include "database.h"
+#include "legoccurrence.h"
+#include "path.h"
+
+using namespace std;
+
+enum BbrcLatticeKind {
+  BBRC_LATTICE_ROOT,  // a node label, started from by MineRoot()
+  BBRC_LATTICE_PATH,  // grown by BbrcPath
+  BBRC_LATTICE_TREE   // grown by BbrcPatternTree (tree phase of a path included)
+};
+
+#define NOLATTICENODE ((unsigned int) -1)
+
+struct BbrcLatticeNode {
+  unsigned char kind;
+  unsigned int parent;
+  BbrcNodeId connectingnode; // root: its node label
+  BbrcEdgeLabel edgelabel; // rank, as in BbrcGraphState::insertNode
+  BbrcFrequency frequency;
+  BbrcFrequency maxleg; // highest frequency of the legs when the pattern was expanded (0: not expanded)
+  unsigned long tids; // position of the support in BbrcLattice::tids
+  unsigned int child, next; // first child and next sibling, in the order of the search
+};
+
+class BbrcLattice {
+  public:
+    BbrcLattice ( FILE* file, bool out ) : file ( file ), out ( out ), count ( 0 ), pending ( false ), complete ( true ), minfreq ( 0 ), type ( 0 ), refine_singles ( false ), aromatic ( false ) { }
+
+    FILE* file;
+    bool out; // written by the search, otherwise read and replayed
+    vector<BbrcTid> compounds; // input ids, by tid of the run that wrote the lattice
+
+    // writing, by the search
+    void header (); // settings, compounds and labels of fm::bbrc_database, after reorder
+    void add ( BbrcLatticeKind kind, BbrcNodeId connectingnode, BbrcEdgeLabel edgelabel, BbrcLegOccurrences &legoccurrences );
+    void enter ( BbrcFrequency maxleg ); // the pattern added last is expanded
+    void leave ();
+
+    // reading and replay
+    void read (); // fills the labels of fm::bbrc_database
+    void check (); // settings and compounds of the replay, after BbrcDatabase::group
+    void replay ( BbrcNodeLabel root ); // like BbrcPath::expand
+    void units ( BbrcNodeLabel root, vector<unsigned long> &sizes ); // like BbrcPath::units
+
+  private:
+    unsigned int count; // nodes written
+    vector<unsigned int> stack; // nodes being expanded
+    bool pending; // the node added last waits for enter () or the next node
+    BbrcLatticeNode last;
+    vector<BbrcTid> lasttids;
+    void flush ();
+    void put ( unsigned int val );
+    unsigned int get ();
+
+    vector<BbrcLatticeNode> nodes;
+    vector<BbrcTid> tids; // supports of all nodes, in lattice tids
+    vector<unsigned int> roots; // node of each node label (NOLATTICENODE: none)
+    vector<BbrcTid> tidmap; // tid of the replay for each lattice tid (NOTID: no activity)
+    bool complete; // all compounds have activities, the supports are unchanged
+    BbrcFrequency minfreq;
+    int type;
+    bool refine_singles, aromatic;
+    BbrcFrequency frequency ( unsigned int n );
+    void occurrences ( unsigned int n, BbrcLegOccurrences &legoccurrences );
+    void visit ( bool tree ); // statistics of a search node
+    void grow ( unsigned int n, const BbrcMax &max );
+    void expandPath ( unsigned int n, const BbrcMax &max );
+    void expandTree ( unsigned int n, const BbrcMax &max );
+};
+
+#endif
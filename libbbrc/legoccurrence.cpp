@@ -19,6 +19,8 @@
     along with LibBbrc.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+
 #include "legoccurrence.h"
 #include "closeleg.h"
 #include "database.h"
@@ -29,15 +31,29 @@ namespace fm {
     extern BbrcGraphState* bbrc_graphstate;
     extern BbrcLegOccurrences* bbrc_legoccurrences;
     extern unsigned int bbrc_minfreq;
+    extern int bbrc_type;
     extern vector<BbrcLegOccurrences> bbrc_Bbrccandidatelegsoccurrences; 
+    extern vector<BbrcEdgeLabel> bbrc_candidatelabels;
+    extern vector<BbrcTid> bbrc_candidatelastself;
+    extern vector<bool> bbrc_candidatetouched;
     extern vector<vector< CloseBbrcLegOccurrences> > bbrc_candidatecloselegsoccs;
     extern vector<bool> bbrc_candidateBbrccloselegsoccsused;
     extern bool bbrc_Bbrccloselegsoccsused;
+    extern BbrcStatistics* bbrc_statistics;
+    extern int bbrc_threads;
+    extern BbrcThreadPool bbrc_threadpool;
+    extern unsigned long bbrc_memory_budget;
+    extern unsigned int bbrc_chunk_size;
+    extern vector<BbrcLegChunk> bbrc_legchunks;
 }
 
 void BbrcinitBbrcLegStatics () {
   fm::bbrc_candidatecloselegsoccs.reserve ( 200 ); // should be larger than the largest structure that contains a cycle
   fm::bbrc_Bbrccandidatelegsoccurrences.resize ( fm::bbrc_database->frequentBbrcEdgeLabelSize () );
+  fm::bbrc_candidatelastself.resize ( fm::bbrc_database->frequentBbrcEdgeLabelSize () );
+  fm::bbrc_candidatetouched.resize ( 0 );
+  fm::bbrc_candidatetouched.resize ( fm::bbrc_database->frequentBbrcEdgeLabelSize (), false );
+  fm::bbrc_candidatelabels.resize ( 0 );
 }
 
 
@@ -64,21 +80,57 @@ ostream &operator<< ( ostream &stream, vector<BbrcLegOccurrence> &occs ) {
   return stream;
 }
 
-// This function is on the critical path. Its efficiency is MOST important.
-BbrcLegOccurrencesPtr bbrc_join ( BbrcLegOccurrences &legoccsdata1, BbrcNodeId connectingnode, BbrcLegOccurrences &legoccsdata2 ) {
-  if ( fm::bbrc_graphstate->getNodeDegree ( connectingnode ) == fm::bbrc_graphstate->getNodeMaxDegree ( connectingnode ) ) 
-    return NULL;
+// Splits an occurrence list into parts starting at a new tid, so that frequencies and self-join
+// counts of the parts add up, each of at least fm::bbrc_chunk_size occurrences. Returns the number
+// of parts in fm::bbrc_legchunks, 0 if the list is too small.
+static unsigned int bbrc_split ( vector<BbrcLegOccurrence> &legoccs ) {
+  unsigned int chunks = fm::bbrc_threads > 1 ? fm::bbrc_threads : 1;
+  if ( chunks > legoccs.size () / fm::bbrc_chunk_size )
+    chunks = legoccs.size () / fm::bbrc_chunk_size;
+  if ( chunks < 2 )
+    return 0;
+  if ( fm::bbrc_legchunks.size () < chunks ) // kept with their buffers
+    fm::bbrc_legchunks.resize ( chunks );
+  BbrcOccurrenceId from = 0;
+  for ( unsigned int c = 0; c < chunks; c++ ) {
+    BbrcOccurrenceId to = legoccs.size () * ( c + 1 ) / chunks;
+    if ( to < from )
+      to = from;
+    while ( to > 0 && to < legoccs.size () && legoccs[to].tid == legoccs[to - 1].tid )
+      to++;
+    fm::bbrc_legchunks[c].from = from;
+    fm::bbrc_legchunks[c].to = to;
+    from = to;
+  }
+  return chunks;
+}
 
+// the distinct tids of an occurrence list, in the order of the list
+static void bbrc_tids ( vector<BbrcLegOccurrence> &legoccs, vector<BbrcTid> &tids ) {
+  tids.resize ( 0 );
+  for ( unsigned int i = 0; i < legoccs.size (); i++ )
+    if ( tids.empty () || tids.back () != legoccs[i].tid )
+      tids.push_back ( legoccs[i].tid );
+}
+
+// Joins the occurrences from .. to of legoccsdata1 with the occurrences from2 .. to2 of
+// legoccsdata2 into out, which is emptied first. Returns the frequency.
+// This function is on the critical path. Its efficiency is MOST important.
+static BbrcFrequency bbrc_join ( BbrcLegOccurrences &legoccsdata1, BbrcOccurrenceId from, BbrcOccurrenceId to, BbrcLegOccurrences &legoccsdata2, BbrcOccurrenceId from2, BbrcOccurrenceId to2, BbrcLegOccurrences &out ) {
   BbrcFrequency frequency = 0;
+  BbrcTidHash tidhash = BBRC_TIDHASH_SEED;
   BbrcTid lasttid = NOTID;
   vector<BbrcLegOccurrence> &legoccs1 = legoccsdata1.elements, &legoccs2 = legoccsdata2.elements;
-  fm::bbrc_legoccurrences->elements.resize ( 0 );
-  fm::bbrc_legoccurrences->maxdegree = 0;
-  fm::bbrc_legoccurrences->selfjoin = 0;
-  //fm::bbrc_legoccurrences->elements.reserve ( legoccs1.size () * 2 ); // increased memory usage, and speed!
-  BbrcOccurrenceId j = 0, k = 0, l, m;
-  unsigned int legoccs1size = legoccs1.size (), legoccs2size = legoccs2.size (); // this increases speed CONSIDERABLY!
+  out.elements.resize ( 0 );
+  out.maxdegree = 0;
+  out.selfjoin = 0;
+  out.tidhash = tidhash;
+  //out.elements.reserve ( legoccs1.size () * 2 ); // increased memory usage, and speed!
+  BbrcOccurrenceId j = from, k = from2, l, m;
+  unsigned int legoccs1size = to, legoccs2size = to2; // this increases speed CONSIDERABLY!
   BbrcTid lastself = NOTID;
+  if ( j >= legoccs1size || k >= legoccs2size )
+    return 0;
 
   do {
     while ( j < legoccs1size && legoccs1[j].occurrenceid < legoccs2[k].occurrenceid ) {
@@ -107,21 +159,22 @@ BbrcLegOccurrencesPtr bbrc_join ( BbrcLegOccurrences &legoccsdata1, BbrcNodeId c
             for ( BbrcOccurrenceId l2 = l; l2 < k; l2++ ) {
 	      BbrcNodeId tonodeid = legoccs2[l2].tonodeid;
               if ( legoccs1[m2].tonodeid !=  tonodeid ) {
-                fm::bbrc_legoccurrences->elements.push_back ( BbrcLegOccurrence ( jlegocc.tid, m2, tonodeid, legoccs2[l2].fromnodeid ) );
-                Bbrcsetmax ( fm::bbrc_legoccurrences->maxdegree, fm::bbrc_database->trees[jlegocc.tid]->nodes[tonodeid].edges.size () );
+                out.elements.push_back ( BbrcLegOccurrence ( jlegocc.tid, m2, tonodeid, legoccs2[l2].fromnodeid ) );
+                Bbrcsetmax ( out.maxdegree, fm::bbrc_database->trees[jlegocc.tid]->nodes[tonodeid].edges.size () );
         		add = true;
         		d++;
               }
             }
 	    if ( d > 1 && jlegocc.tid != lastself ) {
 	      lastself = jlegocc.tid;
-	      fm::bbrc_legoccurrences->selfjoin++;
+	      out.selfjoin++;
 	    }
 	  }
 	  	  
 	  if ( jlegocc.tid != lasttid && add ) {
         lasttid = jlegocc.tid;
 	    frequency++;
+	    tidhash = bbrc_tidhash ( tidhash, lasttid );
 	  }
 
           if ( k == legoccs2size )
@@ -136,46 +189,139 @@ BbrcLegOccurrencesPtr bbrc_join ( BbrcLegOccurrences &legoccsdata1, BbrcNodeId c
   }
   while ( true );
 
-  if ( frequency >= fm::bbrc_minfreq ) {
-    fm::bbrc_legoccurrences->parent = &legoccsdata1;
-    fm::bbrc_legoccurrences->number = legoccsdata1.number + 1;
-    fm::bbrc_legoccurrences->frequency = frequency;
-    return fm::bbrc_legoccurrences;
-  }
-  else
-    return NULL;
+  out.tidhash = tidhash;
+  return frequency;
 }
 
-BbrcLegOccurrencesPtr bbrc_join ( BbrcLegOccurrences &legoccsdata ) {
-  if ( legoccsdata.selfjoin < fm::bbrc_minfreq ) 
-    return NULL;
-  fm::bbrc_legoccurrences->elements.resize ( 0 );
+// self-join of the occurrences from .. to of legoccsdata into out, which is emptied first
+static void bbrc_join ( BbrcLegOccurrences &legoccsdata, BbrcOccurrenceId from, BbrcOccurrenceId to, BbrcLegOccurrences &out ) {
+  out.elements.resize ( 0 );
   vector<BbrcLegOccurrence> &legoccs = legoccsdata.elements;
-  fm::bbrc_legoccurrences->maxdegree = 0;
-  fm::bbrc_legoccurrences->selfjoin = 0;
-  BbrcTid lastself = NOTID;
+  out.maxdegree = 0;
+  out.selfjoin = 0;
+  out.tidhash = BBRC_TIDHASH_SEED;
+  BbrcTid lastself = NOTID, lasttid = NOTID;
+  if ( from >= to )
+    return;
 
-  BbrcOccurrenceId j = 0, k, l, m;
+  BbrcOccurrenceId j = from, k, l, m;
   do {
     k = j;
     BbrcLegOccurrence &legocc = legoccs[k];
     do {
       j++;
     }
-    while ( j < legoccs.size () &&
+    while ( j < to &&
             legoccs[j].occurrenceid == legocc.occurrenceid );
+    if ( j - k > 1 && legocc.tid != lasttid ) {
+      lasttid = legocc.tid;
+      out.tidhash = bbrc_tidhash ( out.tidhash, lasttid );
+    }
     for ( l = k; l < j; l++ )
       for ( m = k; m < j; m++ )
         if ( l != m ) {
-          fm::bbrc_legoccurrences->elements.push_back ( BbrcLegOccurrence ( legocc.tid, l, legoccs[m].tonodeid, legoccs[m].fromnodeid ) );
-          Bbrcsetmax ( fm::bbrc_legoccurrences->maxdegree, fm::bbrc_database->trees[legocc.tid]->nodes[legoccs[m].tonodeid].edges.size () );
+          out.elements.push_back ( BbrcLegOccurrence ( legocc.tid, l, legoccs[m].tonodeid, legoccs[m].fromnodeid ) );
+          Bbrcsetmax ( out.maxdegree, fm::bbrc_database->trees[legocc.tid]->nodes[legoccs[m].tonodeid].edges.size () );
         }
     if ( ( j - k > 2 ) && legocc.tid != lastself ) {
       lastself = legocc.tid;
-      fm::bbrc_legoccurrences->selfjoin++;
+      out.selfjoin++;
+    }
+  }
+  while ( j < to );
+}
+
+static void *bbrc_join_chunk ( void *arg ) {
+  BbrcLegChunk &chunk = *(BbrcLegChunk *) arg;
+  if ( chunk.legoccsdata2 )
+    chunk.frequency = bbrc_join ( *chunk.legoccsdata1, chunk.from, chunk.to, *chunk.legoccsdata2, chunk.from2, chunk.to2, chunk.occurrences );
+  else
+    bbrc_join ( *chunk.legoccsdata1, chunk.from, chunk.to, chunk.occurrences );
+  bbrc_tids ( chunk.occurrences.elements, chunk.tids );
+  return NULL;
+}
+
+// Joins the chunks of bbrc_split in parallel and concatenates them into fm::bbrc_legoccurrences.
+// Returns the frequency.
+static BbrcFrequency bbrc_join_chunks ( unsigned int n, BbrcLegOccurrences &legoccsdata1, BbrcLegOccurrences *legoccsdata2 ) {
+  vector<BbrcLegChunk> &chunks = fm::bbrc_legchunks;
+  if ( legoccsdata2 ) { // the part of the second list with the same occurrence ids
+    vector<BbrcLegOccurrence> &legoccs1 = legoccsdata1.elements, &legoccs2 = legoccsdata2->elements;
+    for ( unsigned int c = 0; c < n; c++ ) {
+      chunks[c].from2 = c ? chunks[c - 1].to2 : 0;
+      chunks[c].to2 = chunks[c].from2;
+      if ( chunks[c].to == legoccs1.size () )
+        chunks[c].to2 = legoccs2.size ();
+      else
+        while ( chunks[c].to2 < legoccs2.size () && legoccs2[chunks[c].to2].occurrenceid < legoccs1[chunks[c].to].occurrenceid )
+          chunks[c].to2++;
     }
   }
-  while ( j < legoccs.size () );
+  for ( unsigned int c = 0; c < n; c++ ) {
+    chunks[c].legoccsdata1 = &legoccsdata1;
+    chunks[c].legoccsdata2 = legoccsdata2;
+  }
+  bbrc_parallel ( chunks, n, bbrc_join_chunk );
+
+  BbrcLegOccurrences &out = *fm::bbrc_legoccurrences;
+  BbrcFrequency frequency = 0;
+  unsigned int size = 0;
+  for ( unsigned int c = 0; c < n; c++ )
+    size += chunks[c].occurrences.elements.size ();
+  out.elements.resize ( 0 );
+  out.elements.reserve ( size );
+  out.maxdegree = 0;
+  out.selfjoin = 0;
+  out.tidhash = BBRC_TIDHASH_SEED;
+  for ( unsigned int c = 0; c < n; c++ ) {
+    BbrcLegOccurrences &part = chunks[c].occurrences;
+    out.elements.insert ( out.elements.end (), part.elements.begin (), part.elements.end () );
+    Bbrcsetmax ( out.maxdegree, part.maxdegree );
+    out.selfjoin += part.selfjoin;
+    frequency += chunks[c].frequency;
+    for ( unsigned int t = 0; t < chunks[c].tids.size (); t++ )
+      out.tidhash = bbrc_tidhash ( out.tidhash, chunks[c].tids[t] );
+  }
+  return frequency;
+}
+
+// counts the join of legoccsdata1 in out as candidate, returns it if it is frequent
+static BbrcLegOccurrencesPtr bbrc_frequent ( BbrcLegOccurrences &legoccsdata1, BbrcFrequency frequency, BbrcLegOccurrences &out ) {
+  fm::bbrc_statistics->candidate ( frequency, fm::bbrc_minfreq );
+  if ( frequency >= fm::bbrc_minfreq ) {
+    out.parent = &legoccsdata1;
+    out.number = legoccsdata1.number + 1;
+    out.frequency = frequency;
+    return &out;
+  }
+  else
+    return NULL;
+}
+
+// returns the bbrc_join if this bbrc_join is frequent. Lists of many occurrences are joined in parallel.
+BbrcLegOccurrencesPtr bbrc_join ( BbrcLegOccurrences &legoccsdata1, BbrcNodeId connectingnode, BbrcLegOccurrences &legoccsdata2 ) {
+  if ( fm::bbrc_graphstate->getNodeDegree ( connectingnode ) == fm::bbrc_graphstate->getNodeMaxDegree ( connectingnode ) ) 
+    return NULL;
+
+  BbrcFrequency frequency;
+  unsigned int chunks = bbrc_split ( legoccsdata1.elements );
+  if ( chunks )
+    frequency = bbrc_join_chunks ( chunks, legoccsdata1, &legoccsdata2 );
+  else
+    frequency = bbrc_join ( legoccsdata1, 0, legoccsdata1.elements.size (), legoccsdata2, 0, legoccsdata2.elements.size (), *fm::bbrc_legoccurrences );
+
+  return bbrc_frequent ( legoccsdata1, frequency, *fm::bbrc_legoccurrences );
+}
+
+BbrcLegOccurrencesPtr bbrc_join ( BbrcLegOccurrences &legoccsdata ) {
+  fm::bbrc_statistics->candidate ( legoccsdata.selfjoin, fm::bbrc_minfreq );
+  if ( legoccsdata.selfjoin < fm::bbrc_minfreq ) 
+    return NULL;
+  unsigned int chunks = bbrc_split ( legoccsdata.elements );
+  if ( chunks )
+    bbrc_join_chunks ( chunks, legoccsdata, NULL );
+  else
+    bbrc_join ( legoccsdata, 0, legoccsdata.elements.size (), *fm::bbrc_legoccurrences );
 
     // no need to check that we are frequent, we must be frequent
   fm::bbrc_legoccurrences->parent = &legoccsdata;
@@ -186,6 +332,198 @@ BbrcLegOccurrencesPtr bbrc_join ( BbrcLegOccurrences &legoccsdata ) {
   return fm::bbrc_legoccurrences;
 }
 
+// Splits tasks of the given work (occurrences) into consecutive parts of about the same work for the
+// threads of fm::bbrc_threads, part t are the tasks parts[t] .. parts[t+1] - 1. Returns the number
+// of parts, 0 if there is too little work to split.
+static unsigned int bbrc_partition ( vector<unsigned long> &work, vector<unsigned int> &parts ) {
+  unsigned long total = 0;
+  unsigned int tasks = 0;
+  for ( unsigned int k = 0; k < work.size (); k++ )
+    if ( work[k] ) {
+      total += work[k];
+      tasks++;
+    }
+  unsigned int n = fm::bbrc_threads > 1 ? fm::bbrc_threads : 1;
+  if ( n > tasks )
+    n = tasks;
+  if ( n > total / fm::bbrc_chunk_size )
+    n = total / fm::bbrc_chunk_size;
+  if ( n < 2 )
+    return 0;
+  parts.resize ( n + 1 );
+  parts[0] = 0;
+  unsigned long done = 0;
+  unsigned int k = 0;
+  for ( unsigned int t = 1; t < n; t++ ) {
+    while ( k < work.size () && done < total * t / n )
+      done += work[k++];
+    parts[t] = k;
+  }
+  parts[n] = work.size ();
+  return n;
+}
+
+BbrcThreadPool::BbrcThreadPool () : pid ( getpid () ), task ( NULL ), args ( NULL ), next ( 0 ), pending ( 0 ), busy ( false ), stop ( false ) {
+  pthread_mutex_init ( &mutex, NULL );
+  pthread_cond_init ( &ready, NULL );
+  pthread_cond_init ( &done, NULL );
+}
+
+BbrcThreadPool::~BbrcThreadPool () {
+  if ( pid != getpid () ) // forked, the workers are not ours
+    return;
+  pthread_mutex_lock ( &mutex );
+  stop = true;
+  pthread_cond_broadcast ( &ready );
+  pthread_mutex_unlock ( &mutex );
+  for ( unsigned int w = 0; w < workers.size (); w++ )
+    pthread_join ( workers[w], NULL );
+  pthread_cond_destroy ( &done );
+  pthread_cond_destroy ( &ready );
+  pthread_mutex_destroy ( &mutex );
+}
+
+bool BbrcThreadPool::take ( unsigned int &t ) {
+  if ( !args || next >= args->size () )
+    return false;
+  t = next++;
+  return true;
+}
+
+void *BbrcThreadPool::work ( void *arg ) {
+  BbrcThreadPool &pool = *(BbrcThreadPool *) arg;
+  unsigned int t;
+  pthread_mutex_lock ( &pool.mutex );
+  while ( !pool.stop ) {
+    if ( !pool.take ( t ) ) {
+      pthread_cond_wait ( &pool.ready, &pool.mutex );
+      continue;
+    }
+    pthread_mutex_unlock ( &pool.mutex );
+    pool.task ( (*pool.args)[t] );
+    pthread_mutex_lock ( &pool.mutex );
+    if ( !--pool.pending )
+      pthread_cond_signal ( &pool.done );
+  }
+  pthread_mutex_unlock ( &pool.mutex );
+  return NULL;
+}
+
+void BbrcThreadPool::run ( void *(*runtask) ( void * ), vector<void *> &tasks, unsigned int threads ) {
+  if ( pid != getpid () ) { // the state of the parent, without its workers
+    pid = getpid ();
+    workers.clear ();
+    busy = false;
+    pthread_mutex_init ( &mutex, NULL );
+    pthread_cond_init ( &ready, NULL );
+    pthread_cond_init ( &done, NULL );
+  }
+  pthread_mutex_lock ( &mutex );
+  if ( busy || tasks.size () < 2 || threads < 2 ) { // nested in a task, or nothing to share
+    pthread_mutex_unlock ( &mutex );
+    for ( unsigned int t = 0; t < tasks.size (); t++ )
+      runtask ( tasks[t] );
+    return;
+  }
+  busy = true;
+  while ( workers.size () + 1 < threads && workers.size () + 1 < tasks.size () ) {
+    pthread_t id;
+    if ( pthread_create ( &id, NULL, work, this ) )
+      break;
+    workers.push_back ( id );
+  }
+  task = runtask;
+  args = &tasks;
+  next = 1;
+  pending = tasks.size () - 1;
+  pthread_cond_broadcast ( &ready );
+  pthread_mutex_unlock ( &mutex );
+
+  runtask ( tasks[0] );
+  unsigned int t;
+  pthread_mutex_lock ( &mutex );
+  while ( take ( t ) ) { // those left by the workers
+    pthread_mutex_unlock ( &mutex );
+    runtask ( tasks[t] );
+    pthread_mutex_lock ( &mutex );
+    pending--;
+  }
+  while ( pending )
+    pthread_cond_wait ( &done, &mutex );
+  args = NULL;
+  busy = false;
+  pthread_mutex_unlock ( &mutex );
+}
+
+void bbrc_parallel ( void *(*run) ( void * ), vector<void *> &args ) {
+  fm::bbrc_threadpool.run ( run, args, fm::bbrc_threads );
+}
+
+// a thread of bbrc_join_siblings
+struct BbrcSiblingTask {
+  BbrcLegOccurrences *legoccsdata;
+  BbrcSiblingJoin *joins;
+  unsigned int from, to;
+};
+
+static void *bbrc_join_sibling ( void *arg ) {
+  BbrcSiblingTask &task = *(BbrcSiblingTask *) arg;
+  BbrcLegOccurrences &legoccsdata = *task.legoccsdata;
+  for ( unsigned int k = task.from; k < task.to; k++ ) {
+    BbrcSiblingJoin &join = task.joins[k];
+    if ( join.joined )
+      join.frequency = bbrc_join ( legoccsdata, 0, legoccsdata.elements.size (), *join.legoccsdata2, 0, join.legoccsdata2->elements.size (), join.occurrences );
+  }
+  return NULL;
+}
+
+unsigned long bbrc_join_siblings ( BbrcLegOccurrences &legoccsdata, vector<BbrcSiblingJoin> &joins, unsigned int from, unsigned int to ) {
+  for ( unsigned int k = from; k < to; k++ )
+    joins[k].joined = false;
+  // over the budget, the joins are left to bbrc_join, one at a time in fm::bbrc_legoccurrences
+  if ( fm::bbrc_threads < 2 || to < from + 2 || fm::bbrc_statistics->exceeds ( fm::bbrc_memory_budget ) )
+    return 0;
+  vector<unsigned long> work ( to - from, 0 ); // none for joins bbrc_join refuses
+  for ( unsigned int k = from; k < to; k++ ) {
+    BbrcSiblingJoin &join = joins[k];
+    if ( join.legoccsdata2 != &legoccsdata &&
+         fm::bbrc_graphstate->getNodeDegree ( join.connectingnode ) != fm::bbrc_graphstate->getNodeMaxDegree ( join.connectingnode ) )
+      work[k - from] = legoccsdata.elements.size () + join.legoccsdata2->elements.size ();
+  }
+  vector<unsigned int> parts;
+  unsigned int n = bbrc_partition ( work, parts );
+  if ( !n )
+    return 0;
+  vector<BbrcSiblingTask> tasks ( n );
+  for ( unsigned int t = 0; t < n; t++ ) {
+    tasks[t].legoccsdata = &legoccsdata;
+    tasks[t].joins = &joins[0];
+    tasks[t].from = from + parts[t];
+    tasks[t].to = from + parts[t + 1];
+  }
+  for ( unsigned int k = from; k < to; k++ )
+    joins[k].joined = work[k - from] > 0;
+  bbrc_parallel ( tasks, n, bbrc_join_sibling );
+  unsigned long bytes = 0;
+  for ( unsigned int k = from; k < to; k++ )
+    if ( joins[k].joined )
+      bytes += joins[k].occurrences.elements.capacity () * sizeof ( BbrcLegOccurrence );
+  return fm::bbrc_statistics->hold ( bytes, fm::bbrc_memory_budget );
+}
+
+void bbrc_free_siblings ( vector<BbrcSiblingJoin> &joins, unsigned int from, unsigned int to, unsigned long bytes ) {
+  for ( unsigned int k = from; k < to; k++ )
+    if ( joins[k].joined )
+      vector<BbrcLegOccurrence> ().swap ( joins[k].occurrences.elements );
+  fm::bbrc_statistics->release ( bytes );
+}
+
+BbrcLegOccurrencesPtr bbrc_join ( BbrcLegOccurrences &legoccsdata1, BbrcSiblingJoin &join ) {
+  if ( !join.joined )
+    return bbrc_join ( legoccsdata1, join.connectingnode, *join.legoccsdata2 );
+  return bbrc_frequent ( legoccsdata1, join.frequency, join.occurrences );
+}
+
 inline int nocycle ( BbrcDatabaseTreePtr tree, BbrcDatabaseTreeNode &node, BbrcNodeId tonode, BbrcOccurrenceId occurrenceid, BbrcLegOccurrencesPtr legoccurrencesdataptr ) {
   if ( !tree->nodes[tonode].incycle )
     return 0;
@@ -222,38 +560,45 @@ void candidateBbrcCloseBbrcLegsAllocate ( int number, int maxnumber ) {
   }
 }
 
+// Only the labels touched by the previous bbrc_extend are reset, so that the cost of a call
+// depends on the occurrences, not on the number of edge labels.
+inline void candidateBbrcLegsReset ( BbrcCandidateLegs &candidates ) {
+  for ( int i = 0; i < (int) candidates.labels.size (); i++ ) {
+    candidates.occurrences[candidates.labels[i]].frequency = 0;
+    candidates.touched[candidates.labels[i]] = false;
+  }
+  candidates.labels.resize ( 0 );
+}
 
+// initializes a candidate on its first touch in the current bbrc_extend
+inline BbrcLegOccurrences &candidateBbrcLeg ( BbrcCandidateLegs &candidates, BbrcEdgeLabel edgelabel, BbrcLegOccurrences &legoccurrencesdata ) {
+  BbrcLegOccurrences &candidate = candidates.occurrences[edgelabel];
+  if ( !candidates.touched[edgelabel] ) {
+    candidates.touched[edgelabel] = true;
+    candidates.labels.push_back ( edgelabel );
+    candidate.elements.resize ( 0 );
+    candidate.parent = &legoccurrencesdata;
+    candidate.number = legoccurrencesdata.number + 1;
+    candidate.maxdegree = 0;
+    candidate.frequency = 0;
+    candidate.tidhash = BBRC_TIDHASH_SEED;
+    candidate.selfjoin = 0;
+    candidates.lastself[edgelabel] = NOTID;
+  }
+  return candidate;
+}
 
-
-
-
-void bbrc_extend ( BbrcLegOccurrences &legoccurrencesdata ) {
+// Extends the occurrences from .. to of legoccurrencesdata by the edges with labels of at least
+// minlabel, except neglect, into candidates (reset first). Ring closures go to the global arrays.
+static void bbrc_extend ( BbrcLegOccurrences &legoccurrencesdata, BbrcOccurrenceId from, BbrcOccurrenceId to, BbrcEdgeLabel minlabel, BbrcEdgeLabel neglect, BbrcCandidateLegs &candidates ) {
   // we're trying hard to avoid repeated destructor/constructor calls for complex types like vectors.
   // better reuse previously allocated memory, if possible!
-  
-  
 
   vector<BbrcLegOccurrence> &legoccurrences = legoccurrencesdata.elements;   ///////////////////////////////////////AM : BUG!!!
 
+  candidateBbrcLegsReset ( candidates );
 
-
-  BbrcTid lastself[fm::bbrc_Bbrccandidatelegsoccurrences.size ()];
-
-  for ( int i = 0; i < (int) fm::bbrc_Bbrccandidatelegsoccurrences.size (); i++ ) {
-    fm::bbrc_Bbrccandidatelegsoccurrences[i].elements.resize ( 0 );
-    //fm::bbrc_Bbrccandidatelegsoccurrences[i].elements.reserve ( legoccurrences.size () ); // increases memory usage, but also speed!
-    fm::bbrc_Bbrccandidatelegsoccurrences[i].parent = &legoccurrencesdata;
-    fm::bbrc_Bbrccandidatelegsoccurrences[i].number = legoccurrencesdata.number + 1;
-    fm::bbrc_Bbrccandidatelegsoccurrences[i].maxdegree = 0;
-    fm::bbrc_Bbrccandidatelegsoccurrences[i].frequency = 0;
-    fm::bbrc_Bbrccandidatelegsoccurrences[i].selfjoin = 0;
-    lastself[i] = NOTID;
-  }
-
-  fm::bbrc_Bbrccloselegsoccsused = false; // we are lazy with the initialization of close leg arrays, as we may not need them at all in
-                             // many cases
-
-  for ( BbrcOccurrenceId i = 0; i < legoccurrences.size (); i++ ) {
+  for ( BbrcOccurrenceId i = from; i < to; i++ ) {
     BbrcLegOccurrence &legocc = legoccurrences[i];
     BbrcDatabaseTreePtr tree = fm::bbrc_database->trees[legocc.tid];
     BbrcDatabaseTreeNode &node = tree->nodes[legocc.tonodeid];
@@ -264,31 +609,42 @@ void bbrc_extend ( BbrcLegOccurrences &legoccurrencesdata ) {
         int number = nocycle ( tree, node, node.edges[j].tonode, i, &legoccurrencesdata );
 
         if ( number == 0 ) {
-          vector<BbrcLegOccurrence> &candidatelegsoccs = fm::bbrc_Bbrccandidatelegsoccurrences[edgelabel].elements;
-          if ( candidatelegsoccs.empty () )  fm::bbrc_Bbrccandidatelegsoccurrences[edgelabel].frequency++;
-          else {
+	  if ( edgelabel >= minlabel && edgelabel != neglect ) {
+            BbrcLegOccurrences &candidate = candidateBbrcLeg ( candidates, edgelabel, legoccurrencesdata );
+            vector<BbrcLegOccurrence> &candidatelegsoccs = candidate.elements;
+            if ( candidatelegsoccs.empty () ) {
+              candidate.frequency++;
+              candidate.tidhash = bbrc_tidhash ( candidate.tidhash, legocc.tid );
+            }
+            else {
 
-	            if ( candidatelegsoccs.back ().tid != legocc.tid )
-        	        fm::bbrc_Bbrccandidatelegsoccurrences[edgelabel].frequency++;
+	            if ( candidatelegsoccs.back ().tid != legocc.tid ) {
+        	        candidate.frequency++;
+        	        candidate.tidhash = bbrc_tidhash ( candidate.tidhash, legocc.tid );
+	            }
 
 	            if ( candidatelegsoccs.back ().occurrenceid == i &&
-	                lastself[edgelabel] != legocc.tid ) {
-                    lastself[edgelabel] = legocc.tid;
-	                fm::bbrc_Bbrccandidatelegsoccurrences[edgelabel].selfjoin++;
+	                candidates.lastself[edgelabel] != legocc.tid ) {
+                    candidates.lastself[edgelabel] = legocc.tid;
+	                candidate.selfjoin++;
 	            }
 
+            }
+            candidatelegsoccs.push_back ( BbrcLegOccurrence ( legocc.tid, i, node.edges[j].tonode, legocc.tonodeid ) );
+            Bbrcsetmax ( candidate.maxdegree, fm::bbrc_database->trees[legocc.tid]->nodes[node.edges[j].tonode].edges.size () );
           }
-          candidatelegsoccs.push_back ( BbrcLegOccurrence ( legocc.tid, i, node.edges[j].tonode, legocc.tonodeid ) );
-          Bbrcsetmax ( fm::bbrc_Bbrccandidatelegsoccurrences[edgelabel].maxdegree, fm::bbrc_database->trees[legocc.tid]->nodes[node.edges[j].tonode].edges.size () );
         }
 
         else if ( number - 1 != fm::bbrc_graphstate->nodes.back().edges[0].tonode ) {
-            candidateBbrcCloseBbrcLegsAllocate ( number, legoccurrencesdata.number + 1 );
-            vector<CloseBbrcLegOccurrence> &candidatelegsoccs = fm::bbrc_candidatecloselegsoccs[number][edgelabel].elements;
-            if ( !candidatelegsoccs.size () || candidatelegsoccs.back ().tid != legocc.tid )
-	            fm::bbrc_candidatecloselegsoccs[number][edgelabel].frequency++;
-            candidatelegsoccs.push_back ( CloseBbrcLegOccurrence ( legocc.tid, i ) );
-            Bbrcsetmax ( fm::bbrc_Bbrccandidatelegsoccurrences[edgelabel].maxdegree, fm::bbrc_database->trees[legocc.tid]->nodes[node.edges[j].tonode].edges.size () );
+            // ring closures are only legs of cyclic patterns (type 3), which are not mined
+            if ( fm::bbrc_type > 2 ) {
+              candidateBbrcCloseBbrcLegsAllocate ( number, legoccurrencesdata.number + 1 );
+              vector<CloseBbrcLegOccurrence> &candidatelegsoccs = fm::bbrc_candidatecloselegsoccs[number][edgelabel].elements;
+              if ( !candidatelegsoccs.size () || candidatelegsoccs.back ().tid != legocc.tid )
+	              fm::bbrc_candidatecloselegsoccs[number][edgelabel].frequency++;
+              candidatelegsoccs.push_back ( CloseBbrcLegOccurrence ( legocc.tid, i ) );
+            }
+            Bbrcsetmax ( candidateBbrcLeg ( candidates, edgelabel, legoccurrencesdata ).maxdegree, fm::bbrc_database->trees[legocc.tid]->nodes[node.edges[j].tonode].edges.size () );
         }
 
       }
@@ -296,78 +652,142 @@ void bbrc_extend ( BbrcLegOccurrences &legoccurrencesdata ) {
   }
 }
 
+static void *bbrc_extend_chunk ( void *arg ) {
+  BbrcLegChunk &chunk = *(BbrcLegChunk *) arg;
+  unsigned int labels = fm::bbrc_database->frequentBbrcEdgeLabelSize ();
+  if ( chunk.candidates.size () != labels ) {
+    chunk.candidates.resize ( labels );
+    chunk.lastself.resize ( labels );
+    chunk.touched.assign ( labels, false );
+    chunk.labels.resize ( 0 );
+    chunk.candidatetids.resize ( labels );
+  }
+  BbrcCandidateLegs candidates = { chunk.candidates, chunk.labels, chunk.lastself, chunk.touched };
+  bbrc_extend ( *chunk.legoccsdata1, chunk.from, chunk.to, chunk.minlabel, chunk.neglect, candidates );
+  for ( unsigned int i = 0; i < chunk.labels.size (); i++ )
+    bbrc_tids ( chunk.candidates[chunk.labels[i]].elements, chunk.candidatetids[chunk.labels[i]] );
+  return NULL;
+}
 
+// fills the global arrays of the candidates, lists of many occurrences are extended in parallel
+static void bbrc_extend_all ( BbrcLegOccurrences &legoccurrencesdata, BbrcEdgeLabel minlabel, BbrcEdgeLabel neglect ) {
+  BbrcCandidateLegs candidates = { fm::bbrc_Bbrccandidatelegsoccurrences, fm::bbrc_candidatelabels, fm::bbrc_candidatelastself, fm::bbrc_candidatetouched };
+  fm::bbrc_Bbrccloselegsoccsused = false; // we are lazy with the initialization of close leg arrays, as we may not need them at all in
+                             // many cases
 
+  // ring closures (type 3) are collected in the global arrays only
+  unsigned int n = fm::bbrc_type > 2 ? 0 : bbrc_split ( legoccurrencesdata.elements );
+  if ( !n ) {
+    bbrc_extend ( legoccurrencesdata, 0, legoccurrencesdata.elements.size (), minlabel, neglect, candidates );
+    sort ( fm::bbrc_candidatelabels.begin (), fm::bbrc_candidatelabels.end () );
+    return;
+  }
 
+  vector<BbrcLegChunk> &chunks = fm::bbrc_legchunks;
+  for ( unsigned int c = 0; c < n; c++ ) {
+    chunks[c].legoccsdata1 = &legoccurrencesdata;
+    chunks[c].minlabel = minlabel;
+    chunks[c].neglect = neglect;
+  }
+  bbrc_parallel ( chunks, n, bbrc_extend_chunk );
+
+  candidateBbrcLegsReset ( candidates );
+  for ( unsigned int c = 0; c < n; c++ ) {
+    for ( unsigned int i = 0; i < chunks[c].labels.size (); i++ ) {
+      BbrcEdgeLabel edgelabel = chunks[c].labels[i];
+      BbrcLegOccurrences &part = chunks[c].candidates[edgelabel];
+      BbrcLegOccurrences &candidate = candidateBbrcLeg ( candidates, edgelabel, legoccurrencesdata );
+      candidate.elements.insert ( candidate.elements.end (), part.elements.begin (), part.elements.end () );
+      candidate.frequency += part.frequency;
+      candidate.selfjoin += part.selfjoin;
+      Bbrcsetmax ( candidate.maxdegree, part.maxdegree );
+      vector<BbrcTid> &tids = chunks[c].candidatetids[edgelabel];
+      for ( unsigned int t = 0; t < tids.size (); t++ )
+        candidate.tidhash = bbrc_tidhash ( candidate.tidhash, tids[t] );
+    }
+  }
+  sort ( fm::bbrc_candidatelabels.begin (), fm::bbrc_candidatelabels.end () );
+}
 
-
+void bbrc_extend ( BbrcLegOccurrences &legoccurrencesdata ) {
+  bbrc_extend_all ( legoccurrencesdata, 0, NOEDGELABEL );
+}
 
 void bbrc_extend ( BbrcLegOccurrences &legoccurrencesdata, BbrcEdgeLabel minlabel, BbrcEdgeLabel neglect ) {
+  bbrc_extend_all ( legoccurrencesdata, minlabel, neglect );
+}
 
+inline void bbrc_putvarint ( vector<unsigned char> &packed, unsigned int value ) {
+  while ( value >= 0x80 ) {
+    packed.push_back ( (unsigned char) ( value | 0x80 ) );
+    value >>= 7;
+  }
+  packed.push_back ( (unsigned char) value );
+}
 
-  // we're trying hard to avoid repeated destructor/constructor calls for complex types like vectors.
-  // better reuse previously allocated memory, if possible!
-
-
-
-
-  vector<BbrcLegOccurrence> &legoccurrences = legoccurrencesdata.elements;  ///////////////////////////////////////AM : BUG!!!
-
+inline unsigned int bbrc_getvarint ( const unsigned char *&p ) {
+  unsigned int value = 0;
+  for ( int shift = 0; ; shift += 7 ) {
+    value |= (unsigned int) ( *p & 0x7f ) << shift;
+    if ( !( *p++ & 0x80 ) )
+      return value;
+  }
+}
 
+// zigzag encoding, tids and occurrence ids ascend, but do not rely on it
+inline unsigned int bbrc_delta ( unsigned int value, unsigned int last ) {
+  int delta = (int) ( value - last );
+  return ( (unsigned int) delta << 1 ) ^ (unsigned int) ( delta >> 31 );
+}
 
+inline unsigned int bbrc_undelta ( unsigned int delta, unsigned int last ) {
+  return last + ( ( delta >> 1 ) ^ ( 0u - ( delta & 1 ) ) );
+}
 
-  int lastself[fm::bbrc_Bbrccandidatelegsoccurrences.size ()];
-  
-  for ( int i = 0; i < (int) fm::bbrc_Bbrccandidatelegsoccurrences.size (); i++ ) {
-    fm::bbrc_Bbrccandidatelegsoccurrences[i].elements.resize ( 0 );
-    fm::bbrc_Bbrccandidatelegsoccurrences[i].parent = &legoccurrencesdata;
-    fm::bbrc_Bbrccandidatelegsoccurrences[i].number = legoccurrencesdata.number + 1;
-    fm::bbrc_Bbrccandidatelegsoccurrences[i].maxdegree = 0;
-    fm::bbrc_Bbrccandidatelegsoccurrences[i].selfjoin = 0;
-    lastself[i] = NOTID;
-    fm::bbrc_Bbrccandidatelegsoccurrences[i].frequency = 0;
+// Layout: capacity, size, then per occurrence the tid and occurrence id as differences
+// to the previous occurrence, and the node ids. Typically 4 bytes instead of 12.
+void bbrc_pack ( BbrcLegOccurrences &legoccurrences ) {
+  vector<BbrcLegOccurrence> &elements = legoccurrences.elements;
+  if ( !legoccurrences.packed.empty () || elements.empty () )
+    return;
+  vector<unsigned char> &packed = legoccurrences.packed;
+  packed.reserve ( 8 + elements.size () * 4 );
+  bbrc_putvarint ( packed, elements.capacity () );
+  bbrc_putvarint ( packed, elements.size () );
+  BbrcTid lasttid = 0;
+  BbrcOccurrenceId lastoccurrenceid = 0;
+  for ( unsigned int i = 0; i < elements.size (); i++ ) {
+    bbrc_putvarint ( packed, bbrc_delta ( elements[i].tid, lasttid ) );
+    bbrc_putvarint ( packed, bbrc_delta ( elements[i].occurrenceid, lastoccurrenceid ) );
+    bbrc_putvarint ( packed, elements[i].tonodeid );
+    bbrc_putvarint ( packed, elements[i].fromnodeid );
+    lasttid = elements[i].tid;
+    lastoccurrenceid = elements[i].occurrenceid;
   }
+  fm::bbrc_statistics->release ( elements.capacity () * sizeof ( BbrcLegOccurrence ) );
+  fm::bbrc_statistics->occurrence_bytes += packed.capacity ();
+  vector<BbrcLegOccurrence> ().swap ( elements );
+}
 
-  fm::bbrc_Bbrccloselegsoccsused = false; // we are lazy with the initialization of close leg arrays, as we may not need them at all in
-                             // many cases
-  for ( BbrcOccurrenceId i = 0; i < legoccurrences.size (); i++ ) {
-    BbrcLegOccurrence &legocc = legoccurrences[i];
-    BbrcDatabaseTreePtr tree = fm::bbrc_database->trees[legocc.tid];
-    BbrcDatabaseTreeNode &node = tree->nodes[legocc.tonodeid];
-    for ( int j = 0; j < node.edges.size (); j++ ) {
-      if ( node.edges[j].tonode != legocc.fromnodeid ) {
-	BbrcEdgeLabel edgelabel = node.edges[j].edgelabel;
-        int number = nocycle ( tree, node, node.edges[j].tonode, i, &legoccurrencesdata );
-        if ( number == 0 ) {
-	  if ( edgelabel >= minlabel && edgelabel != neglect ) {
-            vector<BbrcLegOccurrence> &candidatelegsoccs = fm::bbrc_Bbrccandidatelegsoccurrences[edgelabel].elements;
-            if ( candidatelegsoccs.empty () )
-  	      fm::bbrc_Bbrccandidatelegsoccurrences[edgelabel].frequency++;
-	    else {
-	      if ( candidatelegsoccs.back ().tid != legocc.tid )
-  	        fm::bbrc_Bbrccandidatelegsoccurrences[edgelabel].frequency++;
-	      if ( candidatelegsoccs.back ().occurrenceid == i &&
-                lastself[edgelabel] != (int) legocc.tid ) {
-                lastself[edgelabel] = legocc.tid;
-                fm::bbrc_Bbrccandidatelegsoccurrences[edgelabel].selfjoin++;
-              }
-            }
-            candidatelegsoccs.push_back ( BbrcLegOccurrence ( legocc.tid, i, node.edges[j].tonode, legocc.tonodeid ) );
-	    Bbrcsetmax ( fm::bbrc_Bbrccandidatelegsoccurrences[edgelabel].maxdegree, fm::bbrc_database->trees[legocc.tid]->nodes[node.edges[j].tonode].edges.size () );
-	  }
-        }
-        else if ( number - 1 != fm::bbrc_graphstate->nodes.back().edges[0].tonode ) {
-          candidateBbrcCloseBbrcLegsAllocate ( number, legoccurrencesdata.number + 1 );
-
-          vector<CloseBbrcLegOccurrence> &candidatelegsoccs = fm::bbrc_candidatecloselegsoccs[number][edgelabel].elements;
-          if ( !candidatelegsoccs.size () || candidatelegsoccs.back ().tid != legocc.tid )
-	    fm::bbrc_candidatecloselegsoccs[number][edgelabel].frequency++;
-          candidatelegsoccs.push_back ( CloseBbrcLegOccurrence ( legocc.tid, i ) );
-          Bbrcsetmax ( fm::bbrc_Bbrccandidatelegsoccurrences[edgelabel].maxdegree, fm::bbrc_database->trees[legocc.tid]->nodes[node.edges[j].tonode].edges.size () );
-        }
-      }
-    }
+void bbrc_unpack ( BbrcLegOccurrences &legoccurrences ) {
+  if ( legoccurrences.packed.empty () )
+    return;
+  vector<BbrcLegOccurrence> &elements = legoccurrences.elements;
+  const unsigned char *p = &legoccurrences.packed[0];
+  elements.reserve ( bbrc_getvarint ( p ) ); // as before, the bytes accounted for by BbrcStatistics::hold
+  unsigned int size = bbrc_getvarint ( p );
+  BbrcTid tid = 0;
+  BbrcOccurrenceId occurrenceid = 0;
+  for ( unsigned int i = 0; i < size; i++ ) {
+    tid = bbrc_undelta ( bbrc_getvarint ( p ), tid );
+    occurrenceid = bbrc_undelta ( bbrc_getvarint ( p ), occurrenceid );
+    BbrcNodeId tonodeid = bbrc_getvarint ( p );
+    BbrcNodeId fromnodeid = bbrc_getvarint ( p );
+    elements.push_back ( BbrcLegOccurrence ( tid, occurrenceid, tonodeid, fromnodeid ) );
   }
+  fm::bbrc_statistics->release ( legoccurrences.packed.capacity () );
+  fm::bbrc_statistics->occurrence_bytes += elements.capacity () * sizeof ( BbrcLegOccurrence );
+  vector<unsigned char> ().swap ( legoccurrences.packed );
 }
 
 /*
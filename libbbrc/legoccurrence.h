@@ -23,6 +23,8 @@
 #define LEGOCCURRENCE_H
 #include <iostream>
 #include <vector>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "misc.h"
 
@@ -44,16 +46,141 @@ struct BbrcLegOccurrence {
 struct BbrcLegOccurrences;
 typedef BbrcLegOccurrences *BbrcLegOccurrencesPtr;
 
+typedef unsigned long long BbrcTidHash;
+#define BBRC_TIDHASH_SEED 0x84222325cbf29ce4ULL
+
+// rolling hash over the distinct tids of an occurrence list, in ascending order
+inline BbrcTidHash bbrc_tidhash ( BbrcTidHash tidhash, BbrcTid tid ) {
+  tidhash = ( tidhash ^ ( tid + 0x9e3779b97f4a7c15ULL ) ) * 0xff51afd7ed558ccdULL;
+  return tidhash ^ ( tidhash >> 32 );
+}
+
 struct BbrcLegOccurrences {
   vector<BbrcLegOccurrence> elements;
+  vector<unsigned char> packed; // elements, delta and varint encoded by bbrc_pack
   BbrcLegOccurrencesPtr parent;
   int number;
   BbrcFrequency selfjoin;
   short unsigned int maxdegree;
   BbrcFrequency frequency;
-  BbrcLegOccurrences () : selfjoin ( 0 ), frequency ( 0 ) { }
+  BbrcTidHash tidhash; // of the tids counted in frequency; equal frequency and hash: same support
+  BbrcLegOccurrences () : selfjoin ( 0 ), frequency ( 0 ), tidhash ( BBRC_TIDHASH_SEED ) { }
+};
+
+// member-wise, so that store () exchanges the occurrence lists instead of copying them
+inline void swap ( BbrcLegOccurrences &a, BbrcLegOccurrences &b ) {
+  a.elements.swap ( b.elements );
+  a.packed.swap ( b.packed );
+  std::swap ( a.parent, b.parent );
+  std::swap ( a.number, b.number );
+  std::swap ( a.selfjoin, b.selfjoin );
+  std::swap ( a.maxdegree, b.maxdegree );
+  std::swap ( a.frequency, b.frequency );
+  std::swap ( a.tidhash, b.tidhash );
+}
+
+// Legs of unwound search levels are kept for reuse, together with the capacity of their
+// occurrence lists, so that search nodes do not allocate and free every leg. The capacity
+// is held in the statistics while pooled; over the memory budget, legs are freed instead.
+template <class T> class BbrcLegPool {
+  public:
+    ~BbrcLegPool () { clear (); }
+    T *get ( BbrcStatistics &statistics ) {
+      if ( pool.empty () )
+        return new T;
+      T *leg = pool.back ();
+      pool.pop_back ();
+      statistics.unpool ( capacity ( leg ) );
+      return leg;
+    }
+    // takes back all legs of a level at once
+    void put ( vector<T *> &legs, BbrcStatistics &statistics, unsigned long budget ) {
+      for ( unsigned int i = 0; i < legs.size (); i++ ) {
+        if ( statistics.exceeds ( budget ) ) {
+          delete legs[i];
+          continue;
+        }
+        *legs[i] = T (); // assignment keeps the capacity of the occurrence list
+        statistics.pool ( capacity ( legs[i] ), budget );
+        pool.push_back ( legs[i] );
+      }
+      legs.clear ();
+    }
+    // after the statistics that held the capacity are gone, see Bbrc::Reset
+    void clear () {
+      for ( unsigned int i = 0; i < pool.size (); i++ )
+        delete pool[i];
+      pool.clear ();
+    }
+  private:
+    static unsigned long capacity ( T *leg ) { return leg->occurrences.elements.capacity () * sizeof ( leg->occurrences.elements[0] ); }
+    vector<T *> pool;
+};
+
+// the candidates of bbrc_extend, indexed by edge label
+struct BbrcCandidateLegs {
+  vector<BbrcLegOccurrences> &occurrences;
+  vector<BbrcEdgeLabel> &labels; // touched, see touched
+  vector<BbrcTid> &lastself;
+  vector<bool> &touched;
+};
+
+// Part of a long occurrence list, joined or extended by a thread of its own.
+struct BbrcLegChunk {
+  BbrcLegOccurrences *legoccsdata1, *legoccsdata2; // the lists joined (legoccsdata2 NULL for the self-join) or extended
+  BbrcEdgeLabel minlabel, neglect; // bbrc_extend
+  BbrcOccurrenceId from, to, from2, to2; // occurrences of the (first and second) list
+  BbrcLegOccurrences occurrences; // bbrc_join
+  BbrcFrequency frequency;
+  vector<BbrcTid> tids; // distinct tids of occurrences, for the tid hash
+  vector<BbrcLegOccurrences> candidates; // bbrc_extend
+  vector<BbrcEdgeLabel> labels;
+  vector<BbrcTid> lastself;
+  vector<bool> touched;
+  vector<vector<BbrcTid> > candidatetids;
 };
 
+// The join of a leg with one of its siblings, see bbrc_join_siblings.
+struct BbrcSiblingJoin {
+  BbrcNodeId connectingnode;
+  BbrcLegOccurrences *legoccsdata2;
+  BbrcLegOccurrences occurrences;
+  BbrcFrequency frequency;
+  bool joined; // by bbrc_join_siblings, else left to bbrc_join
+};
+
+// Worker threads, started on first use and kept for the tasks of bbrc_parallel. A process forked
+// from one with workers (see pid) starts its own, as the workers are not copied into it.
+class BbrcThreadPool {
+  public:
+    BbrcThreadPool ();
+    ~BbrcThreadPool ();
+    // runs runtask ( args[t] ) for all args, args[0] in this thread, the others in up to 'threads' - 1
+    // workers (or in this thread, while a run of the pool is in progress or no worker can be started)
+    void run ( void *(*runtask) ( void * ), vector<void *> &args, unsigned int threads );
+  private:
+    static void *work ( void *pool );
+    bool take ( unsigned int &t ); // the next task, with the mutex locked
+    pthread_mutex_t mutex;
+    pthread_cond_t ready, done;
+    vector<pthread_t> workers;
+    pid_t pid;
+    void *(*task) ( void * );
+    vector<void *> *args;
+    unsigned int next, pending;
+    bool busy, stop;
+};
+
+// Runs run ( &tasks[t] ) for the first n tasks on the workers of fm::bbrc_threads, the first in this
+// thread, and returns when all are done.
+void bbrc_parallel ( void *(*run) ( void * ), vector<void *> &args );
+template <class T> void bbrc_parallel ( vector<T> &tasks, unsigned int n, void *(*run) ( void * ) ) {
+  vector<void *> args ( n );
+  for ( unsigned int t = 0; t < n; t++ )
+    args[t] = &tasks[t];
+  bbrc_parallel ( run, args );
+}
+
 ostream &operator<< ( ostream &stream, vector<BbrcLegOccurrence> &occs );
 
 //extern BbrcLegOccurrences legoccurrences;
@@ -62,14 +189,40 @@ ostream &operator<< ( ostream &stream, vector<BbrcLegOccurrence> &occs );
 BbrcLegOccurrencesPtr bbrc_join ( BbrcLegOccurrences &legoccsdata1, BbrcNodeId connectingnode, BbrcLegOccurrences &legoccsdata2 );
 BbrcLegOccurrencesPtr bbrc_join ( BbrcLegOccurrences &legoccsdata );
 
+// Joins legoccsdata with the siblings of joins from .. to - 1 (but itself) in parallel, if there are
+// enough occurrences and the memory budget is not exceeded. bbrc_join ( legoccsdata, joins[k] ) then
+// returns the join with sibling k like bbrc_join above; call it in the order of the siblings, as it
+// counts the candidates. Returns the bytes of the joins held in the statistics until bbrc_free_siblings.
+unsigned long bbrc_join_siblings ( BbrcLegOccurrences &legoccsdata, vector<BbrcSiblingJoin> &joins, unsigned int from, unsigned int to );
+BbrcLegOccurrencesPtr bbrc_join ( BbrcLegOccurrences &legoccsdata1, BbrcSiblingJoin &join );
+// frees the buffers of the joins from .. to - 1 once they are stored, and releases their bytes
+void bbrc_free_siblings ( vector<BbrcSiblingJoin> &joins, unsigned int from, unsigned int to, unsigned long bytes );
+
+// the same for the legs from .. siblings.size () - 1 of a path or tree
+template <class L> unsigned long bbrc_join_siblings ( BbrcLegOccurrences &legoccsdata, vector<L *> &siblings, unsigned int from, vector<BbrcSiblingJoin> &joins ) {
+  if ( joins.size () < siblings.size () ) // without buffers between levels, see bbrc_free_siblings
+    joins.resize ( siblings.size () );
+  for ( unsigned int k = from; k < siblings.size (); k++ ) {
+    joins[k].connectingnode = siblings[k]->tuple.connectingnode;
+    joins[k].legoccsdata2 = &siblings[k]->occurrences;
+  }
+  return bbrc_join_siblings ( legoccsdata, joins, from, siblings.size () );
+}
+
 extern vector<BbrcLegOccurrences> Bbrccandidatelegsoccurrences; // for each frequent possible edge, the occurrences found, used by bbrc_extend
+extern vector<BbrcEdgeLabel> bbrc_candidatelabels; // the labels of Bbrccandidatelegsoccurrences filled by the last bbrc_extend, in ascending order
 extern vector<BbrcFrequency> Bbrccandidatelegsfrequencies;
 
 void BbrcinitBbrcLegStatics ();
 
+// Lists of many occurrences are split at tids and processed by the threads of fm::bbrc_threads.
 void bbrc_extend ( BbrcLegOccurrences &legoccurrencesdata ); // fills the global arrays above
 void bbrc_extend ( BbrcLegOccurrences &legoccurrencesdata, BbrcEdgeLabel minlabel, BbrcEdgeLabel neglect );
 
+// compresses the occurrence list of a leg that waits for its turn, and restores it
+void bbrc_pack ( BbrcLegOccurrences &legoccurrences );
+void bbrc_unpack ( BbrcLegOccurrences &legoccurrences );
+
 void sanityCheck ( BbrcLegOccurrencesPtr legoccurrencesptr );
 
 #endif
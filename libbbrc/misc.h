@@ -25,6 +25,9 @@
 #include <stdio.h>
 #include <iostream>
 #include <sstream>
+#include <fstream>
+#include <unistd.h>
+#include <sys/time.h>
 
 using namespace std;
 
@@ -63,13 +66,125 @@ extern int Bbrclevel; // 3 : all, 2 : paths and trees, 1 : paths
 
 inline void Bbrcsetmax ( short unsigned int &a, short unsigned int b ) { if ( b > a ) a = b; }
 
+//! Search counters of one level, i.e. of the refinements of patterns with a given number of edges.
+class BbrcLevelStatistics {
+  public:
+    BbrcLevelStatistics() : generated(0), minfreq(0), static_ub(0), dynamic_ub(0), singles(0), not_normal(0), representatives(0) {}
+    unsigned int generated; //!< Candidate extensions with non-zero support.
+    unsigned int minfreq; //!< Candidates rejected by minimum frequency.
+    unsigned int static_ub; //!< Branches cut by the static upper bound (u < sig).
+    unsigned int dynamic_ub; //!< Branches cut by the dynamic upper bound only (sig <= u < cmax).
+    unsigned int singles; //!< Branches not refined because of single support.
+    unsigned int not_normal; //!< Candidates rejected as non-canonical.
+    unsigned int representatives; //!< BBRC representatives emitted.
+};
+
+//! Search counters of one root node, by level.
+class BbrcRootStatistics {
+  public:
+    BbrcRootStatistics(int _root, int _label) : root(_root), label(_label) {}
+    int root; //!< Index of the root node.
+    int label; //!< Input label of the root node.
+    vector<BbrcLevelStatistics> levels;
+};
+
 class BbrcStatistics {
   public:
-    BbrcStatistics() : patternsize(0) {}
+    BbrcStatistics() : patternsize(0), nodes(0), nr_roots(0), top_legs(0), top_done(0), occurrence_bytes(0), occurrence_peak(0), pooled_bytes(0), last_nodes(0), over_budget(false) { start = root_start = last_report = now (); }
     vector<unsigned int> frequenttreenumbers;
     vector<unsigned int> frequentpathnumbers;
     vector<unsigned int> frequentgraphnumbers;
+    vector<BbrcRootStatistics> roots;
     int patternsize;
+    unsigned long nodes; //!< Search nodes visited so far.
+    int nr_roots; //!< Number of root nodes in the database.
+    unsigned int top_legs; //!< Top-level legs of the current root.
+    unsigned int top_done; //!< Top-level legs of the current root that are completely expanded.
+    unsigned long occurrence_bytes; //!< Bytes held by the occurrence lists of the search nodes on the DFS stack and of the pooled legs.
+    unsigned long occurrence_peak; //!< High-water mark of occurrence_bytes.
+    unsigned long pooled_bytes; //!< Part of occurrence_bytes kept by the leg pools for reuse, see BbrcLegPool.
+    void startRoot ( int root, int label ) {
+        roots.push_back ( BbrcRootStatistics ( root, label ) );
+        root_start = now ();
+        top_legs = top_done = 0;
+    }
+    //! Counts a search node and prints a progress line to STDERR if 'interval' seconds (0: never) have passed since the last one.
+    void node ( int interval ) {
+        nodes++;
+        if ( interval && !( nodes & 1023 ) ) {
+            double t = now ();
+            if ( t - last_report >= interval ) progress ( t );
+        }
+    }
+    //! Accounts the occurrence lists of a search node entering the DFS stack and returns their size for release().
+    //! If they would exceed 'budget' bytes (0: no budget), spare capacity is released first.
+    template <typename LegPtr, typename CloseLegPtr>
+    unsigned long hold ( vector<LegPtr> &legs, vector<CloseLegPtr> &closelegs, unsigned long budget ) {
+        unsigned long bytes = held ( legs, closelegs, false );
+        if ( budget && occurrence_bytes + bytes > budget )
+            bytes = held ( legs, closelegs, true );
+        return hold ( bytes, budget );
+    }
+    //! Accounts further occurrence lists of 'bytes' bytes, such as the sibling joins of bbrc_join_siblings (), and returns them for release().
+    unsigned long hold ( unsigned long bytes, unsigned long budget ) {
+        if ( budget && occurrence_bytes + bytes > budget && !over_budget ) {
+            cerr << "Warning! Occurrence lists hold " << occurrence_bytes + bytes << " bytes, more than the memory budget of " << budget << " bytes." << endl;
+            over_budget = true;
+        }
+        occurrence_bytes += bytes;
+        if ( occurrence_bytes > occurrence_peak ) occurrence_peak = occurrence_bytes;
+        return bytes;
+    }
+    void release ( unsigned long bytes ) { occurrence_bytes -= bytes; }
+    //! Accounts the capacity kept by a leg taken back by a BbrcLegPool, see hold().
+    void pool ( unsigned long bytes, unsigned long budget ) { pooled_bytes += hold ( bytes, budget ); }
+    void unpool ( unsigned long bytes ) { pooled_bytes -= bytes; release ( bytes ); }
+    //! True if the occurrence lists exceed the budget (0: no budget); legs waiting for their turn are then compressed.
+    bool exceeds ( unsigned long budget ) { return budget && occurrence_bytes > budget; }
+    void progress ( double t ) {
+        unsigned int representatives = 0;
+        for (unsigned int i = 0; i < roots.size (); i++ )
+          for (unsigned int d = 0; d < roots[i].levels.size (); d++ )
+            representatives += roots[i].levels[d].representatives;
+        cerr << "Progress: root " << ( roots.empty () ? -1 : roots.back ().label ) << " (" << roots.size () << "/" << nr_roots << ")"
+             << ", depth " << patternsize
+             << ", " << nodes << " nodes (" << (unsigned long) ( ( nodes - last_nodes ) / ( t - last_report ) ) << "/s)"
+             << ", " << representatives << " representatives"
+             << ", " << rss () << "kB";
+        if ( top_legs ) {
+            cerr << ", " << top_done << "/" << top_legs << " top-level legs";
+            if ( top_done ) cerr << ", ETA root " << (unsigned long) ( ( t - root_start ) * ( top_legs - top_done ) / top_done ) << "s";
+        }
+        cerr << ", " << (unsigned long) ( t - start ) << "s elapsed" << endl;
+        last_report = t;
+        last_nodes = nodes;
+    }
+    //! Counters of the current root for the pattern being refined (offset 0) or for a child under construction (offset 1).
+    BbrcLevelStatistics& level ( int offset = 0 ) {
+        if ( roots.empty () ) startRoot ( -1, -1 );
+        vector<BbrcLevelStatistics> &levels = roots.back ().levels;
+        unsigned int d = patternsize + offset;
+        if ( d >= levels.size () ) levels.resize ( d + 1 );
+        return levels[d];
+    }
+    //! Records a candidate of a child under construction.
+    void candidate ( BbrcFrequency frequency, BbrcFrequency minfreq ) {
+        if ( !frequency ) return;
+        BbrcLevelStatistics &l = level ( 1 );
+        l.generated++;
+        if ( frequency < minfreq ) l.minfreq++;
+    }
+    //! Records why a leg was not refined: upper bound (below_sig distinguishes static from dynamic bound) or single support.
+    void prune ( bool ub_ok, bool below_sig ) {
+        BbrcLevelStatistics &l = level ();
+        if ( ub_ok ) l.singles++;
+        else if ( below_sig ) l.static_ub++;
+        else l.dynamic_ub++;
+    }
+    //! Records a BBRC representative, unless it was filtered by significance.
+    void representative ( const string &pattern ) {
+        if ( pattern.size () ) level ().representatives++;
+    }
     void print () {
         int total = 0, total2 = 0, total3 = 0;
         for (unsigned int i = 0; i < frequenttreenumbers.size (); i++ ) {
@@ -84,7 +199,100 @@ class BbrcStatistics {
         }
         cerr << "TOTAL:" << endl
            << "Frequent cyclic graphs: " << total << " real trees: " << total2 << " paths: " << total3 << " total: " << total + total2 + total3 << endl;
+        cerr << "Peak occurrence memory: " << occurrence_peak << " bytes" << endl;
     }  
+    string to_json () {
+        unsigned int total = 0, total2 = 0, total3 = 0;
+        for (unsigned int i = 0; i < frequenttreenumbers.size (); i++ ) {
+          total += frequentgraphnumbers[i];
+          total2 += frequenttreenumbers[i];
+          total3 += frequentpathnumbers[i];
+        }
+        ostringstream os;
+        os << "{\"nodes\": {\"graphs\": " << total << ", \"trees\": " << total2 << ", \"paths\": " << total3 << "}," << endl
+           << " \"occurrence_bytes\": {\"current\": " << occurrence_bytes << ", \"pooled\": " << pooled_bytes << ", \"peak\": " << occurrence_peak << "}," << endl
+           << " \"roots\": [";
+        for (unsigned int i = 0; i < roots.size (); i++ ) {
+          os << ( i ? "," : "" ) << endl << "  {\"root\": " << roots[i].root << ", \"label\": " << roots[i].label << ", \"levels\": [";
+          for (unsigned int d = 0; d < roots[i].levels.size (); d++ ) {
+            BbrcLevelStatistics &l = roots[i].levels[d];
+            os << ( d ? "," : "" ) << endl
+               << "   {\"depth\": " << d << ", \"generated\": " << l.generated << ", \"minfreq\": " << l.minfreq
+               << ", \"static_ub\": " << l.static_ub << ", \"dynamic_ub\": " << l.dynamic_ub << ", \"singles\": " << l.singles
+               << ", \"not_normal\": " << l.not_normal << ", \"representatives\": " << l.representatives << "}";
+          }
+          os << "]}";
+        }
+        os << endl << " ]}" << endl;
+        return os.str ();
+    }
+    //! Writes the counters as text, e.g. for a checkpoint.
+    void save ( ostream &os ) {
+        os << nodes << " " << occurrence_peak << " " << frequenttreenumbers.size () << endl;
+        for (unsigned int i = 0; i < frequenttreenumbers.size (); i++ )
+          os << frequentgraphnumbers[i] << " " << frequenttreenumbers[i] << " " << frequentpathnumbers[i] << endl;
+        os << roots.size () << endl;
+        for (unsigned int i = 0; i < roots.size (); i++ ) {
+          os << roots[i].root << " " << roots[i].label << " " << roots[i].levels.size ();
+          for (unsigned int d = 0; d < roots[i].levels.size (); d++ ) {
+            BbrcLevelStatistics &l = roots[i].levels[d];
+            os << " " << l.generated << " " << l.minfreq << " " << l.static_ub << " " << l.dynamic_ub << " " << l.singles << " " << l.not_normal << " " << l.representatives;
+          }
+          os << endl;
+        }
+    }
+    //! Reads the counters written by save(), false if they are incomplete.
+    bool load ( istream &is ) {
+        unsigned int n = 0;
+        is >> nodes >> occurrence_peak >> n;
+        frequenttreenumbers.resize ( n ); frequentpathnumbers.resize ( n ); frequentgraphnumbers.resize ( n );
+        for (unsigned int i = 0; i < n && is; i++ )
+          is >> frequentgraphnumbers[i] >> frequenttreenumbers[i] >> frequentpathnumbers[i];
+        is >> n;
+        roots.clear ();
+        for (unsigned int i = 0; i < n && is; i++ ) {
+          int root = 0, label = 0;
+          unsigned int levels = 0;
+          is >> root >> label >> levels;
+          roots.push_back ( BbrcRootStatistics ( root, label ) );
+          roots.back ().levels.resize ( levels );
+          for (unsigned int d = 0; d < levels && is; d++ ) {
+            BbrcLevelStatistics &l = roots.back ().levels[d];
+            is >> l.generated >> l.minfreq >> l.static_ub >> l.dynamic_ub >> l.singles >> l.not_normal >> l.representatives;
+          }
+        }
+        last_nodes = nodes;
+        return !is.fail ();
+    }
+  private:
+    double start, root_start, last_report;
+    unsigned long last_nodes;
+    bool over_budget;
+    template <typename LegPtr, typename CloseLegPtr>
+    static unsigned long held ( vector<LegPtr> &legs, vector<CloseLegPtr> &closelegs, bool compact ) {
+        unsigned long bytes = 0;
+        for (unsigned int i = 0; i < legs.size (); i++ ) bytes += held ( legs[i]->occurrences.elements, compact );
+        for (unsigned int i = 0; i < closelegs.size (); i++ ) bytes += held ( closelegs[i]->occurrences.elements, compact );
+        return bytes;
+    }
+    //! Capacity of an occurrence list in bytes; with 'compact', capacity left over by store() is released first.
+    template <typename T>
+    static unsigned long held ( vector<T> &elements, bool compact ) {
+        if ( compact && elements.capacity () > elements.size () ) vector<T> ( elements ).swap ( elements );
+        return elements.capacity () * sizeof ( T );
+    }
+    static double now () {
+        struct timeval tv;
+        gettimeofday ( &tv, NULL );
+        return tv.tv_sec + tv.tv_usec / 1.0e6;
+    }
+    //! Resident memory in kB, 0 where /proc is not available.
+    static unsigned long rss () {
+        unsigned long size = 0, resident = 0;
+        ifstream statm ( "/proc/self/statm" );
+        statm >> size >> resident;
+        return resident * ( sysconf ( _SC_PAGESIZE ) / 1024 );
+    }
 };
 
 
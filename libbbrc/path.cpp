@@ -23,6 +23,8 @@
 #include "patterntree.h"
 #include "path.h"
 #include "graphstate.h"
+#include "lattice.h"
+#include "checkpoint.h"
 #include <iomanip>
 #include "misc.h"
 
@@ -31,22 +33,158 @@ namespace fm {
     extern bool bbrc_adjust_ub;
     extern bool bbrc_do_pruning;
     extern bool bbrc_do_backbone;
-    extern bool bbrc_updated;
     extern int bbrc_type;
     extern bool bbrc_console_out;
     extern bool bbrc_refine_singles;
     extern bool bbrc_do_output;
     extern bool bbrc_bbrc_sep;
     extern bool bbrc_regression;
+    extern int bbrc_progress;
+    extern unsigned long bbrc_memory_budget;
 
     extern BbrcDatabase* bbrc_database;
     extern ChisqBbrcConstraint* bbrc_chisq;
     extern KSBbrcConstraint* bbrc_ks;
     extern vector<string>* bbrc_result;
+    extern vector<BbrcEndpoint> bbrc_endpoints;
     extern BbrcStatistics* bbrc_statistics;
     extern BbrcGraphState* bbrc_graphstate;
+    extern BbrcLattice* bbrc_lattice;
+    extern BbrcCheckpoint* bbrc_checkpoint;
+    extern int bbrc_unit;
 
     extern vector<BbrcLegOccurrences> bbrc_Bbrccandidatelegsoccurrences; 
+    extern vector<BbrcEdgeLabel> bbrc_candidatelabels;
+    extern BbrcLegPool<BbrcPathBbrcLeg> bbrc_pathlegpool;
+    extern BbrcLegPool<BbrcCloseBbrcLeg> bbrc_closelegpool;
+    extern vector<BbrcSiblingJoin> bbrc_siblingjoins;
+}
+
+// Makes the constraints and the result of an endpoint the current ones, for Calc() and output.
+void bbrcSelect ( unsigned int endpoint ) {
+  fm::bbrc_chisq = fm::bbrc_endpoints[endpoint].chisq;
+  fm::bbrc_ks = fm::bbrc_endpoints[endpoint].ks;
+  fm::bbrc_result = fm::bbrc_endpoints[endpoint].result;
+}
+
+// Whether the leg of the last Calc() is supported by minfreq compounds of the selected endpoint.
+// Only further endpoints can miss compounds (e.g. the test part of a fold), the first has them all.
+bool bbrcFrequent () {
+  if ( fm::bbrc_regression ) return fm::bbrc_ks->activities.empty () || fm::bbrc_ks->f >= fm::bbrc_minfreq;
+  return fm::bbrc_chisq->activities.empty () || fm::bbrc_chisq->f >= fm::bbrc_minfreq;
+}
+
+// Support of the leg for the selected endpoint, for output: the compounds of a further endpoint
+// (e.g. the training part of a fold) supporting it in the last Calc().
+unsigned int bbrcSupport ( BbrcLegOccurrences &legoccurrences ) {
+  if ( !fm::bbrc_chisq->active ) return legoccurrences.frequency;
+  if ( fm::bbrc_regression ) return fm::bbrc_ks->activities.empty () ? legoccurrences.frequency : fm::bbrc_ks->f;
+  return fm::bbrc_chisq->activities.empty () ? legoccurrences.frequency : fm::bbrc_chisq->f;
+}
+
+// Evaluates the leg just inserted into the graphstate for each endpoint open in max: statistics,
+// immediate output and upper bound. The endpoints that stay open (grow: frequent enough to refine)
+// get their max for the branch below the leg in child, the others output their representative.
+// Returns whether the branch is grown.
+bool bbrcEvaluate ( BbrcLegOccurrences &legoccurrences, const BbrcMax &max, bool grow, BbrcMax &child ) {
+  bool open = false, ub_any = false, below = true;
+  for ( unsigned int e = 0; e < fm::bbrc_endpoints.size (); e++ ) {
+    if ( !max.open[e] ) continue;
+    if ( fm::bbrc_endpoints.size () > 1 ) bbrcSelect ( e );
+    BbrcEndpoint &endpoint = fm::bbrc_endpoints[e];
+
+    // Calculate chisq
+    if (fm::bbrc_chisq->active) { 
+        if (!fm::bbrc_regression) fm::bbrc_chisq->Calc(legoccurrences);
+        else fm::bbrc_ks->Calc(legoccurrences);
+    }
+    bool frequent = bbrcFrequent ();
+
+    // immediate output
+    if (fm::bbrc_do_output && !fm::bbrc_do_backbone && frequent) {
+        if (!fm::bbrc_console_out) (*fm::bbrc_result) << fm::bbrc_graphstate->to_s(bbrcSupport(legoccurrences));
+        else fm::bbrc_graphstate->print(bbrcSupport(legoccurrences));
+    }
+
+    float cmax = maxi ( maxi ( fm::bbrc_chisq->sig, max.best[e].first ), fm::bbrc_chisq->p );
+    bool ub_ok = frequent && ( !fm::bbrc_do_pruning || ( !fm::bbrc_adjust_ub && fm::bbrc_chisq->u >= fm::bbrc_chisq->sig ) || ( fm::bbrc_adjust_ub && fm::bbrc_chisq->u >= cmax ) );
+    ub_any = ub_any || ub_ok;
+    below = below && fm::bbrc_chisq->u < fm::bbrc_chisq->sig;
+    if ( ub_ok && grow ) {   // UB-PRUNING
+      if ( !open ) {
+        child.best = max.best;
+        child.open.assign ( max.open.size (), false );
+        open = true;
+      }
+      child.open[e] = true;
+      float p = fm::bbrc_regression ? fm::bbrc_ks->p : fm::bbrc_chisq->p;
+      if ( max.best[e].first < p ) {
+        endpoint.updated = true;
+        child.best[e] = pair<float, string> ( p, fm::bbrc_graphstate->to_s ( bbrcSupport ( legoccurrences ) ) );
+      }
+    }
+    else if ( fm::bbrc_do_backbone && endpoint.updated ) { // FREE STRUCTURES: search was pruned
+        if (fm::bbrc_do_output) {
+            if (!fm::bbrc_console_out) (*fm::bbrc_result) << max.best[e].second;
+            else cout << max.best[e].second;
+        }
+        fm::bbrc_statistics->representative ( max.best[e].second );
+        endpoint.updated = false;
+    }
+  }
+  if ( fm::bbrc_endpoints.size () > 1 ) bbrcSelect ( 0 );
+  if ( !open ) fm::bbrc_statistics->prune ( ub_any, below );
+  return open;
+}
+
+// Evaluates a leg of the top level for each endpoint: statistics and immediate output. The top
+// level is not pruned, child gets the max of the branch below the leg for the endpoints it is
+// frequent for.
+void bbrcEvaluateTop ( BbrcLegOccurrences &legoccurrences, BbrcMax &child ) {
+  for ( unsigned int e = 0; e < fm::bbrc_endpoints.size (); e++ ) {
+    if ( fm::bbrc_endpoints.size () > 1 ) bbrcSelect ( e );
+
+    if (fm::bbrc_chisq->active) { 
+      if (!fm::bbrc_regression) fm::bbrc_chisq->Calc(legoccurrences);
+      else fm::bbrc_ks->Calc(legoccurrences);
+    }
+
+    bool frequent = bbrcFrequent ();
+
+    // OUTPUT
+    if (fm::bbrc_do_output && !fm::bbrc_do_backbone && legoccurrences.frequency>=fm::bbrc_minfreq && frequent) { 
+        if (!fm::bbrc_console_out) (*fm::bbrc_result) << fm::bbrc_graphstate->to_s(bbrcSupport(legoccurrences));
+        else fm::bbrc_graphstate->print(bbrcSupport(legoccurrences));
+    }
+
+    fm::bbrc_endpoints[e].updated = frequent;
+    child.best.push_back ( pair<float, string>(fm::bbrc_chisq->p, frequent ? fm::bbrc_graphstate->to_s(bbrcSupport(legoccurrences)) : "") );
+    child.open.push_back ( frequent );
+  }
+  if ( fm::bbrc_endpoints.size () > 1 ) bbrcSelect ( 0 );
+}
+
+// At a leaf, the open endpoints output their representative if it changed.
+void bbrcRepresentatives ( const BbrcMax &max ) {
+  for ( unsigned int e = 0; e < fm::bbrc_endpoints.size (); e++ ) {
+    BbrcEndpoint &endpoint = fm::bbrc_endpoints[e];
+    if ( !max.open[e] || !endpoint.updated ) continue;
+    if (fm::bbrc_do_output) {
+        if (!fm::bbrc_console_out) (*endpoint.result) << max.best[e].second; 
+        else cout << max.best[e].second;
+    }
+    fm::bbrc_statistics->representative ( max.best[e].second );
+    endpoint.updated = false;
+  }
+}
+
+// Separates the fragments output since the last separator (BBRC separator, see Bbrc::SetBbrcSep).
+void bbrcSeparate () {
+  if ( !fm::bbrc_do_output || fm::bbrc_console_out ) return;
+  for ( unsigned int e = 0; e < fm::bbrc_endpoints.size (); e++ ) {
+    vector<string>* result = fm::bbrc_endpoints[e].result;
+    if ( result->size () && ( result->back () != fm::bbrc_graphstate->sep () ) ) (*result) << fm::bbrc_graphstate->sep ();
+  }
 }
 
 // for every database node...
@@ -78,7 +216,7 @@ BbrcPath::BbrcPath ( BbrcNodeLabel startnodelabel ) {
         j++;
     
         // ...CREATE LEGS
-        BbrcPathBbrcLegPtr leg = new BbrcPathBbrcLeg;
+        BbrcPathBbrcLegPtr leg = fm::bbrc_pathlegpool.get ( *fm::bbrc_statistics );
         legs.push_back ( leg );
 
         leg->tuple.depth = 0;                                           // TUPLE  DESCRIBES STRUCTURE...
@@ -89,6 +227,7 @@ BbrcPath::BbrcPath ( BbrcNodeLabel startnodelabel ) {
         leg->occurrences.number = 2;
         leg->occurrences.maxdegree = 0;
         leg->occurrences.selfjoin = 0;
+        leg->occurrences.tidhash = BBRC_TIDHASH_SEED;
 
         BbrcDatabaseBbrcEdgeLabel &databaseedgelabel = fm::bbrc_database->edgelabels[fm::bbrc_database->edgelabelsindexes[frequentedgelabels[i]]];
         leg->occurrences.frequency = databaseedgelabel.frequency;
@@ -102,6 +241,7 @@ BbrcPath::BbrcPath ( BbrcNodeLabel startnodelabel ) {
         }
 
         lastself[i] = NOTID;
+        fm::bbrc_statistics->level ().generated++;
 
    }
     
@@ -118,6 +258,8 @@ BbrcPath::BbrcPath ( BbrcNodeLabel startnodelabel ) {
                 leg.occurrences.selfjoin++;
                 lastself[edgelabel] = tree.tid;
             }
+            if ( leg.occurrences.elements.empty () || leg.occurrences.elements.back ().tid != tree.tid )
+                leg.occurrences.tidhash = bbrc_tidhash ( leg.occurrences.tidhash, tree.tid );
             vector_push_back ( BbrcLegOccurrence, leg.occurrences.elements, legoccurrence );
             legoccurrence.tid = tree.tid;
             legoccurrence.occurrenceid = i;
@@ -200,9 +342,11 @@ BbrcPath::BbrcPath ( BbrcPath &parentpath, unsigned int legindex ) {
 
     // build OccurrenceLists
     bbrc_extend ( leg.occurrences );
-    for (unsigned int i = 0; i < fm::bbrc_Bbrccandidatelegsoccurrences.size (); i++ ) {
+    for ( unsigned int k = 0; k < fm::bbrc_candidatelabels.size (); k++ ) {
+      BbrcEdgeLabel i = fm::bbrc_candidatelabels[k];
+      fm::bbrc_statistics->candidate ( fm::bbrc_Bbrccandidatelegsoccurrences[i].frequency, fm::bbrc_minfreq );
       if ( fm::bbrc_Bbrccandidatelegsoccurrences[i].frequency >= fm::bbrc_minfreq ) {
-        BbrcPathBbrcLegPtr leg2 = new BbrcPathBbrcLeg;
+        BbrcPathBbrcLegPtr leg2 = fm::bbrc_pathlegpool.get ( *fm::bbrc_statistics );
         legs.push_back ( leg2 );
         leg2->tuple.edgelabel = i;
     	leg2->tuple.connectingnode = fm::bbrc_graphstate->lastNode ();
@@ -269,11 +413,12 @@ BbrcPath::BbrcPath ( BbrcPath &parentpath, unsigned int legindex ) {
 
   unsigned int i = 0;
   BbrcLegOccurrencesPtr legoccurrencesptr;
+  unsigned long joinbytes = bbrc_join_siblings ( leg.occurrences, parentpath.legs, 0, fm::bbrc_siblingjoins );
   for ( ; i < legindex; i++ ) {
     BbrcPathBbrcLeg &leg2 = (*parentpath.legs[i]);
 
-    if ( (legoccurrencesptr = bbrc_join ( leg.occurrences, leg2.tuple.connectingnode, leg2.occurrences )) ) { // JOIN OCCURRENCES
-      BbrcPathBbrcLegPtr leg3 = new BbrcPathBbrcLeg;
+    if ( (legoccurrencesptr = bbrc_join ( leg.occurrences, fm::bbrc_siblingjoins[i] )) ) { // JOIN OCCURRENCES
+      BbrcPathBbrcLegPtr leg3 = fm::bbrc_pathlegpool.get ( *fm::bbrc_statistics );
       legs.push_back ( leg3 );
       leg3->tuple.connectingnode = leg2.tuple.connectingnode;
       leg3->tuple.edgelabel = leg2.tuple.edgelabel;
@@ -284,7 +429,7 @@ BbrcPath::BbrcPath ( BbrcPath &parentpath, unsigned int legindex ) {
   }
 
   if ( (legoccurrencesptr = bbrc_join ( leg.occurrences )) ) {
-    BbrcPathBbrcLegPtr leg3 = new BbrcPathBbrcLeg;
+    BbrcPathBbrcLegPtr leg3 = fm::bbrc_pathlegpool.get ( *fm::bbrc_statistics );
     legs.push_back ( leg3 );
     leg3->tuple.connectingnode = leg.tuple.connectingnode;
     leg3->tuple.edgelabel = leg.tuple.edgelabel;
@@ -295,8 +440,8 @@ BbrcPath::BbrcPath ( BbrcPath &parentpath, unsigned int legindex ) {
 
   for ( i++; i < parentpath.legs.size (); i++ ) {
     BbrcPathBbrcLeg &leg2 = (*parentpath.legs[i]);
-    if ( (legoccurrencesptr = bbrc_join ( leg.occurrences, leg2.tuple.connectingnode, leg2.occurrences )) ) {
-      BbrcPathBbrcLegPtr leg3 = new BbrcPathBbrcLeg;
+    if ( (legoccurrencesptr = bbrc_join ( leg.occurrences, fm::bbrc_siblingjoins[i] )) ) {
+      BbrcPathBbrcLegPtr leg3 = fm::bbrc_pathlegpool.get ( *fm::bbrc_statistics );
       legs.push_back ( leg3 );
       leg3->tuple.connectingnode = leg2.tuple.connectingnode;
       leg3->tuple.edgelabel = leg2.tuple.edgelabel;
@@ -305,6 +450,7 @@ BbrcPath::BbrcPath ( BbrcPath &parentpath, unsigned int legindex ) {
       store ( leg3->occurrences, *legoccurrencesptr );
     }
   }
+  bbrc_free_siblings ( fm::bbrc_siblingjoins, 0, parentpath.legs.size (), joinbytes );
 
   if ( positionshift ) {
     BbrcaddCloseExtensions ( closelegs, leg.occurrences.number ); // stored separately
@@ -312,9 +458,11 @@ BbrcPath::BbrcPath ( BbrcPath &parentpath, unsigned int legindex ) {
   }
 
   bbrc_extend ( leg.occurrences );
-  for ( unsigned int i = 0; i < fm::bbrc_Bbrccandidatelegsoccurrences.size (); i++ ) {
+  for ( unsigned int k = 0; k < fm::bbrc_candidatelabels.size (); k++ ) {
+    BbrcEdgeLabel i = fm::bbrc_candidatelabels[k];
+    fm::bbrc_statistics->candidate ( fm::bbrc_Bbrccandidatelegsoccurrences[i].frequency, fm::bbrc_minfreq );
     if ( fm::bbrc_Bbrccandidatelegsoccurrences[i].frequency >= fm::bbrc_minfreq ) {
-      BbrcPathBbrcLegPtr leg2 = new BbrcPathBbrcLeg;
+      BbrcPathBbrcLegPtr leg2 = fm::bbrc_pathlegpool.get ( *fm::bbrc_statistics );
       legs.push_back ( leg2 );
       leg2->tuple.edgelabel = i;
       leg2->tuple.connectingnode = fm::bbrc_graphstate->lastNode ();
@@ -331,11 +479,25 @@ BbrcPath::BbrcPath ( BbrcPath &parentpath, unsigned int legindex ) {
   BbrcaddCloseExtensions ( closelegs, leg.occurrences.number );
 }
 
-BbrcPath::~BbrcPath () {
+// The children of a path join with all legs of their parent, so the legs are only
+// compressed while the subtree below legindex is searched.
+bool BbrcPath::pack ( unsigned int legindex ) {
+  if ( !fm::bbrc_statistics->exceeds ( fm::bbrc_memory_budget ) )
+    return false;
   for ( unsigned int i = 0; i < legs.size (); i++ )
-    delete legs[i];
-  for ( unsigned int i = 0; i < closelegs.size (); i++ )
-    delete closelegs[i];
+    if ( i != legindex )
+      bbrc_pack ( legs[i]->occurrences );
+  return true;
+}
+
+void BbrcPath::unpack () {
+  for ( unsigned int i = 0; i < legs.size (); i++ )
+    bbrc_unpack ( legs[i]->occurrences );
+}
+
+BbrcPath::~BbrcPath () {
+  fm::bbrc_pathlegpool.put ( legs, *fm::bbrc_statistics, fm::bbrc_memory_budget );
+  fm::bbrc_closelegpool.put ( closelegs, *fm::bbrc_statistics, fm::bbrc_memory_budget );
 }
 
 // ADDED
@@ -424,9 +586,10 @@ bool BbrcPath::is_normal ( BbrcEdgeLabel edgelabel ) {
 
 
 
-void BbrcPath::expand2 (pair<float,string> max) {
+void BbrcPath::expand2 (const BbrcMax &max) {
 
   fm::bbrc_statistics->patternsize++;
+  fm::bbrc_statistics->node ( fm::bbrc_progress );
   if ( (unsigned) fm::bbrc_statistics->patternsize > fm::bbrc_statistics->frequenttreenumbers.size () ) {
     fm::bbrc_statistics->frequenttreenumbers.push_back ( 0 );
     fm::bbrc_statistics->frequentpathnumbers.push_back ( 0 );
@@ -438,6 +601,12 @@ void BbrcPath::expand2 (pair<float,string> max) {
     fm::bbrc_statistics->patternsize--;
     return;
   }
+  unsigned long bytes = fm::bbrc_statistics->hold ( legs, closelegs, fm::bbrc_memory_budget );
+  if ( fm::bbrc_lattice ) {
+    BbrcFrequency maxleg = 0;
+    for ( unsigned int i = 0; i < legs.size (); i++ ) maxleg = std::max ( maxleg, legs[i]->occurrences.frequency );
+    fm::bbrc_lattice->enter ( maxleg );
+  }
 
   vector<unsigned int> forwpathlegs; forwpathlegs.clear();
   vector<unsigned int> backwpathlegs; backwpathlegs.clear();
@@ -458,6 +627,7 @@ void BbrcPath::expand2 (pair<float,string> max) {
         pathlegs.push_back(i);
 
       }
+      else fm::bbrc_statistics->level ().not_normal++;
     }
   }
 
@@ -477,82 +647,38 @@ void BbrcPath::expand2 (pair<float,string> max) {
             backwpathlegs.push_back(i);
             pathlegs.push_back(i);
         }
+        else fm::bbrc_statistics->level ().not_normal++;
       }
     }
   }
  
 
   // we have reached a leaf
-  if (fm::bbrc_do_backbone && (pathlegs.size()==0)) { 
-     if (fm::bbrc_updated) { 
-        if (fm::bbrc_do_output) {
-            if (!fm::bbrc_console_out) { 
-                (*fm::bbrc_result) << max.second; 
-            }
-            else cout << max.second;
-        }
-        fm::bbrc_updated = false;
-     }
-  }
+  if (fm::bbrc_do_backbone && (pathlegs.size()==0)) bbrcRepresentatives ( max );
 
   
   
   
   // Grow BbrcPath forw
+  // The dynamic upper bound only tightens along the branch (max is passed down), so the
+  // order of the legs does not change the search. It does decide which representatives
+  // are output (bbrc_updated), hence legs stay in canonical order.
   for (unsigned int j=0; j<forwpathlegs.size() ; j++ ) {
     unsigned int index = forwpathlegs[j];
 
 
-    // Calculate chisq
-     if (fm::bbrc_chisq->active) { 
-        if (!fm::bbrc_regression) fm::bbrc_chisq->Calc(legs[index]->occurrences.elements);
-        else fm::bbrc_ks->Calc(legs[index]->occurrences.elements);
-      }
-          
     // GRAPHSTATE AND OUTPUT
     fm::bbrc_graphstate->insertNode ( legs[index]->tuple.connectingnode, legs[index]->tuple.edgelabel, legs[index]->occurrences.maxdegree );
+    if ( fm::bbrc_lattice ) fm::bbrc_lattice->add ( BBRC_LATTICE_PATH, legs[index]->tuple.connectingnode, legs[index]->tuple.edgelabel, legs[index]->occurrences );
 
 
-    // immediate output
-    if (fm::bbrc_do_output && !fm::bbrc_do_backbone) {
-        if (!fm::bbrc_console_out) (*fm::bbrc_result) << fm::bbrc_graphstate->to_s(legs[index]->occurrences.frequency);
-        else fm::bbrc_graphstate->print(legs[index]->occurrences.frequency);
-    }
-
-
-    // RECURSE
-    float cmax = maxi ( maxi ( fm::bbrc_chisq->sig, max.first ), fm::bbrc_chisq->p );
-    if ( (
-             !fm::bbrc_do_pruning || 
-             (
-               (  !fm::bbrc_adjust_ub && (fm::bbrc_chisq->u >= fm::bbrc_chisq->sig) ) || 
-               (   fm::bbrc_adjust_ub && (fm::bbrc_chisq->u >= cmax) )
-             )
-         ) 
-            &&
-         (
-            fm::bbrc_refine_singles || (legs[index]->occurrences.frequency>1)
-         )
-      ){   // UB-PRUNING
-
+    // STATISTICS, OUTPUT AND RECURSE
+    BbrcMax child;
+    if ( bbrcEvaluate ( legs[index]->occurrences, max, fm::bbrc_refine_singles || (legs[index]->occurrences.frequency>1), child ) ) {   // UB-PRUNING
       BbrcPath path ( *this, index );
-      if (!fm::bbrc_regression) {
-          if (max.first<fm::bbrc_chisq->p) { fm::bbrc_updated = true; path.expand2 ( pair<float, string>(fm::bbrc_chisq->p, fm::bbrc_graphstate->to_s(legs[index]->occurrences.frequency))); }
-          else path.expand2 (max);
-      }
-      else {
-          if (max.first<fm::bbrc_ks->p) { fm::bbrc_updated = true; path.expand2 ( pair<float, string>(fm::bbrc_ks->p, fm::bbrc_graphstate->to_s(legs[index]->occurrences.frequency))); }
-          else path.expand2 (max);
-      }
-    }
-    else {
-        if (fm::bbrc_do_backbone && fm::bbrc_updated) {  // FREE STRUCTURES: search was pruned
-            if (fm::bbrc_do_output) {
-                if (!fm::bbrc_console_out) (*fm::bbrc_result) << max.second;
-                else cout << max.second;
-            }
-            fm::bbrc_updated=false;
-        }
+      bool packed = pack ( index );
+      path.expand2 ( child );
+      if ( packed ) unpack ();
     }
 
     fm::bbrc_graphstate->deleteNode ();
@@ -563,71 +689,31 @@ void BbrcPath::expand2 (pair<float,string> max) {
   // Grow BbrcPath backw
   for (unsigned int j=0; j<backwpathlegs.size() ; j++ ) {
     unsigned int index = backwpathlegs[j];
-    
-
-    // Calculate chisq
-    if (fm::bbrc_chisq->active) { 
-        if (!fm::bbrc_regression) fm::bbrc_chisq->Calc(legs[index]->occurrences.elements);
-        else fm::bbrc_ks->Calc(legs[index]->occurrences.elements);
-    }
 
 
     // GRAPHSTATE AND OUTPUT
     fm::bbrc_graphstate->insertNode ( legs[index]->tuple.connectingnode, legs[index]->tuple.edgelabel, legs[index]->occurrences.maxdegree );
+    if ( fm::bbrc_lattice ) fm::bbrc_lattice->add ( BBRC_LATTICE_PATH, legs[index]->tuple.connectingnode, legs[index]->tuple.edgelabel, legs[index]->occurrences );
 
-    // immediate output
-    if (fm::bbrc_do_output && !fm::bbrc_do_backbone) {
-        if (!fm::bbrc_console_out) (*fm::bbrc_result) << fm::bbrc_graphstate->to_s(legs[index]->occurrences.frequency);
-        else fm::bbrc_graphstate->print(legs[index]->occurrences.frequency);
-    }
-
-    // RECURSE
-    float cmax = maxi ( maxi ( fm::bbrc_chisq->sig, max.first ), fm::bbrc_chisq->p );
-    if ( ( 
-             !fm::bbrc_do_pruning || 
-             (
-               (  !fm::bbrc_adjust_ub && (fm::bbrc_chisq->u >= fm::bbrc_chisq->sig) ) || 
-               (   fm::bbrc_adjust_ub && (fm::bbrc_chisq->u >= cmax) )
-             )
-         ) 
-            &&
-         (
-            fm::bbrc_refine_singles || (legs[index]->occurrences.frequency>1)
-         )
-     ){   // UB-PRUNING
 
+    // STATISTICS, OUTPUT AND RECURSE
+    BbrcMax child;
+    if ( bbrcEvaluate ( legs[index]->occurrences, max, fm::bbrc_refine_singles || (legs[index]->occurrences.frequency>1), child ) ) {   // UB-PRUNING
       BbrcPath path ( *this, index );
-      if (!fm::bbrc_regression) {
-          if (max.first<fm::bbrc_chisq->p) { fm::bbrc_updated = true; path.expand2 ( pair<float, string>(fm::bbrc_chisq->p, fm::bbrc_graphstate->to_s(legs[index]->occurrences.frequency))); }
-          else path.expand2 (max);
-      }
-      else {
-          if (max.first<fm::bbrc_ks->p) { fm::bbrc_updated = true; path.expand2 ( pair<float, string>(fm::bbrc_ks->p, fm::bbrc_graphstate->to_s(legs[index]->occurrences.frequency))); }
-          else path.expand2 (max);
-      }
-    }
-    else {
-        if (fm::bbrc_do_backbone && fm::bbrc_updated) { // FREE STRUCTURES: search was pruned
-            if (fm::bbrc_do_output) {
-                if (!fm::bbrc_console_out) (*fm::bbrc_result) << max.second;
-                else if (fm::bbrc_do_output) cout << max.second;
-            }
-            fm::bbrc_updated=false;
-        }
+      bool packed = pack ( index );
+      path.expand2 ( child );
+      if ( packed ) unpack ();
     }
 
     fm::bbrc_graphstate->deleteNode ();
-
   }
 
 
 
-  bool uptmp = fm::bbrc_updated;
+  vector<bool> uptmp;
+  for ( unsigned int e = 0; e < fm::bbrc_endpoints.size (); e++ ) uptmp.push_back ( fm::bbrc_endpoints[e].updated );
 
-  if (fm::bbrc_bbrc_sep && !fm::bbrc_do_backbone && legs.size() > 0) {
-      if (fm::bbrc_do_output && !fm::bbrc_console_out && fm::bbrc_result->size() && (fm::bbrc_result->back()!=fm::bbrc_graphstate->sep())) (*fm::bbrc_result) << fm::bbrc_graphstate->sep();
-      //else cout << fm::bbrc_graphstate->sep() << endl;
-  }
+  if (fm::bbrc_bbrc_sep && !fm::bbrc_do_backbone && legs.size() > 0) bbrcSeparate ();
 
   for ( unsigned int i = 0; i < legs.size (); i++ ) {
     BbrcPathBbrcTuple &tuple = legs[i]->tuple;
@@ -640,69 +726,32 @@ void BbrcPath::expand2 (pair<float,string> max) {
  	      ( legs[i]->tuple.depth != 1 || legs[i]->tuple.edgelabel >= edgelabels[0] ) &&
 	      ( legs[i]->tuple.depth != nodelabels.size () - 2 || legs[i]->tuple.edgelabel >= edgelabels.back () ) &&
 	        fm::bbrc_type > 1 ) {
-          // Calculate chisq
-          if (fm::bbrc_chisq->active) { 
-            if (!fm::bbrc_regression) fm::bbrc_chisq->Calc(legs[i]->occurrences.elements);
-            else fm::bbrc_ks->Calc(legs[i]->occurrences.elements);
-          }
-
 
           // GRAPHSTATE
           fm::bbrc_graphstate->insertNode ( legs[i]->tuple.connectingnode, legs[i]->tuple.edgelabel, legs[i]->occurrences.maxdegree );
+          if ( fm::bbrc_lattice ) fm::bbrc_lattice->add ( BBRC_LATTICE_TREE, legs[i]->tuple.connectingnode, legs[i]->tuple.edgelabel, legs[i]->occurrences );
 
-          // immediate output
-          if (fm::bbrc_do_output && !fm::bbrc_do_backbone) {
-             if (!fm::bbrc_console_out) (*fm::bbrc_result) << fm::bbrc_graphstate->to_s(legs[i]->occurrences.frequency);
-             else fm::bbrc_graphstate->print(legs[i]->occurrences.frequency);
-          }
-
-          // RECURSE
-          float cmax = maxi ( maxi ( fm::bbrc_chisq->sig, max.first ), fm::bbrc_chisq->p );
-
-          if ( ( !fm::bbrc_do_pruning || 
-               (
-                 (  !fm::bbrc_adjust_ub && (fm::bbrc_chisq->u >= fm::bbrc_chisq->sig) ) || 
-                 (   fm::bbrc_adjust_ub && (fm::bbrc_chisq->u >= cmax) )
-               )
-             ) &&
-             (
-                fm::bbrc_refine_singles || (legs[i]->occurrences.frequency>1)
-             )
-    
-          ){   // UB-PRUNING
-
+          // STATISTICS, OUTPUT AND RECURSE
+          BbrcMax child;
+          if ( bbrcEvaluate ( legs[i]->occurrences, max, fm::bbrc_refine_singles || (legs[i]->occurrences.frequency>1), child ) ) {   // UB-PRUNING
             BbrcPatternTree tree ( *this, i );
-
-            if (!fm::bbrc_regression) {
-                if (max.first<fm::bbrc_chisq->p) { fm::bbrc_updated = true; tree.expand ( pair<float, string>(fm::bbrc_chisq->p, fm::bbrc_graphstate->to_s(legs[i]->occurrences.frequency))); }
-                else tree.expand (max);
-            }
-            else {
-                if (max.first<fm::bbrc_ks->p) { fm::bbrc_updated = true; tree.expand ( pair<float, string>(fm::bbrc_ks->p, fm::bbrc_graphstate->to_s(legs[i]->occurrences.frequency))); }
-                else tree.expand (max);
-            }
-
-          }
-
-          else {
-            if (fm::bbrc_do_backbone && fm::bbrc_updated) { 
-              if (fm::bbrc_do_output) {
-                  if (!fm::bbrc_console_out) (*fm::bbrc_result) << max.second;
-                  else  cout << max.second;
-              }
-              fm::bbrc_updated=false;
-            }
+            bool packed = pack ( i );
+            tree.expand ( child );
+            if ( packed ) unpack ();
           }
 
 	      fm::bbrc_graphstate->deleteNode ();
         }
+        else if ( fm::bbrc_type > 1 ) fm::bbrc_statistics->level ().not_normal++;
       }
     }
   }
 
 
-  fm::bbrc_updated=uptmp;
+  for ( unsigned int e = 0; e < fm::bbrc_endpoints.size (); e++ ) fm::bbrc_endpoints[e].updated = uptmp[e];
     
+  if ( fm::bbrc_lattice ) fm::bbrc_lattice->leave ();
+  fm::bbrc_statistics->release ( bytes );
   fm::bbrc_statistics->patternsize--;
 
 
@@ -717,31 +766,38 @@ void BbrcPath::expand2 (pair<float,string> max) {
 
 
 void BbrcPath::expand () {
+  unsigned long bytes = fm::bbrc_statistics->hold ( legs, closelegs, fm::bbrc_memory_budget );
+
+  for ( unsigned int i = 0; i < legs.size (); i++ )
+    if ( legs[i]->tuple.nodelabel >= nodelabels[0] ) fm::bbrc_statistics->top_legs++;
 
   for ( unsigned int i = 0; i < legs.size (); i++ ) {
+    if ( fm::bbrc_unit != NOLEG && (int) i != fm::bbrc_unit ) continue; // another unit
     BbrcPathBbrcTuple &tuple = legs[i]->tuple;
     if ( tuple.nodelabel >= nodelabels[0] ) {
-        
-      if (fm::bbrc_chisq->active) { 
-        if (!fm::bbrc_regression) fm::bbrc_chisq->Calc(legs[i]->occurrences.elements);
-        else fm::bbrc_ks->Calc(legs[i]->occurrences.elements);
-      }
+      if ( fm::bbrc_checkpoint && fm::bbrc_checkpoint->skip ( i ) ) { fm::bbrc_statistics->top_done++; continue; } // mined before the checkpoint
 
-      // GRAPHSTATE AND OUTPUT
+      // GRAPHSTATE
       fm::bbrc_graphstate->insertNode ( tuple.connectingnode, tuple.edgelabel, legs[i]->occurrences.maxdegree );
-      if (fm::bbrc_do_output && !fm::bbrc_do_backbone && legs[i]->occurrences.frequency>=fm::bbrc_minfreq) { 
-          if (!fm::bbrc_console_out) (*fm::bbrc_result) << fm::bbrc_graphstate->to_s(legs[i]->occurrences.frequency);
-          else fm::bbrc_graphstate->print(legs[i]->occurrences.frequency);
-      }
+
+      if ( fm::bbrc_lattice ) fm::bbrc_lattice->add ( BBRC_LATTICE_PATH, tuple.connectingnode, tuple.edgelabel, legs[i]->occurrences );
+
+      BbrcMax child;
+      bbrcEvaluateTop ( legs[i]->occurrences, child );
 
       // RECURSE
       BbrcPath path (*this, i);
-      fm::bbrc_updated = true;
-      path.expand2 (pair<float, string>(fm::bbrc_chisq->p, fm::bbrc_graphstate->to_s(legs[i]->occurrences.frequency)));
+      bool packed = pack ( i );
+      path.expand2 ( child );
+      if ( packed ) unpack ();
+      fm::bbrc_statistics->top_done++;
       fm::bbrc_graphstate->deleteNode ();
+      if ( fm::bbrc_checkpoint ) fm::bbrc_checkpoint->leg ( i );
 
     }
+    else if ( !fm::bbrc_checkpoint || !fm::bbrc_checkpoint->skip ( i ) ) fm::bbrc_statistics->level ().not_normal++;
   }
+  fm::bbrc_statistics->release ( bytes );
   fm::bbrc_graphstate->deleteStartNode ();
 
 
@@ -753,6 +809,13 @@ void BbrcPath::expand () {
 
 
 
+// Units of work, see Bbrc::GetUnits: occurrences of each top-level leg expand () mines.
+void BbrcPath::units ( vector<unsigned long> &sizes ) {
+  for ( unsigned int i = 0; i < legs.size (); i++ )
+    sizes.push_back ( legs[i]->tuple.nodelabel >= nodelabels[0] ? legs[i]->occurrences.elements.size () : 0 );
+  fm::bbrc_graphstate->deleteStartNode ();
+}
+
 ostream &operator<< ( ostream &stream, BbrcPath &path ) {
   stream << /* database->nodelabels[ */ (int) path.nodelabels[0] /* ].inputlabel; */ << " ";
   for ( unsigned int i = 0; i < path.edgelabels.size (); i++ ) {
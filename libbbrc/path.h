@@ -45,16 +45,45 @@ struct BbrcPathBbrcLeg {
 
 typedef BbrcPathBbrcLeg *BbrcPathBbrcLegPtr;
 
+//! An activity column, mined in the same search as the others. While a leg is evaluated for it,
+//! its constraints and result are fm::bbrc_chisq, fm::bbrc_ks and fm::bbrc_result (see bbrcSelect).
+struct BbrcEndpoint {
+  ChisqBbrcConstraint* chisq;
+  KSBbrcConstraint* ks;
+  vector<string>* result;
+  bool updated; // the max of the branch changed since the last representative
+
+  BbrcEndpoint ( ChisqBbrcConstraint* chisq, KSBbrcConstraint* ks, vector<string>* result ): chisq ( chisq ), ks ( ks ), result ( result ), updated ( true ) { }
+};
+
+//! Most significant pattern of the branch (value, output) for each endpoint. The branch is grown
+//! as long as the upper bound holds for one endpoint, the others are closed below it.
+struct BbrcMax {
+  vector<pair<float, string> > best;
+  vector<bool> open;
+};
+
+void bbrcSelect ( unsigned int endpoint );
+bool bbrcFrequent ();
+unsigned int bbrcSupport ( BbrcLegOccurrences &legoccurrences );
+bool bbrcEvaluate ( BbrcLegOccurrences &legoccurrences, const BbrcMax &max, bool grow, BbrcMax &child );
+void bbrcEvaluateTop ( BbrcLegOccurrences &legoccurrences, BbrcMax &child );
+void bbrcRepresentatives ( const BbrcMax &max );
+void bbrcSeparate ();
+
 class BbrcPath {
   public:
     BbrcPath ( BbrcNodeLabel startnodelabel );
     ~BbrcPath ();
     void expand ();
+    void units ( vector<unsigned long> &sizes ); // instead of expand (): sizes of the top-level legs
   private:
     friend class BbrcPatternTree;
     bool is_normal ( BbrcEdgeLabel edgelabel ); // ADDED
-    void expand2 (pair<float, string> max);
+    void expand2 (const BbrcMax &max);
     BbrcPath ( BbrcPath &parentpath, unsigned int legindex );
+    bool pack ( unsigned int legindex ); // compresses the legs not needed below legindex, if over the memory budget
+    void unpack ();
     vector<BbrcPathBbrcLegPtr> legs; // pointers used to avoid copy-constructor during a resize of the vector
     vector<BbrcCloseBbrcLegPtr> closelegs;
     vector<BbrcNodeLabel> nodelabels;
@@ -21,11 +21,11 @@
 
 #include "patterntree.h"
 #include "graphstate.h"
+#include "lattice.h"
 
 namespace fm {
     extern unsigned int bbrc_minfreq;
     extern bool bbrc_do_backbone;
-    extern bool bbrc_updated;
     extern bool bbrc_adjust_ub;
     extern bool bbrc_do_pruning;
     extern bool bbrc_console_out;
@@ -33,22 +33,30 @@ namespace fm {
     extern bool bbrc_do_output;
     extern bool bbrc_bbrc_sep;
     extern bool bbrc_regression;
+    extern int bbrc_progress;
+    extern unsigned long bbrc_memory_budget;
 
     extern BbrcDatabase* bbrc_database;
     extern ChisqBbrcConstraint* bbrc_chisq;
     extern KSBbrcConstraint* bbrc_ks;
     extern vector<string>* bbrc_result;
+    extern vector<BbrcEndpoint> bbrc_endpoints;
     extern BbrcStatistics* bbrc_statistics;
     extern BbrcGraphState* bbrc_graphstate;
+    extern BbrcLattice* bbrc_lattice;
     extern BbrcLegOccurrences* bbrc_legoccurrences;
+    extern vector<BbrcSiblingJoin> bbrc_siblingjoins;
 
     extern vector<BbrcLegOccurrences> bbrc_Bbrccandidatelegsoccurrences; 
+    extern vector<BbrcEdgeLabel> bbrc_candidatelabels;
+    extern BbrcLegPool<BbrcLeg> bbrc_treelegpool;
+    extern BbrcLegPool<BbrcCloseBbrcLeg> bbrc_closelegpool;
 }
 
 int maxsize = ( 1 << ( sizeof(BbrcNodeId)*8 ) ) - 1; // safe default for the largest allowed pattern
 
 inline void BbrcPatternTree::addBbrcLeg ( BbrcNodeId connectingnode, const int depth, const BbrcEdgeLabel edgelabel, BbrcLegOccurrences &legoccurrences ) {
-  BbrcLegPtr leg = new BbrcLeg;
+  BbrcLegPtr leg = fm::bbrc_treelegpool.get ( *fm::bbrc_statistics );
   leg->tuple.depth = depth;
   leg->tuple.label = edgelabel;
   leg->tuple.connectingnode = connectingnode;
@@ -107,11 +115,14 @@ void BbrcPatternTree::addExtensionBbrcLegs ( BbrcTuple &tuple, BbrcLegOccurrence
   else
     bbrc_extend ( legoccurrences );
 
-  if ( fm::bbrc_Bbrccandidatelegsoccurrences[pathlowestlabel].frequency >= fm::bbrc_minfreq )
+  BbrcFrequency pathlowestfrequency = fm::bbrc_Bbrccandidatelegsoccurrences[pathlowestlabel].frequency; // store () may swap the candidate
+  if ( pathlowestfrequency >= fm::bbrc_minfreq )
     // this is the first possible extension, as we force this label to be the lowest!
     addBbrcLeg ( fm::bbrc_graphstate->lastNode (), tuple.depth + 1, pathlowestlabel, fm::bbrc_Bbrccandidatelegsoccurrences[pathlowestlabel] );
 
-  for ( int i = 0; (unsigned) i < fm::bbrc_Bbrccandidatelegsoccurrences.size (); i++ ) {
+  for ( unsigned int k = 0; k < fm::bbrc_candidatelabels.size (); k++ ) {
+    BbrcEdgeLabel i = fm::bbrc_candidatelabels[k];
+    fm::bbrc_statistics->candidate ( i == pathlowestlabel ? pathlowestfrequency : fm::bbrc_Bbrccandidatelegsoccurrences[i].frequency, fm::bbrc_minfreq );
     if ( fm::bbrc_Bbrccandidatelegsoccurrences[i].frequency >= fm::bbrc_minfreq && i != pathlowestlabel )
       addBbrcLeg ( fm::bbrc_graphstate->lastNode (), tuple.depth + 1, i, fm::bbrc_Bbrccandidatelegsoccurrences[i] );
   }
@@ -803,12 +814,14 @@ BbrcPatternTree::BbrcPatternTree ( BbrcPatternTree &parenttree, unsigned int leg
     index++;
   }
 
+  int siblings = index;
+  unsigned long joinbytes = bbrc_join_siblings ( leg.occurrences, parenttree.legs, index, fm::bbrc_siblingjoins );
   if ( rootpathstart == 0 ) {
     secondpathleg = legs.size (); // THE BUG
     while ( index < (int) parenttree.legs.size () ) {
       if ( index == parenttree.secondpathleg )
         secondpathleg = legs.size ();
-      BbrcLegOccurrencesPtr legoccurrencesptr = bbrc_join ( leg.occurrences, parenttree.legs[index]->tuple.connectingnode, parenttree.legs[index]->occurrences );
+      BbrcLegOccurrencesPtr legoccurrencesptr = bbrc_join ( leg.occurrences, fm::bbrc_siblingjoins[index] );
       if ( legoccurrencesptr )
         addBbrcLeg ( parenttree.legs[index]->tuple.connectingnode, parenttree.legs[index]->tuple.depth, parenttree.legs[index]->tuple.label, *legoccurrencesptr );
       index++;
@@ -818,17 +831,19 @@ BbrcPatternTree::BbrcPatternTree ( BbrcPatternTree &parenttree, unsigned int leg
   }
   else {
     while ( index < (int) parenttree.legs.size () ) {
-      BbrcLegOccurrencesPtr legoccurrencesptr = bbrc_join ( leg.occurrences, parenttree.legs[index]->tuple.connectingnode,  parenttree.legs[index]->occurrences );
+      BbrcLegOccurrencesPtr legoccurrencesptr = bbrc_join ( leg.occurrences, fm::bbrc_siblingjoins[index] );
       if ( legoccurrencesptr )
         addBbrcLeg ( parenttree.legs[index]->tuple.connectingnode, parenttree.legs[index]->tuple.depth, parenttree.legs[index]->tuple.label, *legoccurrencesptr );
       index++;
     }
     secondpathleg = legs.size ();
   }
+  bbrc_free_siblings ( fm::bbrc_siblingjoins, siblings, parenttree.legs.size (), joinbytes );
 }
 
-void BbrcPatternTree::expand (pair<float, string> max) {
+void BbrcPatternTree::expand (const BbrcMax &max) {
   fm::bbrc_statistics->patternsize++;
+  fm::bbrc_statistics->node ( fm::bbrc_progress );
   if ( fm::bbrc_statistics->patternsize > (int) fm::bbrc_statistics->frequenttreenumbers.size () ) {
     fm::bbrc_statistics->frequenttreenumbers.resize ( fm::bbrc_statistics->patternsize, 0 );
     fm::bbrc_statistics->frequentpathnumbers.resize ( fm::bbrc_statistics->patternsize, 0 );
@@ -839,101 +854,59 @@ void BbrcPatternTree::expand (pair<float, string> max) {
     fm::bbrc_statistics->patternsize--;
     return;
   }
-    
-  if (fm::bbrc_do_backbone && (legs.size()==0)) {
-    if (fm::bbrc_updated)
-        if (fm::bbrc_do_output) {
-            if (!fm::bbrc_console_out) { 
-               (*fm::bbrc_result) << max.second;
-            }
-            else {
-                cout << max.second;
-            }
-        }
-        fm::bbrc_updated = false;
+  unsigned long bytes = fm::bbrc_statistics->hold ( legs, closelegs, fm::bbrc_memory_budget );
+  if ( fm::bbrc_lattice ) {
+    BbrcFrequency maxleg = 0;
+    for ( unsigned int i = 0; i < legs.size (); i++ ) maxleg = std::max ( maxleg, legs[i]->occurrences.frequency );
+    fm::bbrc_lattice->enter ( maxleg );
   }
+    
+  if (fm::bbrc_do_backbone && (legs.size()==0)) bbrcRepresentatives ( max );
 
   
  
   for ( int i = legs.size()-1; i >= 0; i-- ) {
 
-    // Calculate chisq
-    if (fm::bbrc_chisq->active) { 
-        if (!fm::bbrc_regression) fm::bbrc_chisq->Calc(legs[i]->occurrences.elements);
-        else fm::bbrc_ks->Calc(legs[i]->occurrences.elements);
-    }
+    bbrc_unpack ( legs[i]->occurrences );
 
     // GRAPHSTATE
     fm::bbrc_graphstate->insertNode ( legs[i]->tuple.connectingnode, legs[i]->tuple.label, legs[i]->occurrences.maxdegree );
+    if ( fm::bbrc_lattice ) fm::bbrc_lattice->add ( BBRC_LATTICE_TREE, legs[i]->tuple.connectingnode, legs[i]->tuple.label, legs[i]->occurrences );
 
-    // immediate output for all patterns
-    if (fm::bbrc_do_output && !fm::bbrc_do_backbone) {
-       if (!fm::bbrc_console_out) (*fm::bbrc_result) << fm::bbrc_graphstate->to_s(legs[i]->occurrences.frequency);
-       else fm::bbrc_graphstate->print(legs[i]->occurrences.frequency);
-    }
-
-    // RECURSE
-    float cmax = maxi ( maxi ( fm::bbrc_chisq->sig, max.first ), fm::bbrc_chisq->p );
-
-    if ( ( !fm::bbrc_do_pruning || 
-               (
-                 (  !fm::bbrc_adjust_ub && (fm::bbrc_chisq->u >= fm::bbrc_chisq->sig) ) || 
-                 (   fm::bbrc_adjust_ub && (fm::bbrc_chisq->u >= cmax) )
-               )
-             ) &&
-         (
-            fm::bbrc_refine_singles || (legs[i]->occurrences.frequency>1)
-         )
-    
-    ) {   // UB-PRUNING
-
+    // STATISTICS, OUTPUT FOR ALL PATTERNS AND RECURSE
+    BbrcMax child;
+    if ( bbrcEvaluate ( legs[i]->occurrences, max, fm::bbrc_refine_singles || (legs[i]->occurrences.frequency>1), child ) ) {   // UB-PRUNING
         BbrcPatternTree p ( *this, i );
-
-        if (!fm::bbrc_regression) {
-            if (fm::bbrc_chisq->p > max.first) { fm::bbrc_updated = true; p.expand (pair<float, string>(fm::bbrc_chisq->p,fm::bbrc_graphstate->to_s(legs[i]->occurrences.frequency))); }
-            else p.expand (max);
-        }
-        else {
-            if (fm::bbrc_ks->p > max.first) { fm::bbrc_updated = true; p.expand (pair<float, string>(fm::bbrc_ks->p,fm::bbrc_graphstate->to_s(legs[i]->occurrences.frequency))); }
-            else p.expand (max);
-        }
-    }
-    else {
-        if (fm::bbrc_do_backbone && fm::bbrc_updated) {
-            if (fm::bbrc_do_output) {
-                if (!fm::bbrc_console_out) {
-                    (*fm::bbrc_result) << max.second;
-                }
-                else {
-                    cout << max.second;
-                }
-            }
-            fm::bbrc_updated = false;
-        }
+        pack ( i );
+        p.expand ( child );
     }
 
     fm::bbrc_graphstate->deleteNode ();
 
   }
 
-  if (fm::bbrc_bbrc_sep && !fm::bbrc_do_backbone && (legs.size()==0)) {
-      if (fm::bbrc_do_output) {
-          if (!fm::bbrc_console_out && fm::bbrc_result->size() && (fm::bbrc_result->back()!=fm::bbrc_graphstate->sep())) (*fm::bbrc_result) << fm::bbrc_graphstate->sep();
-          //else cout << fm::bbrc_graphstate->sep() << endl;
-      }
-  }
+  if (fm::bbrc_bbrc_sep && !fm::bbrc_do_backbone && (legs.size()==0)) bbrcSeparate ();
 
+  if ( fm::bbrc_lattice ) fm::bbrc_lattice->leave ();
+  fm::bbrc_statistics->release ( bytes );
   fm::bbrc_statistics->patternsize--;
 
 }
 
 
 
+// Legs are expanded from the back, and the children of a leg only join with the
+// legs from there on. The legs in front wait for their turn and are compressed.
+void BbrcPatternTree::pack ( int legindex ) {
+  if ( !fm::bbrc_statistics->exceeds ( fm::bbrc_memory_budget ) )
+    return;
+  for ( int i = 0; i < legindex; i++ )
+    bbrc_pack ( legs[i]->occurrences );
+}
+
 BbrcPatternTree::~BbrcPatternTree () {
-  for ( int i = 0; i < (int) legs.size (); i++ )
-    delete legs[i];
-  for ( int i = 0; i < (int) closelegs.size (); i++ )
-    delete closelegs[i];
+  fm::bbrc_treelegpool.put ( legs, *fm::bbrc_statistics, fm::bbrc_memory_budget );
+  fm::bbrc_closelegpool.put ( closelegs, *fm::bbrc_statistics, fm::bbrc_memory_budget );
 }
 
 /*
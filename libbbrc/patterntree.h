@@ -62,7 +62,7 @@ class BbrcPatternTree {
   public:
     BbrcPatternTree ( BbrcPath &path, unsigned int legindex );
     ~BbrcPatternTree ();
-    void expand (pair<float, string> max);
+    void expand (const BbrcMax &max);
     vector<BbrcLegPtr> legs; // pointers used to avoid copy-constructor during a resize of the vector
   private:
     void checkIfIndeedNormal ();
@@ -73,6 +73,7 @@ class BbrcPatternTree {
     /* inline */ void addRightBbrcLegs ( BbrcPath &path, BbrcPathBbrcLeg &leg, int &i, BbrcDepth olddepth, BbrcEdgeLabel lowestlabel, int rightstart, int nodesize2 );
     /* inline */ int addRightBbrcLegs ( BbrcPath &path, BbrcPathBbrcLeg &leg, BbrcTuple &tuple, unsigned int legindex, int rightstart, int nodesize2 );
     BbrcPatternTree ( BbrcPatternTree &parenttree, unsigned int legindex );
+    void pack ( int legindex ); // compresses the legs still waiting below legindex, if over the memory budget
     vector<BbrcTuple> treetuples;
     vector<BbrcNodeId> rightmostindexes;
     vector<short> rootpathrelations;
@@ -0,0 +1,164 @@
+// profile.h
+
+/*
+    This file is part of LibBbrc (libbbrc).
+
+    LibBbrc is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    LibBbrc is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with LibBbrc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Phase timers. Compiled in with -DFMINER_PROFILE (see Makefile), otherwise
+// BBRC_PROFILE and BBRC_PROFILE_TRACE expand to nothing.
+
+#ifndef BBRC_PROFILE_H
+#define BBRC_PROFILE_H
+
+enum BbrcProfilePhase {
+    BBRC_PROFILE_INGEST,        // AddCompound()
+    BBRC_PROFILE_INCHI,         // canonical form (InChI) of an input structure
+    BBRC_PROFILE_ADD_DATA,      // AddDataCanonical()
+    BBRC_PROFILE_EDGECOUNT,     // BbrcDatabase::edgecount()
+    BBRC_PROFILE_REORDER,       // BbrcDatabase::reorder()
+    BBRC_PROFILE_MINE_ROOT,     // search below one root node
+    BBRC_PROFILE_STATISTIC,     // chi-square / KS evaluation of a leg
+    BBRC_PROFILE_OUTPUT,        // formatting of a fragment
+    BBRC_PROFILE_PHASES
+};
+
+#ifdef FMINER_PROFILE
+
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+//! Scope of a phase as trace event.
+class BbrcProfileEvent {
+  public:
+    BbrcProfileEvent(BbrcProfilePhase _phase, unsigned long long _start, unsigned long long _dur) : phase(_phase), start(_start), dur(_dur) {}
+    BbrcProfilePhase phase;
+    unsigned long long start; //!< ns since the first measurement
+    unsigned long long dur; //!< ns
+};
+
+//! Counters of one thread, so that measuring needs no locking.
+class BbrcProfileThread {
+  public:
+    BbrcProfileThread() : tid(syscall(SYS_gettid)) {
+      for (int i=0; i<BBRC_PROFILE_PHASES; i++) { count[i]=0; ns[i]=0; }
+    }
+    long tid;
+    unsigned long count[BBRC_PROFILE_PHASES];
+    unsigned long long ns[BBRC_PROFILE_PHASES]; //!< inclusive time
+    std::vector<BbrcProfileEvent> events; //!< only phases measured with BBRC_PROFILE_TRACE
+};
+
+class BbrcProfile {
+  public:
+    static const char* name(int phase) {
+      static const char* names[BBRC_PROFILE_PHASES] = { "ingest", "inchi", "add_data_canonical", "edgecount", "reorder", "mine_root", "statistic", "output" };
+      return names[phase];
+    }
+    static unsigned long long now() {
+      return timestamp() - epoch();
+    }
+    //! Sets the time of the first measurement, once at library init (see bbrc.cpp), before threads measure.
+    static void start() {
+      epoch() = timestamp();
+    }
+    //! Counters of the calling thread, registered on first use.
+    static BbrcProfileThread& thread() {
+      static __thread BbrcProfileThread* t = NULL;
+      if (!t) {
+        t = new BbrcProfileThread();
+        pthread_mutex_lock(&mutex());
+        threads().push_back(t);
+        pthread_mutex_unlock(&mutex());
+      }
+      return *t;
+    }
+    //! Aggregated counters per thread and phase: {"threads": [{"tid":, "phases": {"<phase>": {"count":, "ms":}}}]}
+    static void write_json(std::ostream& os) {
+      pthread_mutex_lock(&mutex());
+      os << std::fixed << std::setprecision(3) << "{\"threads\": [";
+      for (unsigned int i=0; i<threads().size(); i++) {
+        BbrcProfileThread& t = *threads()[i];
+        os << (i ? "," : "") << std::endl << " {\"tid\": " << t.tid << ", \"phases\": {";
+        for (int p=0; p<BBRC_PROFILE_PHASES; p++) {
+          os << (p ? "," : "") << std::endl << "  \"" << name(p) << "\": {\"count\": " << t.count[p] << ", \"ms\": " << t.ns[p] / 1.0e6 << "}";
+        }
+        os << "}}";
+      }
+      os << std::endl << "]}" << std::endl;
+      pthread_mutex_unlock(&mutex());
+    }
+    //! Traced phases in Chrome trace event format (chrome://tracing, Perfetto).
+    static void write_trace(std::ostream& os) {
+      pthread_mutex_lock(&mutex());
+      os << std::fixed << std::setprecision(3) << "{\"traceEvents\": [";
+      bool first = true;
+      for (unsigned int i=0; i<threads().size(); i++) {
+        BbrcProfileThread& t = *threads()[i];
+        for (unsigned int j=0; j<t.events.size(); j++) {
+          os << (first ? "" : ",") << std::endl << " {\"name\": \"" << name(t.events[j].phase) << "\", \"ph\": \"X\", \"pid\": " << getpid() << ", \"tid\": " << t.tid
+             << ", \"ts\": " << t.events[j].start / 1.0e3 << ", \"dur\": " << t.events[j].dur / 1.0e3 << "}";
+          first = false;
+        }
+      }
+      os << std::endl << "]}" << std::endl;
+      pthread_mutex_unlock(&mutex());
+    }
+  private:
+    static unsigned long long timestamp() {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+    static unsigned long long& epoch() { static unsigned long long e = 0; return e; }
+    static std::vector<BbrcProfileThread*>& threads() { static std::vector<BbrcProfileThread*> t; return t; }
+    static pthread_mutex_t& mutex() { static pthread_mutex_t m = PTHREAD_MUTEX_INITIALIZER; return m; }
+};
+
+//! Measures its own lifetime as one instance of a phase.
+class BbrcProfileScope {
+  public:
+    BbrcProfileScope(BbrcProfilePhase _phase, bool _trace) : phase(_phase), trace(_trace), start(BbrcProfile::now()) {}
+    ~BbrcProfileScope() {
+      unsigned long long dur = BbrcProfile::now() - start;
+      BbrcProfileThread& t = BbrcProfile::thread();
+      t.count[phase]++;
+      t.ns[phase] += dur;
+      if (trace) t.events.push_back(BbrcProfileEvent(phase, start, dur));
+    }
+  private:
+    BbrcProfilePhase phase;
+    bool trace;
+    unsigned long long start;
+};
+
+#define BBRC_PROFILE_CAT2(a,b) a##b
+#define BBRC_PROFILE_CAT(a,b) BBRC_PROFILE_CAT2(a,b)
+#define BBRC_PROFILE(phase) BbrcProfileScope BBRC_PROFILE_CAT(bbrc_profile_scope_, __LINE__) (phase, false)  // aggregate only, for hot paths
+#define BBRC_PROFILE_TRACE(phase) BbrcProfileScope BBRC_PROFILE_CAT(bbrc_profile_scope_, __LINE__) (phase, true)  // aggregate and trace event
+
+#else
+
+#define BBRC_PROFILE(phase)
+#define BBRC_PROFILE_TRACE(phase)
+
+#endif
+
+#endif
@@ -96,6 +96,7 @@
  *
  *  @subsection sec33 Environment Variables
  * <b>FMINER_SILENT</b>      : Redirect STDERR (debug output) of fminer to local file 'fminer_debug.txt'<br />
+ * <b>FMINER_STATISTICS</b>  : Print the number of search nodes per pattern size to STDERR when the instance is destroyed.<br />
  *
  * Note: The value you set the environment variables to is irrelevant. Use <code>unset</code> to disable the environment variables, e.g. <code>unset FMINER_LAZAR</code>.
  *
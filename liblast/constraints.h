@@ -42,20 +42,15 @@ class ChisqLastConstraint : public LastConstraint {
     map<float, unsigned int> nr_acts;
     unsigned int n;
     float sig;                       // significance threshold, not accessed (r,rw) inside this class (only constructor)
+    float level;                     // of sig, which is converted with the degrees of freedom of the classes in MineRoot()
     float chisq;                     // chisq is test results, written on every test                  (cand. for making private)
     float p, u;                      // p, u are test results, written on every test                  (cand. for making ro)
     bool active;                     // whether test is active, not accessed (r,rw) inside this class (only constructor)
     map<float, set<LastTid> > f_sets;
     map<float, map<LastTid,int> > f_maps; 
-    map<int, float> df_thresholds;
     float activating;                 // defaults to deactivating (0)                                  (cand. for making ro)
 
-    ChisqLastConstraint (float sig) : n(0), sig(sig), chisq(0.0), p(0.0), u(0.0), activating(0) {
-      df_thresholds[1]=3.84;
-      df_thresholds[2]=5.99;
-      df_thresholds[3]=7.82;
-      df_thresholds[4]=9.49;
-    }
+    ChisqLastConstraint (float sig) : n(0), sig(sig), level(0.95), chisq(0.0), p(0.0), u(0.0), activating(0) {}
 
     //!< Calculate chi^2 of current and upper bound for chi^2 of more specific features (see Morishita and Sese, 2000)
     template <typename OccurrenceType>
@@ -69,27 +64,7 @@ class ChisqLastConstraint : public LastConstraint {
         for (f_sets_it=f_sets.begin(); f_sets_it!=f_sets.end(); f_sets_it++) f_sizes.push_back(f_sets_it->second.size());
         each(f_sizes) f_sum+=f_sizes[i];
         p = ChiSq(f_sum, f_sizes, true);
-
-        set<int> f_indices;
-        for (int i=0; i<f_sizes.size(); i++) f_indices.insert(i);
-        set<set<int> > f_subsets;
-        set<set<int> >::iterator f_subsets_it;
-        generateIntSubsets(f_indices, f_subsets);
-        for (f_subsets_it = f_subsets.begin(); f_subsets_it!=f_subsets.end(); f_subsets_it++) {
-          if (f_subsets_it->size() > 0) {
-            f_sum=0;
-            vector<int> f_selected_sizes;
-            for (int j=0; j<f_sizes.size(); j++) { 
-              if (f_subsets_it->find(j)!=f_subsets_it->end()) {
-                f_selected_sizes.push_back(f_sizes[j]);
-                f_sum+=f_sizes[j];
-              }
-              else f_selected_sizes.push_back(0);
-            }
-            float current = ChiSq(f_sum,f_selected_sizes,false);
-            if (current > u) u=current;
-          }
-       }
+        u = UpperBound(f_sizes);
     }
 
     float ChiSqTest(map<float, unsigned int> _f_sets, map<float, unsigned int> _nr_acts); // on-the-fly test
@@ -98,7 +73,7 @@ class ChisqLastConstraint : public LastConstraint {
 
     //!< Calculates chi^2 and upper bound values
     float ChiSq(int x_val, vector<int> y, bool decide_ativating);
-    void generateIntSubsets(set<int>& myset, set<set<int> >&subsets);
+    float UpperBound(vector<int>& f_sizes);
  
 
     //!< Counts occurrences of legs in active and inactive compounds
@@ -137,43 +112,44 @@ class KSLastConstraint : public LastConstraint {
     vector<float> all;               // activity values (all)
     vector<float> feat;              // activity values (feature), written on every test              (cand. for making private)
     float sig, p;
-    map<float, set<LastTid> > f_sets;
-    map<float, map<LastTid,int> > f_maps; 
     float activating;                 // defaults to deactivating (0)                                  (cand. for making ro)
 
-    KSLastConstraint (float sig) : sig(sig), p(0.0), activating(0) {}
+    KSLastConstraint (float sig) : sig(sig), p(0.0), activating(0), all_median(0.0) {}
 
     template <typename OccurrenceType>
     void Calc(vector<OccurrenceType>& legocc) { 
+      if (rank.size() != fm::last_database->trees.size()) Prepare();
       LastLegActivityOccurrence(legocc); 
-      p = KS(all,feat,1); 
+      p = KS(all_sorted,feat,all_median,1); 
     }
     float KSTest(vector<float> all, vector<float> feat);
 
   private:
-    float KS(vector<float> all_activities, vector<float> feat_activities, bool decide_activating);
-
-    //!< Stores activities of occurrences of legs
+    vector<float> all_sorted;        // all, sorted once by Prepare() before the first test
+    float all_median;
+    vector<LastTid> ranked;          // tids by ascending activity, NaN last
+    vector<unsigned int> rank;       // position of each tid in ranked
+    vector<unsigned int> ranks;      // ranks of the feature, written on every test
+
+    void Prepare();
+    float Median(vector<float>& sorted);
+    //!< KS test of sorted activities, decides activation by the medians
+    float KS(vector<float>& all_activities, vector<float>& feat_activities, float all_median, bool decide_activating);
+
+    //!< Stores activities of occurrences of legs, once per compound
     template <typename OccurrenceType>
       void LastLegActivityOccurrence(vector<OccurrenceType>& legocc) {
 
         feat.clear();
-        f_sets.clear();
-        f_maps.clear();
-
-        std::pair< set<LastTid>::iterator, bool > insert_ret;
+        ranks.clear();
         each (legocc) {
-          float activity = fm::last_database->trees[legocc[i].tid]->activity;
-          LastTid orig_tid = fm::last_database->trees[legocc[i].tid]->orig_tid;
-
-          f_maps[0.0].insert(make_pair(orig_tid,1)); // each occurrence with 1, failure if present (use 0.0 as dummy key for regression)
-          insert_ret = f_sets[0.0].insert(orig_tid); 
-          if (!insert_ret.second) {
-            f_maps[0.0][orig_tid]++; // increase if present
-          }
-          else {
-            feat.push_back(activity); // only if not present
-          }
+          if (!i || legocc[i].tid != legocc[i-1].tid) ranks.push_back(rank[legocc[i].tid]);
+        }
+
+        // the feature's own ranks in order yield its activities sorted
+        sort(ranks.begin(), ranks.end());
+        each (ranks) {
+          if (!i || ranks[i] != ranks[i-1]) feat.push_back(fm::last_database->trees[ranked[ranks[i]]]->activity);
         }
       }
 
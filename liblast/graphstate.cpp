@@ -1338,9 +1338,7 @@ int GSWalk::conflict_resolution (vector<int> core_ids, GSWalk* s, bool starting,
                 c12.clear(); set_difference(c12_tmp.begin(), c12_tmp.end(), u12.begin(), u12.end(), std::inserter(c12, c12.end()));        // intersection \ core_ids (symmetric)
 
                 // REMOVE MORE IDS FROM C12 HERE?????
-                each_it(c12, set<int>::iterator) {
-                    if (*it<core_ids.back()) c12.erase(*it);
-                }
+                c12.erase(c12.begin(), c12.lower_bound(core_ids.back()));
 
                 d12.clear(); set_difference(d1.begin(), d1.end(), i12.begin(), i12.end(), std::inserter(d12, d12.end()));                  // mutex set
                 d21.clear(); set_difference(d2.begin(), d2.end(), i12.begin(), i12.end(), std::inserter(d21, d21.end()));
@@ -1771,7 +1769,7 @@ int GSWalk::stack (GSWalk* w, map<int,int> stack_locations) {
             }
         }
     }
-
+    return 0;
 }
 
 //! stacks a node n
@@ -1787,7 +1785,7 @@ int GSWEdge::stack (GSWEdge e) {
     labs.insert(e.labs.begin(), e.labs.end());
     for (map<float, map<LastTid,int> >::iterator it=e.m.begin(); it!=e.m.end(); it++) {
         for (map<LastTid,int>::iterator it2=it->second.begin(); it2!=it->second.end(); it2++) {
-          m[it->first][it2->first] = m.find(it->first)->second.find(it2->first)->second + it2->second;
+          m[it->first][it2->first] += it2->second;
         }
     }
     discrete_weight = discrete_weight + e.discrete_weight;
@@ -45,6 +45,7 @@ Last::Last() : init_mining_done(false) {
 
 Last::~Last() {
     if (fm::last_instance_present) {
+        if (getenv("FMINER_STATISTICS") && fm::last_statistics) fm::last_statistics->print();
         delete fm::last_database;
         delete fm::last_statistics; 
         delete fm::last_chisq; 
@@ -197,7 +198,14 @@ bool Last::SetChisqActive(bool val) {
 }
 
 bool Last::SetChisqSig(float _chisq_val) {
-    return 0;
+    if (_chisq_val < 0.0 || _chisq_val > 1.0) { cerr << "Error! Invalid value '" << _chisq_val << "' for parameter chisq." << endl; exit(1); }
+    if (fm::last_regression) {
+         fm::last_ks->sig = _chisq_val;
+    }
+    else {
+        fm::last_chisq->level = _chisq_val;
+    }
+    return 1;
 }
 
 bool Last::SetRegression(bool val) {
@@ -212,8 +220,38 @@ bool Last::SetMaxHops(int val) {
     return 1;
 }
 
+// Not available in LAST-PM
+bool Last::SetMemoryBudget(unsigned long bytes) {
+    return 0;
+}
+
+// Not available in LAST-PM
+bool Last::SetCheckpoint(string file, bool resume) {
+    return 0;
+}
+
 // 4. Other methods
 
+// LAST-PM numbers the graphs of all roots in one document, so the search is a single unit
+vector<unsigned long>* Last::GetUnits(unsigned int j) {
+    units.assign(j ? 0 : 1, 1);
+    return &units;
+}
+
+vector<string>* Last::MineUnit(unsigned int j, unsigned int unit) {
+    unit_result.clear();
+    for (int k = 0; k < GetNoRootNodes(); k++) {
+        MineRoot(k);
+        unit_result.insert(unit_result.end(), fm::last_result->begin(), fm::last_result->end());
+    }
+    return &unit_result;
+}
+
+// Not needed in LAST-PM
+unsigned int Last::GetUnitGraphs() {
+    return 0;
+}
+
 vector<string>* Last::MineRoot(unsigned int j) {
     fm::last_result->clear();
     if (!init_mining_done) {
@@ -222,13 +260,11 @@ vector<string>* Last::MineRoot(unsigned int j) {
         }
         // Adjust chisq bound
         if (!fm::last_regression) {
-          if (fm::last_chisq->nr_acts.size()>1 && fm::last_chisq->nr_acts.size() < 6) {
-            if (fm::last_chisq->sig == -1.0) { // do not override user-supplied threshold
-              fm::last_chisq->sig=fm::last_chisq->df_thresholds[fm::last_chisq->nr_acts.size()-1];
-            }
+          if (fm::last_chisq->nr_acts.size()>1) { // k classes: k-1 degrees of freedom, as in LibBBRC
+            fm::last_chisq->sig=gsl_cdf_chisq_Pinv(fm::last_chisq->level, fm::last_chisq->nr_acts.size()-1);
           }
           else {
-            cerr << "Error! Too many classes: '" << fm::last_chisq->nr_acts.size() << "' (Max. 5)." << endl;
+            cerr << "Error! Too few classes: '" << fm::last_chisq->nr_acts.size() << "'." << endl;
             exit(1);
           }
         }
@@ -305,10 +341,35 @@ xsi:noNamespaceSchemaLocation=\"graphml.xsd\">\n\
     return fm::last_result;
 }
 
+string Last::GetStatistics() {
+    return fm::last_statistics->to_json();
+}
+
 void Last::ReadGsp(FILE* gsp){
     fm::last_database->readGsp(gsp);
 }
 
+// Forbidden in LAST-PM
+bool Last::WriteLattice(FILE* lattice) {
+  cerr << "Error! Lattices are only written by BBRC." << endl;
+  return 0;
+}
+
+void Last::ReadLattice(FILE* lattice) {
+  cerr << "Error! Lattices are only read by BBRC." << endl;
+  exit(1);
+}
+
+// Not available in LAST-PM, each run reads the compounds
+bool Last::PrepareCompounds() {
+  return 0;
+}
+
+// Not available in LAST-PM, MineRoot() builds the database
+bool Last::PrepareMining() {
+  return 0;
+}
+
 bool Last::AddCompound(string smiles, unsigned int comp_id) {
   if (fm::last_db_built) {
     cerr << "LastDatabase has been already processed! Please reset() and insert a new dataset." << endl;
@@ -359,6 +420,22 @@ bool Last::AddActivity(float act, unsigned int comp_id) {
   return true;
 }
 
+// Not available in LAST-PM
+bool Last::AddActivity(float act, unsigned int comp_id, unsigned int endpoint) {
+  if (!endpoint) return AddActivity(act, comp_id);
+  cerr << "Error! Several endpoints are only mined by BBRC." << endl;
+  return false;
+}
+
+int Last::GetNoEndpoints() {
+  return 1;
+}
+
+vector<string>* Last::GetResult(unsigned int endpoint) {
+  if (endpoint) { cerr << "Error! Endpoint " << endpoint << " does not exist." << endl;  exit(1); }
+  return fm::last_result;
+}
+
 
 
 // the class factories
@@ -380,7 +457,7 @@ extern "C" void destroy(Fminer* l) {
 extern "C" void usage() {
     cerr << endl;
     cerr << "Options for Usage 1 (LAtent STructure-Pattern Mining): " << endl;
-    cerr << "       [-f minfreq] [-m maxhops] [-a] [-o] [-g] <graphs> <activities>" << endl;
+    cerr << "       [-f minfreq] [-m maxhops] [-a] [-o] [-g] [-j file] [-W n [-S dir] | -w dir] <graphs> <activities>" << endl;
     cerr << endl;
 }
 
@@ -419,6 +496,7 @@ bool Last::AddDataCanonical() {
     inchi_compound_map.clear();
     inchi_compound_mmap.clear();
     activity_map.clear();
+    return true;
 }
 
 bool Last::AddCompoundCanonical(string smiles, unsigned int comp_id) {
@@ -98,6 +98,8 @@ class Last : public Fminer {
     bool SetChisqSig(float _chisq_val); //!< Set significance threshold here (between 0 and 1). Same as '-p'.
     bool SetRegression(bool val); //!< Dummy method for regression (only used for bbrcs). Same as '-g'.
     bool SetMaxHops(int val); //!< Set maximum number of hops. Same as '-m'.
+    bool SetMemoryBudget(unsigned long bytes); //!< Dummy method for the memory budget (only used in BBRC mining). Same as '-M'.
+    bool SetCheckpoint(string file, bool resume); //!< Dummy method for checkpoints (only written by BBRC mining). Same as '-C'.
     //@}
     
     /** @name Others
@@ -105,9 +107,20 @@ class Last : public Fminer {
      */
     //@{
     vector<string>* MineRoot(unsigned int j); //!< Mine fragments rooted at the j-th root node (element type).
+    vector<unsigned long>* GetUnits(unsigned int j); //!< Get the units of work of the j-th root node. The search is a single unit, that of the first root.
+    vector<string>* MineUnit(unsigned int j, unsigned int unit); //!< Mine the single unit, i.e. all roots.
+    unsigned int GetUnitGraphs(); //!< Dummy method for graph ids of units (only used in BBRC mining, the search is a single unit).
+    string GetStatistics(); //!< Get search statistics (node totals) as JSON.
     void ReadGsp(FILE* gsp); //!< Read in a gSpan file
+    bool WriteLattice(FILE* lattice); //!< Dummy method for pattern lattices (only written by BBRC). Same as '-L'.
+    void ReadLattice(FILE* lattice); //!< Dummy method for pattern lattices (only replayed by BBRC).
     bool AddCompound(string smiles, unsigned int comp_id); //!< Add a compound to the database.
+    bool PrepareCompounds(); //!< Dummy method for reading structures once for several runs (only done by BBRC mining).
+    bool PrepareMining(); //!< Dummy method for building the database before mining (only done by BBRC mining).
     bool AddActivity(float act, unsigned int comp_id); //!< Add an activity to the database.
+    bool AddActivity(float act, unsigned int comp_id, unsigned int endpoint); //!< Dummy method for further endpoints (only mined by BBRC), endpoint 0 is the one above.
+    int GetNoEndpoints(); //!< Get number of endpoints (1 in LAST-PM).
+    vector<string>* GetResult(unsigned int endpoint); //!< Get the fragments found by the last MineRoot() (endpoint 0 only).
     int GetNoRootNodes() {if (!fm::last_db_built) AddDataCanonical() ; return fm::last_database->nodelabels.size();} //!< Get number of root nodes (different element types).
     int GetNoCompounds() {if (!fm::last_db_built) AddDataCanonical() ; return fm::last_database->trees.size();} //!< Get number of compounds in the database.
     float ChisqTest(vector<float> all, vector<float> feat);
@@ -124,6 +137,8 @@ class Last : public Fminer {
     int comp_no;
 
     vector<string> r;
+    vector<unsigned long> units; // of GetUnits()
+    vector<string> unit_result; // of MineUnit()
     // ONLY FOR INTERNAL USE. DO NOT MAKE PUBLIC!
     map<string, pair<unsigned int, string> > inchi_compound_map;    // AM: structure inchi => (id, smi) for canonical input to check for double structures
     map<string, pair<unsigned int, string> > inchi_compound_mmap;   // AM: structure inchi => (id, smi) for canonical input to use for actual storage
@@ -88,6 +88,19 @@ class LastStatistics {
         cerr << "TOTAL:" << endl
            << "Frequent cyclic graphs: " << total << " real trees: " << total2 << " paths: " << total3 << " total: " << total + total2 + total3 << endl;
     }  
+    //! Node totals in the JSON layout of libbbrc; per root counters are not collected by LAST-PM.
+    string to_json () {
+        unsigned int total = 0, total2 = 0, total3 = 0;
+        for (unsigned int i = 0; i < frequenttreenumbers.size (); i++ ) {
+          total += frequentgraphnumbers[i];
+          total2 += frequenttreenumbers[i];
+          total3 += frequentpathnumbers[i];
+        }
+        ostringstream os;
+        os << "{\"nodes\": {\"graphs\": " << total << ", \"trees\": " << total2 << ", \"paths\": " << total3 << "}," << endl
+           << " \"roots\": [" << endl << " ]}" << endl;
+        return os.str ();
+    }
 };
 
 
@@ -1176,6 +1176,7 @@ ostream& operator<< (ostream& os, GSWEdge* gswe) {
       }
     }
     os << "> ";
+    return os;
 }
 
 ostream& operator<< (ostream& os, GSWNode* gswn) {
@@ -1185,4 +1186,5 @@ ostream& operator<< (ostream& os, GSWNode* gswn) {
         os << *it << " ";
     }
     os << "> ";
+    return os;
 }